@@ -0,0 +1,59 @@
+--[[ msgpack.lua
+    This example benchmarks msgpack and cbor encoding and decoding against json.encode and
+    json.decode, on a large document of records and on a deeply nested document, and reports
+    the size of each encoding.
+
+    usage: lua msgpack.lua [records] [depth] [rounds]
+--]]
+
+local json = require("poco.json")
+local msgpack = require("poco.msgpack")
+local cbor = require("poco.cbor")
+
+local record_count = tonumber(arg and arg[1]) or 100000
+local depth = tonumber(arg and arg[2]) or 10000
+local rounds = tonumber(arg and arg[3]) or 5
+
+local codecs = { { "json", json }, { "msgpack", msgpack }, { "cbor", cbor } }
+
+local function report(name, bytes, seconds)
+    print(string.format("%-24s %8.1f MB %8.3f s %8.1f MB/s %8.1f ops/s", name, bytes * rounds / 1e6, seconds,
+        bytes * rounds / 1e6 / seconds, rounds / seconds))
+end
+
+local function bench(name, doc)
+    for _, codec in ipairs(codecs) do
+        local label = name .. " " .. codec[1]
+        local encoded
+        local start = os.clock()
+        for _ = 1, rounds do encoded = assert(codec[2].encode(doc)) end
+        report(label .. " encode", #encoded, os.clock() - start)
+
+        start = os.clock()
+        for _ = 1, rounds do assert(codec[2].decode(encoded)) end
+        report(label .. " decode", #encoded, os.clock() - start)
+    end
+end
+
+-- a large array of flat records, mixing strings, integers, doubles and booleans.
+local records = {}
+for i = 1, record_count do
+    records[i] =
+    {
+        id = i,
+        name = "record number " .. i,
+        description = "a \"quoted\" description\nspanning two lines",
+        price = i * 1.25,
+        ratio = 1 / i,
+        tags = { "red", "green", "blue" },
+        active = i % 2 == 0,
+    }
+end
+bench("records", records)
+
+-- an object nested depth times, each level holding a few scalar members.
+local nested = { value = "leaf" }
+for i = 1, depth do
+    nested = { level = i, name = "level" .. i, child = nested, siblings = { i, i + 1 } }
+end
+bench("nested", nested)
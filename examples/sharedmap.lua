@@ -0,0 +1,87 @@
+--[[ sharedmap.lua
+    This example shows how a sharedmap is shared between threads, and benchmarks it against
+    the hand-rolled alternative of a single thread owning a table, which other threads reach via
+    mutex protected notificationqueue round trips.
+
+    usage: lua sharedmap.lua [threads] [operations_per_thread] [keys]
+--]]
+
+local sharedmap = require("poco.sharedmap")
+local notificationqueue = require("poco.notificationqueue")
+local mutex = require("poco.mutex")
+local thread = require("poco.thread")
+local timestamp = require("poco.timestamp")
+
+local thread_count = tonumber(arg and arg[1]) or 4
+local operations = tonumber(arg and arg[2]) or 100000
+local key_count = tonumber(arg and arg[3]) or 64
+
+-- thread entrypoints, these have no upvalues such that they can be copied to the thread's lua_State.
+local function sharedmap_worker(map, operations, key_count, id)
+    for i = 1, operations do
+        map:incr("key" .. ((i + id) % key_count))
+    end
+end
+
+local function queue_worker(requests, replies, reply_mutex, operations, key_count, id)
+    for i = 1, operations do
+        -- the mutex ensures the reply dequeued is the reply to this thread's request.
+        reply_mutex:lock()
+        requests:enqueue("incr", "key" .. ((i + id) % key_count))
+        replies:waitDequeue()
+        reply_mutex:unlock()
+    end
+    requests:enqueue("done")
+end
+
+local function join_threads(threads)
+    for _, t in ipairs(threads) do assert(t:join()) end
+end
+
+local function report(name, start, map_total)
+    local seconds = tonumber(start:elapsed()) / 1000000
+    local total = thread_count * operations
+    print(string.format("%-16s %10d ops %8.3f s %12.0f ops/s  total: %d", name, total, seconds, total / seconds, map_total))
+end
+
+-- sharedmap: each thread updates the map directly, only contending on the shard holding its key.
+local map = assert(sharedmap())
+local start = assert(timestamp())
+local threads = {}
+for id = 1, thread_count do
+    threads[id] = assert(thread())
+    assert(threads[id]:start(sharedmap_worker, map, operations, key_count, id))
+end
+join_threads(threads)
+
+local map_total = 0
+for k = 0, key_count - 1 do map_total = map_total + (map:get("key" .. k) or 0) end
+report("sharedmap", start, map_total)
+
+-- notificationqueue: the main thread owns the table and serves each request in turn.
+local requests = assert(notificationqueue())
+local replies = assert(notificationqueue())
+local reply_mutex = assert(mutex())
+local owned = {}
+start = assert(timestamp())
+threads = {}
+for id = 1, thread_count do
+    threads[id] = assert(thread())
+    assert(threads[id]:start(queue_worker, requests, replies, reply_mutex, operations, key_count, id))
+end
+
+local finished = 0
+while finished < thread_count do
+    local request, key = requests:waitDequeue()
+    if request == "incr" then
+        owned[key] = (owned[key] or 0) + 1
+        replies:enqueue("reply", owned[key])
+    elseif request == "done" then
+        finished = finished + 1
+    end
+end
+join_threads(threads)
+
+local owned_total = 0
+for _, v in pairs(owned) do owned_total = owned_total + v end
+report("queue + mutex", start, owned_total)
@@ -0,0 +1,203 @@
+#include "CpuAffinity.h"
+
+#if defined(_WIN32)
+#include <Poco/UnWindows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+namespace LuaPoco
+{
+
+bool cpuAffinitySupported()
+{
+#if defined(_WIN32) || defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool setCurrentThreadAffinity(const CpuSet& cpus)
+{
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    const int maskBits = static_cast<int>(sizeof mask * 8);
+
+    if (cpus.empty())
+    {
+        DWORD_PTR systemMask = 0;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask) == 0) { return false; }
+    }
+
+    for (CpuSet::const_iterator i = cpus.begin(); i != cpus.end(); ++i)
+    {
+        // only the CPUs of the thread's processor group can be addressed.
+        if (*i < 0 || *i >= maskBits) { return false; }
+        mask |= static_cast<DWORD_PTR>(1) << *i;
+    }
+
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (cpus.empty())
+    {
+        long configured = sysconf(_SC_NPROCESSORS_CONF);
+        for (long i = 0; i < configured && i < CPU_SETSIZE; ++i) { CPU_SET(i, &set); }
+    }
+
+    for (CpuSet::const_iterator i = cpus.begin(); i != cpus.end(); ++i)
+    {
+        if (*i < 0 || *i >= CPU_SETSIZE) { return false; }
+        CPU_SET(*i, &set);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+    (void) cpus;
+    return false;
+#endif
+}
+
+bool currentCpu(int& cpu, int& node)
+{
+#if defined(_WIN32)
+    PROCESSOR_NUMBER pn;
+    GetCurrentProcessorNumberEx(&pn);
+    USHORT numaNode = 0;
+    if (GetNumaProcessorNodeEx(&pn, &numaNode) == 0) { return false; }
+
+    cpu = static_cast<int>(pn.Group) * 64 + static_cast<int>(pn.Number);
+    node = static_cast<int>(numaNode);
+    return true;
+#elif defined(__linux__) && defined(SYS_getcpu)
+    unsigned c = 0;
+    unsigned n = 0;
+    if (syscall(SYS_getcpu, &c, &n, NULL) != 0) { return false; }
+
+    cpu = static_cast<int>(c);
+    node = static_cast<int>(n);
+    return true;
+#else
+    (void) cpu;
+    (void) node;
+    return false;
+#endif
+}
+
+bool numaNodeCpus(int node, CpuSet& cpus)
+{
+    if (node < 0) { return false; }
+    cpus.clear();
+
+#if defined(_WIN32)
+    ULONGLONG mask = 0;
+    if (GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) == 0) { return false; }
+
+    for (int i = 0; i < 64; ++i)
+    {
+        if (mask & (static_cast<ULONGLONG>(1) << i)) { cpus.push_back(i); }
+    }
+
+    return !cpus.empty();
+#elif defined(__linux__)
+    std::ostringstream path;
+    path << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::ifstream cpulist(path.str().c_str());
+    std::string range;
+
+    // the list is formatted as comma separated ranges, ie: 0-7,16-23
+    while (std::getline(cpulist, range, ','))
+    {
+        int first = 0;
+        int last = 0;
+        char dash = 0;
+        std::istringstream rs(range);
+        if (!(rs >> first)) { break; }
+        if (!(rs >> dash >> last) || dash != '-') { last = first; }
+
+        for (int i = first; i <= last; ++i) { cpus.push_back(i); }
+    }
+
+    return !cpus.empty();
+#else
+    return false;
+#endif
+}
+
+bool readCpuSet(lua_State* L, int index, CpuSet& cpus)
+{
+    index = index < 0 ? lua_gettop(L) + 1 + index : index;
+    cpus.clear();
+
+    if (lua_type(L, index) == LUA_TNUMBER)
+    {
+        lua_Integer cpu = lua_tointeger(L, index);
+        if (cpu < 0) { return false; }
+        cpus.push_back(static_cast<int>(cpu));
+        return true;
+    }
+
+    if (!lua_istable(L, index)) { return false; }
+
+    for (int i = 1; ; ++i)
+    {
+        lua_rawgeti(L, index, i);
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            break;
+        }
+
+        bool valid = lua_type(L, -1) == LUA_TNUMBER && lua_tointeger(L, -1) >= 0;
+        if (valid) { cpus.push_back(static_cast<int>(lua_tointeger(L, -1))); }
+        lua_pop(L, 1);
+
+        if (!valid) { return false; }
+    }
+
+    return true;
+}
+
+int unavailableCpu(const CpuSet& cpus)
+{
+#if defined(_WIN32)
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    const int maskBits = static_cast<int>(sizeof processMask * 8);
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) == 0) { processMask = 0; }
+
+    for (CpuSet::const_iterator i = cpus.begin(); i != cpus.end(); ++i)
+    {
+        if (*i < 0 || *i >= maskBits || !(processMask & (static_cast<DWORD_PTR>(1) << *i))) { return *i; }
+    }
+#elif defined(__linux__)
+    // the affinity of the main thread, rather than of a calling thread which may be pinned itself.
+    // it excludes offline CPUs and those outside of the process's cpuset.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(getpid(), sizeof allowed, &allowed) != 0)
+    {
+        long configured = sysconf(_SC_NPROCESSORS_CONF);
+        for (long i = 0; i < configured && i < CPU_SETSIZE; ++i) { CPU_SET(i, &allowed); }
+    }
+
+    for (CpuSet::const_iterator i = cpus.begin(); i != cpus.end(); ++i)
+    {
+        if (*i < 0 || *i >= CPU_SETSIZE || !CPU_ISSET(*i, &allowed)) { return *i; }
+    }
+#else
+    if (!cpus.empty()) { return cpus.front(); }
+#endif
+    return -1;
+}
+
+} // LuaPoco
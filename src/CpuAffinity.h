@@ -0,0 +1,29 @@
+#ifndef LUA_POCO_CPUAFFINITY_H
+#define LUA_POCO_CPUAFFINITY_H
+
+#include "LuaPoco.h"
+#include <vector>
+
+namespace LuaPoco
+{
+
+// CPU indices a thread may run on, an empty set places no restriction.
+typedef std::vector<int> CpuSet;
+
+// returns false on platforms where threads cannot be restricted to a set of CPUs.
+bool cpuAffinitySupported();
+// restricts the calling thread to cpus, an empty set allows all CPUs again.
+bool setCurrentThreadAffinity(const CpuSet& cpus);
+// gets the CPU and NUMA node the calling thread is running on, returns false if not available.
+bool currentCpu(int& cpu, int& node);
+// gets the CPUs belonging to a NUMA node, returns false if not available.
+bool numaNodeCpus(int node, CpuSet& cpus);
+// reads a single CPU index or an array of CPU indices from the Lua value at index.
+// returns false if the value is neither, or contains a negative index.
+bool readCpuSet(lua_State* L, int index, CpuSet& cpus);
+// returns the first CPU of cpus the process is not allowed to run on, or -1 when all of them are allowed.
+int unavailableCpu(const CpuSet& cpus);
+
+} // LuaPoco
+
+#endif
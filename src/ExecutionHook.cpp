@@ -0,0 +1,115 @@
+#include "ExecutionHook.h"
+
+#if defined(_WIN32)
+#include <Poco/UnWindows.h>
+#else
+#include <time.h>
+#endif
+
+namespace LuaPoco
+{
+
+const char* POCO_EXECUTION_HOOK_KEY = "Poco.ExecutionHook.lightuserdata";
+
+bool threadCpuTime(Poco::Int64& microseconds)
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) == 0) { return false; }
+
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    // FILETIME is in 100 nanosecond units.
+    microseconds = static_cast<Poco::Int64>((k.QuadPart + u.QuadPart) / 10);
+    return true;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) { return false; }
+
+    microseconds = static_cast<Poco::Int64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    return true;
+#else
+    (void) microseconds;
+    return false;
+#endif
+}
+
+ExecutionHook::ExecutionHook() :
+    mInstructionCount(0),
+    mTimeLimit(0),
+    mCpuLimit(0),
+    mCpuStart(0),
+    mStopReason(NOT_STOPPED)
+{
+}
+
+ExecutionHook::~ExecutionHook()
+{
+}
+
+void ExecutionHook::configureHook(int instructionCount, long timeLimit, long cpuLimit)
+{
+    mInstructionCount = instructionCount > 0 ? instructionCount : 0;
+    mTimeLimit = timeLimit > 0 ? static_cast<Poco::Clock::ClockDiff>(timeLimit) * 1000 : 0;
+    mCpuLimit = cpuLimit > 0 ? static_cast<Poco::Int64>(cpuLimit) * 1000 : 0;
+}
+
+void ExecutionHook::installHook(lua_State* L)
+{
+    mStopReason = NOT_STOPPED;
+    if (mInstructionCount == 0) { return; }
+
+    mStart.update();
+    if (mCpuLimit > 0 && !threadCpuTime(mCpuStart)) { mCpuLimit = 0; }
+
+    lua_pushlightuserdata(L, static_cast<void*>(this));
+    lua_setfield(L, LUA_REGISTRYINDEX, POCO_EXECUTION_HOOK_KEY);
+    lua_sethook(L, hook, LUA_MASKCOUNT, mInstructionCount);
+}
+
+ExecutionHook::Reason ExecutionHook::stopReason() const
+{
+    return mStopReason;
+}
+
+// returns an error message when the running code should be stopped, otherwise NULL.
+const char* ExecutionHook::checkLimits()
+{
+    if (isCancelRequested())
+    {
+        mStopReason = CANCELLED;
+        return "execution cancelled";
+    }
+
+    if (mTimeLimit > 0 && mStart.isElapsed(mTimeLimit))
+    {
+        mStopReason = TIME_LIMIT;
+        return "execution time limit exceeded";
+    }
+
+    Poco::Int64 cpuNow = 0;
+    if (mCpuLimit > 0 && threadCpuTime(cpuNow) && cpuNow - mCpuStart >= mCpuLimit)
+    {
+        mStopReason = CPU_LIMIT;
+        return "execution cpu time limit exceeded";
+    }
+
+    return NULL;
+}
+
+void ExecutionHook::hook(lua_State* L, lua_Debug* ar)
+{
+    (void) ar;
+    lua_getfield(L, LUA_REGISTRYINDEX, POCO_EXECUTION_HOOK_KEY);
+    ExecutionHook* eh = static_cast<ExecutionHook*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    const char* errorMsg = eh ? eh->checkLimits() : NULL;
+    // the error is raised again on the next count if the Lua code catches it with pcall.
+    if (errorMsg) { luaL_error(L, "%s", errorMsg); }
+}
+
+} // LuaPoco
@@ -0,0 +1,51 @@
+#ifndef LUA_POCO_EXECUTIONHOOK_H
+#define LUA_POCO_EXECUTIONHOOK_H
+
+#include "LuaPoco.h"
+#include <Poco/Types.h>
+#include <Poco/Clock.h>
+
+namespace LuaPoco
+{
+
+// gets the CPU time consumed by the calling thread in microseconds.
+// returns false on platforms where per thread CPU time is not available.
+bool threadCpuTime(Poco::Int64& microseconds);
+
+// opt-in instruction count hook for Lua states running on their own thread (Task, ThreadUserdata).
+// once the owner requests cancellation, or a time budget runs out, the hook raises an error in the
+// running Lua code so the thread is returned promptly rather than waiting for the code to notice.
+class ExecutionHook
+{
+public:
+    enum Reason { NOT_STOPPED, CANCELLED, TIME_LIMIT, CPU_LIMIT };
+
+    ExecutionHook();
+    virtual ~ExecutionHook();
+    // instructionCount is the number of VM instructions between checks, 0 disables the hook.
+    // timeLimit and cpuLimit are budgets in milliseconds, 0 is unlimited.
+    void configureHook(int instructionCount, long timeLimit, long cpuLimit);
+    // installs the hook on L and starts the budgets, must be called from the thread that runs L.
+    void installHook(lua_State* L);
+    // reason the hook stopped the running code.
+    Reason stopReason() const;
+
+protected:
+    // derived classes report whether the running code has been asked to stop.
+    virtual bool isCancelRequested() = 0;
+
+private:
+    static void hook(lua_State* L, lua_Debug* ar);
+    const char* checkLimits();
+
+    int mInstructionCount;
+    Poco::Clock::ClockDiff mTimeLimit;
+    Poco::Int64 mCpuLimit;
+    Poco::Clock mStart;
+    Poco::Int64 mCpuStart;
+    Reason mStopReason;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,208 @@
+#include "LockProfile.h"
+#include "Userdata.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+#include <map>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+typedef std::map<std::string, Poco::SharedPtr<LockStats> > LockStatsRegistry;
+
+Poco::FastMutex& registryMutex()
+{
+    static Poco::FastMutex mutex;
+    return mutex;
+}
+
+LockStatsRegistry& registry()
+{
+    static LockStatsRegistry stats;
+    return stats;
+}
+
+void setField(lua_State* L, const char* name, Poco::UInt64 value)
+{
+    pushInteger(L, static_cast<Poco::Int64>(value));
+    lua_setfield(L, -2, name);
+}
+
+}
+
+LockStats::LockStats(const std::string& name) :
+    mName(name),
+    mTrackHold(false),
+    mAcquisitions(0),
+    mContended(0),
+    mFailed(0),
+    mWaitTime(0),
+    mMaxWait(0),
+    mHoldTime(0),
+    mMaxHold(0)
+{
+}
+
+LockStats::~LockStats()
+{
+}
+
+void LockStats::acquired(bool contended, Poco::Int64 wait)
+{
+    Poco::UInt64 w = wait > 0 ? static_cast<Poco::UInt64>(wait) : 0;
+    mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) { mContended.fetch_add(1, std::memory_order_relaxed); }
+    mWaitTime.fetch_add(w, std::memory_order_relaxed);
+    updateMax(mMaxWait, w);
+}
+
+void LockStats::failed()
+{
+    mFailed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStats::held(Poco::Int64 hold)
+{
+    Poco::UInt64 h = hold > 0 ? static_cast<Poco::UInt64>(hold) : 0;
+    mHoldTime.fetch_add(h, std::memory_order_relaxed);
+    updateMax(mMaxHold, h);
+}
+
+void LockStats::trackHold()
+{
+    mTrackHold.store(true, std::memory_order_relaxed);
+}
+
+void LockStats::push(lua_State* L) const
+{
+    lua_newtable(L);
+    if (!mName.empty())
+    {
+        lua_pushlstring(L, mName.c_str(), mName.size());
+        lua_setfield(L, -2, "name");
+    }
+
+    setField(L, "acquisitions", mAcquisitions.load(std::memory_order_relaxed));
+    setField(L, "contended", mContended.load(std::memory_order_relaxed));
+    setField(L, "failed", mFailed.load(std::memory_order_relaxed));
+    setField(L, "waitTime", mWaitTime.load(std::memory_order_relaxed));
+    setField(L, "maxWait", mMaxWait.load(std::memory_order_relaxed));
+
+    if (mTrackHold.load(std::memory_order_relaxed))
+    {
+        setField(L, "holdTime", mHoldTime.load(std::memory_order_relaxed));
+        setField(L, "maxHold", mMaxHold.load(std::memory_order_relaxed));
+    }
+}
+
+Poco::SharedPtr<LockStats> LockStats::get(const std::string& name)
+{
+    if (name.empty()) { return new LockStats(name); }
+
+    Poco::ScopedLock<Poco::FastMutex> lock(registryMutex());
+    Poco::SharedPtr<LockStats>& stats = registry()[name];
+    if (stats.isNull()) { stats = new LockStats(name); }
+
+    return stats;
+}
+
+void LockStats::release(Poco::SharedPtr<LockStats>& stats)
+{
+    if (stats.isNull() || stats->mName.empty())
+    {
+        stats = NULL;
+        return;
+    }
+
+    // the reference is dropped under the registry lock, such that only one lock sees the registry's as the last.
+    Poco::ScopedLock<Poco::FastMutex> lock(registryMutex());
+    std::string name(stats->mName);
+    stats = NULL;
+
+    LockStatsRegistry::iterator i = registry().find(name);
+    if (i != registry().end() && i->second.referenceCount() == 1) { registry().erase(i); }
+}
+
+void LockStats::updateMax(std::atomic<Poco::UInt64>& max, Poco::UInt64 value)
+{
+    Poco::UInt64 current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+LockProfile::LockProfile(const Poco::SharedPtr<LockStats>& stats, bool trackHold) :
+    mStats(stats),
+    mTrackHold(trackHold),
+    mDepth(0)
+{
+    if (mTrackHold) { mStats->trackHold(); }
+}
+
+LockProfile::~LockProfile()
+{
+    LockStats::release(mStats);
+}
+
+void LockProfile::acquired(bool contended, Poco::Int64 wait)
+{
+    mStats->acquired(contended, wait);
+    if (mTrackHold && mDepth++ == 0) { mAcquiredAt.update(); }
+}
+
+void LockProfile::failed()
+{
+    mStats->failed();
+}
+
+void LockProfile::releasing()
+{
+    if (mTrackHold && mDepth > 0 && --mDepth == 0) { mStats->held(mAcquiredAt.elapsed()); }
+}
+
+const LockStats& LockProfile::stats() const
+{
+    return *mStats;
+}
+
+Poco::SharedPtr<LockProfile> readLockProfile(lua_State* L, int index, bool trackHold)
+{
+    Poco::SharedPtr<LockProfile> profile;
+    int type = lua_type(L, index);
+
+    if (type == LUA_TNONE || type == LUA_TNIL || (type == LUA_TBOOLEAN && !lua_toboolean(L, index))) { return profile; }
+    if (type != LUA_TBOOLEAN && type != LUA_TSTRING)
+    {
+        luaL_argerror(L, index, "expected boolean or profile name string");
+    }
+
+    try
+    {
+        std::string name;
+        if (type == LUA_TSTRING) { name = lua_tostring(L, index); }
+        profile = new LockProfile(LockStats::get(name), trackHold);
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    return profile;
+}
+
+int pushLockStats(lua_State* L, const Poco::SharedPtr<LockProfile>& profile)
+{
+    if (profile.isNull())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "profiling is not enabled.");
+        return 2;
+    }
+
+    profile->stats().push(L);
+    return 1;
+}
+
+} // LuaPoco
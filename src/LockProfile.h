@@ -0,0 +1,116 @@
+#ifndef LUA_POCO_LOCKPROFILE_H
+#define LUA_POCO_LOCKPROFILE_H
+
+#include "LuaPoco.h"
+#include <Poco/Clock.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+#include <atomic>
+#include <string>
+
+namespace LuaPoco
+{
+
+// contention counters, shared by every lock profiled under the same name. times are in microseconds.
+class LockStats
+{
+public:
+    LockStats(const std::string& name);
+    ~LockStats();
+
+    void acquired(bool contended, Poco::Int64 wait);
+    void failed();
+    void held(Poco::Int64 hold);
+    // reports hold times from now on, called for each lock sharing the stats that tracks them.
+    void trackHold();
+    // pushes a table of the counters, with hold times once any of the locks sharing the stats tracks them.
+    void push(lua_State* L) const;
+
+    // gets the stats for name, created on first use. an empty name gets new stats which are not shared.
+    static Poco::SharedPtr<LockStats> get(const std::string& name);
+    // drops a reference from get(), removing the stats of a name from the registry along with its last lock.
+    static void release(Poco::SharedPtr<LockStats>& stats);
+
+private:
+    static void updateMax(std::atomic<Poco::UInt64>& max, Poco::UInt64 value);
+
+    std::string mName;
+    std::atomic<bool> mTrackHold;
+    std::atomic<Poco::UInt64> mAcquisitions;
+    std::atomic<Poco::UInt64> mContended;
+    std::atomic<Poco::UInt64> mFailed;
+    std::atomic<Poco::UInt64> mWaitTime;
+    std::atomic<Poco::UInt64> mMaxWait;
+    std::atomic<Poco::UInt64> mHoldTime;
+    std::atomic<Poco::UInt64> mMaxHold;
+};
+
+// profiling state of a single lock, shared by the userdata copies of the lock.
+// acquisitions first try the lock without blocking, and count as contended when that fails.
+class LockProfile
+{
+public:
+    // hold times are not meaningful for semaphores, which are usually released by another thread.
+    LockProfile(const Poco::SharedPtr<LockStats>& stats, bool trackHold);
+    ~LockProfile();
+
+    template <class M>
+    void lock(M& mutex)
+    {
+        if (mutex.tryLock()) { acquired(false, 0); return; }
+
+        Poco::Clock start;
+        mutex.lock();
+        acquired(true, start.elapsed());
+    }
+
+    // ms <= 0 makes a single attempt.
+    template <class M>
+    bool tryLock(M& mutex, long ms)
+    {
+        if (mutex.tryLock()) { acquired(false, 0); return true; }
+
+        Poco::Clock start;
+        if (ms > 0 && mutex.tryLock(ms))
+        {
+            acquired(true, start.elapsed());
+            return true;
+        }
+
+        failed();
+        return false;
+    }
+
+    template <class M>
+    void unlock(M& mutex)
+    {
+        releasing();
+        mutex.unlock();
+    }
+
+    // records an acquisition made by other means, such as a semaphore wait.
+    void acquired(bool contended, Poco::Int64 wait);
+    void failed();
+    const LockStats& stats() const;
+
+private:
+    // called with the lock held, before it is released.
+    void releasing();
+
+    Poco::SharedPtr<LockStats> mStats;
+    bool mTrackHold;
+    // only accessed by the thread holding the lock, recursive acquisitions are timed from the outermost one.
+    Poco::Clock mAcquiredAt;
+    int mDepth;
+};
+
+// reads the profiling option of a lock constructor at index: nil or false for none, true for unnamed stats,
+// or a name to aggregate the stats of all locks with that name. raises an error for any other value.
+Poco::SharedPtr<LockProfile> readLockProfile(lua_State* L, int index, bool trackHold);
+
+// lua_CFunction body for the stats method of profiled locks.
+int pushLockStats(lua_State* L, const Poco::SharedPtr<LockProfile>& profile);
+
+} // LuaPoco
+
+#endif
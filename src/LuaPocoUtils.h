@@ -1,6 +1,10 @@
+#ifndef LUA_POCO_UTILS_H
+#define LUA_POCO_UTILS_H
+
 #include <limits>
 #include <type_traits>
 #include "LuaPoco.h"
+#include <Poco/Types.h>
 
 namespace LuaPoco
 {
@@ -54,4 +58,16 @@ bool checkSignedToLuaInteger(T num, lua_Integer& li)
     return false;
 }
 
+// pushes an integer, as a number on Lua versions before 5.3 which have no integer subtype.
+inline void pushInteger(lua_State* L, Poco::Int64 integer)
+{
+#if LUA_VERSION_NUM > 502
+    lua_pushinteger(L, static_cast<lua_Integer>(integer));
+#else
+    lua_pushnumber(L, static_cast<lua_Number>(integer));
+#endif
 }
+
+}
+
+#endif
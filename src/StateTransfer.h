@@ -11,6 +11,10 @@ const char* functionReader(lua_State* L, void* data, size_t* size);
 bool transferFunction(lua_State* toL, lua_State* fromL);
 bool transferValue(lua_State* toL, lua_State* fromL);
 
+// stack slots transferValue may use on each state above the value being transferred,
+// including those used by the copyToState of userdata.
+const int TRANSFER_STACK_SLOTS = 16;
+
 } // LuaPoco
 
 
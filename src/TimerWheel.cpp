@@ -0,0 +1,340 @@
+#include "TimerWheel.h"
+#include <Poco/ScopedLock.h>
+#include <Poco/Exception.h>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+const Poco::UInt64 SLOT_MASK = TimerWheel::SLOTS - 1;
+// furthest a timer can be placed from the current tick, timers beyond it are placed again as they cascade.
+const Poco::UInt64 MAX_TICKS = (static_cast<Poco::UInt64>(1) << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+}
+
+TimerWheel::Timer::Timer() :
+    mSlot(NULL),
+    mPrev(NULL),
+    mNext(NULL),
+    mId(0),
+    mExpires(0),
+    mInterval(0),
+    mFiring(false),
+    mCancelled(false)
+{
+}
+
+TimerWheel::Timer::~Timer()
+{
+}
+
+Poco::UInt64 TimerWheel::Timer::id() const
+{
+    return mId;
+}
+
+TimerWheel::TimerWheel(long resolution) :
+    mResolution(resolution > 0 ? resolution : 1),
+    mTick(0),
+    mNextId(1),
+    mFired(0),
+    mSkipped(0),
+    mStarted(false),
+    mStopping(false),
+    mStoppedByTimer(NULL)
+{
+    std::memset(mSlots, 0, sizeof mSlots);
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+Poco::UInt64 TimerWheel::schedule(Timer* timer, long delay, long interval)
+{
+    try
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+        if (mStopping) { throw Poco::IllegalStateException("timer wheel is stopped"); }
+
+        if (!mStarted)
+        {
+            mThread.start(*this);
+            mStarted = true;
+        }
+
+        Poco::UInt64 now = elapsedMs();
+        // the wheel thread is idle while no timers are pending, so mTick may be far behind.
+        if (mTimers.empty()) { mTick = now / mResolution; }
+
+        // round up such that the timer never fires early.
+        Poco::UInt64 delayMs = delay > 0 ? static_cast<Poco::UInt64>(delay) : 0;
+        timer->mExpires = (now + delayMs + mResolution - 1) / mResolution;
+        timer->mInterval = interval > 0 ? (static_cast<Poco::UInt64>(interval) + mResolution - 1) / mResolution : 0;
+        timer->mId = mNextId;
+        mTimers[timer->mId] = timer;
+        ++mNextId;
+        place(timer);
+
+        if (mTimers.size() == 1) { mWake.set(); }
+        return timer->mId;
+    }
+    catch (...)
+    {
+        delete timer;
+        throw;
+    }
+}
+
+bool TimerWheel::cancel(Poco::UInt64 id)
+{
+    Timer* timer = NULL;
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+        TimerIndex::iterator i = mTimers.find(id);
+        if (i == mTimers.end()) { return false; }
+
+        // the wheel thread owns a firing timer, and deletes it once fire() returns.
+        if (i->second->mFiring)
+        {
+            i->second->mCancelled = true;
+            return true;
+        }
+
+        timer = i->second;
+        unlink(timer);
+        mTimers.erase(i);
+    }
+
+    delete timer;
+    return true;
+}
+
+void TimerWheel::stop()
+{
+    bool started = false;
+    bool wheelThread = isWheelThread();
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+        if (mStopping) { return; }
+        mStopping = true;
+        started = mStarted;
+    }
+
+    mWake.set();
+    if (wheelThread) { *mStoppedByTimer = true; }
+    else if (started) { mThread.join(); }
+
+    // the wheel thread has exited, or is in a timer's fire() and deletes the firing timers itself.
+    for (TimerIndex::iterator i = mTimers.begin(); i != mTimers.end(); ++i)
+    {
+        if (!i->second->mFiring) { delete i->second; }
+    }
+    mTimers.clear();
+    std::memset(mSlots, 0, sizeof mSlots);
+}
+
+bool TimerWheel::isWheelThread() const
+{
+    return Poco::Thread::current() == &mThread;
+}
+
+TimerWheel::Stats TimerWheel::stats()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    Stats s;
+    s.active = mTimers.size();
+    s.fired = mFired;
+    s.skipped = mSkipped;
+    return s;
+}
+
+void TimerWheel::run()
+{
+    std::vector<Timer*> expired;
+    std::vector<Timer*> finished;
+    long waitMs = -1;
+    // once set, the wheel may have been destroyed and only the local vectors remain valid.
+    bool stoppedByTimer = false;
+    mStoppedByTimer = &stoppedByTimer;
+
+    while (true)
+    {
+        {
+            Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+            if (mStopping) { break; }
+
+            Poco::UInt64 now = elapsedMs() / mResolution;
+            while (!mTimers.empty() && mTick <= now) { advance(expired); }
+        }
+
+        for (std::vector<Timer*>::iterator i = expired.begin(); i != expired.end(); ++i)
+        {
+            bool again = false;
+            try { again = (*i)->fire(); }
+            catch (...) { }
+
+            if (stoppedByTimer)
+            {
+                deleteTimers(expired, 0);
+                return;
+            }
+
+            // mInterval is only used by the wheel thread once the timer is scheduled.
+            if (!again) { (*i)->mInterval = 0; }
+        }
+
+        {
+            Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+            for (std::vector<Timer*>::iterator i = expired.begin(); i != expired.end(); ++i)
+            {
+                Timer* timer = *i;
+                timer->mFiring = false;
+                ++mFired;
+
+                if (timer->mCancelled || timer->mInterval == 0 || mStopping)
+                {
+                    mTimers.erase(timer->mId);
+                    finished.push_back(timer);
+                    continue;
+                }
+
+                // keep a fixed cadence, skipping the firings that have already been missed.
+                timer->mExpires += timer->mInterval;
+                while (timer->mExpires < mTick)
+                {
+                    timer->mExpires += timer->mInterval;
+                    ++mSkipped;
+                }
+                place(timer);
+            }
+            expired.clear();
+
+            if (mTimers.empty()) { waitMs = -1; }
+            else
+            {
+                Poco::UInt64 now = elapsedMs();
+                Poco::UInt64 next = mTick * mResolution;
+                waitMs = next > now ? static_cast<long>(next - now) : 0;
+            }
+        }
+
+        for (size_t i = 0; i < finished.size(); ++i)
+        {
+            delete finished[i];
+            if (stoppedByTimer)
+            {
+                deleteTimers(finished, i + 1);
+                return;
+            }
+        }
+        finished.clear();
+
+        if (waitMs < 0) { mWake.wait(); }
+        else if (waitMs > 0) { mWake.tryWait(waitMs); }
+    }
+}
+
+void TimerWheel::deleteTimers(std::vector<Timer*>& timers, size_t first)
+{
+    for (size_t i = first; i < timers.size(); ++i) { delete timers[i]; }
+    timers.clear();
+}
+
+Poco::UInt64 TimerWheel::elapsedMs()
+{
+    return static_cast<Poco::UInt64>(mClock.elapsed() / 1000);
+}
+
+void TimerWheel::link(Timer* timer, Timer** slot)
+{
+    timer->mSlot = slot;
+    timer->mPrev = NULL;
+    timer->mNext = *slot;
+    if (*slot) { (*slot)->mPrev = timer; }
+    *slot = timer;
+}
+
+void TimerWheel::unlink(Timer* timer)
+{
+    if (!timer->mSlot) { return; }
+
+    if (timer->mPrev) { timer->mPrev->mNext = timer->mNext; }
+    else { *timer->mSlot = timer->mNext; }
+    if (timer->mNext) { timer->mNext->mPrev = timer->mPrev; }
+
+    timer->mSlot = NULL;
+    timer->mPrev = NULL;
+    timer->mNext = NULL;
+}
+
+// links the timer into the lowest level with a slot covering its expiry.
+void TimerWheel::place(Timer* timer)
+{
+    Poco::UInt64 expires = timer->mExpires < mTick ? mTick : timer->mExpires;
+    Poco::UInt64 delta = expires - mTick;
+    if (delta > MAX_TICKS)
+    {
+        expires = mTick + MAX_TICKS;
+        delta = MAX_TICKS;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >> (SLOT_BITS * (level + 1)) != 0) { ++level; }
+
+    int index = static_cast<int>((expires >> (SLOT_BITS * level)) & SLOT_MASK);
+    link(timer, &mSlots[level][index]);
+}
+
+// places the timers of a slot again, which moves them to lower levels as their expiry approaches.
+void TimerWheel::cascade(int level, int index)
+{
+    Timer* timer = mSlots[level][index];
+    mSlots[level][index] = NULL;
+
+    while (timer)
+    {
+        Timer* next = timer->mNext;
+        timer->mSlot = NULL;
+        place(timer);
+        timer = next;
+    }
+}
+
+// processes mTick, collecting the timers due to fire.
+void TimerWheel::advance(std::vector<Timer*>& expired)
+{
+    int index = static_cast<int>(mTick & SLOT_MASK);
+
+    // each time a level wraps around, the next slot of the level above is due.
+    int upperIndex = index;
+    for (int level = 1; upperIndex == 0 && level < LEVELS; ++level)
+    {
+        upperIndex = static_cast<int>((mTick >> (SLOT_BITS * level)) & SLOT_MASK);
+        cascade(level, upperIndex);
+    }
+
+    Timer** slot = &mSlots[0][index];
+    while (*slot)
+    {
+        Timer* timer = *slot;
+        unlink(timer);
+
+        if (timer->mExpires > mTick) { place(timer); }
+        else
+        {
+            timer->mFiring = true;
+            expired.push_back(timer);
+        }
+    }
+
+    ++mTick;
+}
+
+} // LuaPoco
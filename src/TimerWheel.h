@@ -0,0 +1,109 @@
+#ifndef LUA_POCO_TIMERWHEEL_H
+#define LUA_POCO_TIMERWHEEL_H
+
+#include <Poco/Types.h>
+#include <Poco/Clock.h>
+#include <Poco/Mutex.h>
+#include <Poco/Event.h>
+#include <Poco/Thread.h>
+#include <Poco/Runnable.h>
+#include <unordered_map>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// hierarchical timer wheel serviced by a single thread, which is started with the first timer.
+// timers are linked into per slot lists, such that scheduling and cancelling are constant time.
+// level n of the wheel has SLOTS slots each spanning SLOTS^n ticks, timers are moved down a level
+// as the lower level wraps around.
+class TimerWheel : public Poco::Runnable
+{
+public:
+    enum { LEVELS = 4, SLOT_BITS = 6, SLOTS = 1 << SLOT_BITS };
+
+    class Timer
+    {
+    public:
+        Timer();
+        virtual ~Timer();
+        Poco::UInt64 id() const;
+
+    protected:
+        // called from the wheel thread, without the wheel lock held, each time the timer expires.
+        // returning false stops a periodic timer.
+        virtual bool fire() = 0;
+
+    private:
+        friend class TimerWheel;
+        Timer** mSlot;
+        Timer* mPrev;
+        Timer* mNext;
+        Poco::UInt64 mId;
+        // tick the timer is due to fire on.
+        Poco::UInt64 mExpires;
+        // ticks between firings, 0 for a one shot timer.
+        Poco::UInt64 mInterval;
+        bool mFiring;
+        bool mCancelled;
+    };
+
+    struct Stats
+    {
+        Poco::UInt64 active;
+        Poco::UInt64 fired;
+        // periodic firings skipped as the previous firing fell behind by more than an interval.
+        Poco::UInt64 skipped;
+    };
+
+    // resolution is the length of a tick in milliseconds.
+    TimerWheel(long resolution);
+    virtual ~TimerWheel();
+
+    // takes ownership of timer, which first fires after delay milliseconds, then every interval
+    // milliseconds when interval is above 0. returns the id to cancel the timer with.
+    Poco::UInt64 schedule(Timer* timer, long delay, long interval);
+    // returns false when no timer with id is scheduled.
+    bool cancel(Poco::UInt64 id);
+    // stops the wheel thread and deletes all timers, no timers may be scheduled afterwards.
+    // when called from a timer on the wheel thread, ie: as the last reference to the wheel's owner
+    // is released, the thread is not joined and exits without touching the wheel once the timer returns.
+    void stop();
+    // returns true when called from the wheel thread.
+    bool isWheelThread() const;
+    Stats stats();
+
+    virtual void run();
+
+private:
+    Poco::UInt64 elapsedMs();
+    void link(Timer* timer, Timer** slot);
+    void unlink(Timer* timer);
+    void place(Timer* timer);
+    void cascade(int level, int index);
+    void advance(std::vector<Timer*>& expired);
+    static void deleteTimers(std::vector<Timer*>& timers, size_t first);
+
+    typedef std::unordered_map<Poco::UInt64, Timer*> TimerIndex;
+
+    Poco::FastMutex mMutex;
+    Poco::Event mWake;
+    Poco::Thread mThread;
+    Poco::Clock mClock;
+    long mResolution;
+    // the next tick to be processed.
+    Poco::UInt64 mTick;
+    Poco::UInt64 mNextId;
+    Poco::UInt64 mFired;
+    Poco::UInt64 mSkipped;
+    bool mStarted;
+    bool mStopping;
+    // local flag of run(), set by stop() when called from the wheel thread.
+    bool* mStoppedByTimer;
+    TimerIndex mTimers;
+    Timer* mSlots[LEVELS][SLOTS];
+};
+
+} // LuaPoco
+
+#endif
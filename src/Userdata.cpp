@@ -139,6 +139,21 @@ int loadConstructor(lua_State*L, lua_CFunction cons)
     return 1;
 }
 
+// the module table is its own metatable with cons as __call, which a table argument to module.new() is not.
+int constructorFirstArg(lua_State* L, lua_CFunction cons)
+{
+    int firstArg = 1;
+
+    if (lua_istable(L, 1) && lua_getmetatable(L, 1))
+    {
+        lua_getfield(L, -1, "__call");
+        if (lua_tocfunction(L, -1) == cons) { firstArg = 2; }
+        lua_pop(L, 2);
+    }
+
+    return firstArg;
+}
+
 // stores Userdata pointer in a private table with the derived userdata as a weak key.
 void setPrivateUserdata(lua_State* L, int userdataIdx, Userdata* ud)
 {
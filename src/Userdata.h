@@ -66,6 +66,10 @@ void setupPrivateUserdata(lua_State* L);
 // module.new() or module()
 int loadConstructor(lua_State*L, lua_CFunction cons);
 
+// gets the index of the first argument passed to a constructor set up by loadConstructor,
+// which is 2 when called as module(), as the module table is passed to __call, and 1 when called as module.new().
+int constructorFirstArg(lua_State* L, lua_CFunction cons);
+
 // sets the association between a specific Userdata pointer and the base Userdata pointer.
 void setPrivateUserdata(lua_State* L, int userdataIdx, Userdata* ud);
 
@@ -0,0 +1,284 @@
+/// 64 bit atomic integers shared between threads and processes.
+// An atomic is updated with single lock free processor instructions, which makes it far cheaper
+// than locking a mutex around a shared counter.
+//
+// An atomic can also be placed at an offset within a sharedmemory region, such that processes mapping the
+// same region share the counter.
+//
+// Note: atomic userdata are copyable/sharable between threads, all copies refer to the same integer.
+// @module atomic
+
+#include "Atomic.h"
+#include "SharedMemory.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Exception.h>
+
+int luaopen_poco_atomic(lua_State* L)
+{
+    LuaPoco::AtomicUserdata::registerAtomic(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::AtomicUserdata::Atomic);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_ATOMIC_METATABLE_NAME = "Poco.Atomic.metatable";
+
+namespace
+{
+
+Poco::Int64 checkInteger(lua_State* L, int index)
+{
+#if LUA_VERSION_NUM > 502
+    return static_cast<Poco::Int64>(luaL_checkinteger(L, index));
+#else
+    return static_cast<Poco::Int64>(luaL_checknumber(L, index));
+#endif
+}
+
+}
+
+AtomicInteger::AtomicInteger(Poco::Int64 initial) :
+    mLocal(initial),
+    mValue(&mLocal)
+{
+}
+
+AtomicInteger::AtomicInteger(const Poco::SharedMemory& region, size_t offset) :
+    mLocal(0),
+    mValue(reinterpret_cast<std::atomic<Poco::Int64>*>(region.begin() + offset)),
+    mRegion(region)
+{
+}
+
+AtomicInteger::~AtomicInteger()
+{
+}
+
+std::atomic<Poco::Int64>& AtomicInteger::value()
+{
+    return *mValue;
+}
+
+AtomicUserdata::AtomicUserdata(const Poco::SharedPtr<AtomicInteger>& atomic) :
+    mAtomic(atomic)
+{
+}
+
+AtomicUserdata::~AtomicUserdata()
+{
+}
+
+bool AtomicUserdata::copyToState(lua_State *L)
+{
+    registerAtomic(L);
+    AtomicUserdata* aud = NULL;
+    void* p = lua_newuserdata(L, sizeof *aud);
+
+    try
+    {
+        aud = new(p) AtomicUserdata(mAtomic);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, aud, POCO_ATOMIC_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool AtomicUserdata::registerAtomic(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "get", get },
+        { "set", set },
+        { "add", add },
+        { "fetchAdd", fetchAdd },
+        { "compareExchange", compareExchange },
+        { "exchange", exchange },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_ATOMIC_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new atomic userdata.
+// The atomic is either held by the userdata, or placed within a sharedmemory region opened for writing.
+// An atomic placed within a sharedmemory region keeps the region mapped for as long as the atomic exists,
+// and its value is left untouched unless an initial value is supplied.
+// @param[opt] value initial integer value (default: 0), or a sharedmemory userdata.
+// @int[opt] offset when value is a sharedmemory userdata, the byte offset of the atomic within the region,
+// which must be a multiple of 8.
+// @int[opt] initial when value is a sharedmemory userdata, optional value to store in the region.
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+// @see sharedmemory
+int AtomicUserdata::Atomic(lua_State* L)
+{
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    Poco::SharedPtr<AtomicInteger> atomic;
+
+    if (lua_type(L, firstArg) == LUA_TUSERDATA)
+    {
+        SharedMemoryUserdata* smud = checkPrivateUserdata<SharedMemoryUserdata>(L, firstArg);
+        Poco::Int64 offset = checkInteger(L, firstArg + 1);
+        bool hasInitial = !lua_isnoneornil(L, firstArg + 2);
+        Poco::Int64 initial = hasInitial ? checkInteger(L, firstArg + 2) : 0;
+
+        const char* errorMsg = NULL;
+        if (smud->mMode != Poco::SharedMemory::AM_WRITE)
+            errorMsg = "read only sharedmemory cannot be used with atomic.";
+        else if (offset < 0 || static_cast<Poco::UInt64>(offset) + sizeof(Poco::Int64) > smud->mSize)
+            errorMsg = "offset is outside of the sharedmemory region.";
+        else if ((reinterpret_cast<Poco::UIntPtr>(smud->mSharedMemory.begin()) + static_cast<Poco::UIntPtr>(offset)) % sizeof(Poco::Int64) != 0)
+            errorMsg = "offset is not aligned to 8 bytes.";
+        else if (!std::atomic<Poco::Int64>().is_lock_free())
+            errorMsg = "64 bit atomics are not lock free on this platform, and cannot be shared between processes.";
+
+        if (errorMsg)
+        {
+            lua_pushnil(L);
+            lua_pushstring(L, errorMsg);
+            return 2;
+        }
+
+        try
+        {
+            atomic = new AtomicInteger(smud->mSharedMemory, static_cast<size_t>(offset));
+            if (hasInitial) { atomic->value().store(initial); }
+        }
+        catch (const std::exception& e)
+        {
+            return pushException(L, e);
+        }
+    }
+    else
+    {
+        Poco::Int64 initial = lua_isnoneornil(L, firstArg) ? 0 : checkInteger(L, firstArg);
+
+        try
+        {
+            atomic = new AtomicInteger(initial);
+        }
+        catch (const std::exception& e)
+        {
+            return pushException(L, e);
+        }
+    }
+
+    AtomicUserdata* aud = NULL;
+    void* p = lua_newuserdata(L, sizeof *aud);
+
+    try
+    {
+        aud = new(p) AtomicUserdata(atomic);
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    setupPocoUserdata(L, aud, POCO_ATOMIC_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type atomic
+
+// metamethod infrastructure
+int AtomicUserdata::metamethod__tostring(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+
+    lua_pushfstring(L, "Poco.Atomic (%p)", static_cast<void*>(aud));
+    return 1;
+}
+
+// userdata methods
+
+/// Gets the current value.
+// @return integer.
+// @function get
+int AtomicUserdata::get(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    pushInteger(L, aud->mAtomic->value().load());
+    return 1;
+}
+
+/// Sets the value.
+// @int value new value.
+// @function set
+int AtomicUserdata::set(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    Poco::Int64 value = checkInteger(L, 2);
+    aud->mAtomic->value().store(value);
+    return 0;
+}
+
+/// Adds to the value.
+// @int[opt] delta amount to add, which may be negative. (default: 1)
+// @return the resulting value.
+// @function add
+int AtomicUserdata::add(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    Poco::Int64 delta = lua_isnoneornil(L, 2) ? 1 : checkInteger(L, 2);
+    Poco::UInt64 previous = static_cast<Poco::UInt64>(aud->mAtomic->value().fetch_add(delta));
+    // wraps around on overflow, as the atomic itself does.
+    pushInteger(L, static_cast<Poco::Int64>(previous + static_cast<Poco::UInt64>(delta)));
+    return 1;
+}
+
+/// Adds to the value.
+// @int[opt] delta amount to add, which may be negative. (default: 1)
+// @return the value prior to the addition.
+// @function fetchAdd
+int AtomicUserdata::fetchAdd(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    Poco::Int64 delta = lua_isnoneornil(L, 2) ? 1 : checkInteger(L, 2);
+    pushInteger(L, aud->mAtomic->value().fetch_add(delta));
+    return 1;
+}
+
+/// Sets the value to desired only if it currently equals expected, as a single atomic step.
+// @int expected value the atomic must currently hold.
+// @int desired new value.
+// @return boolean indicating if the value was set.
+// @return the value held prior to the call.
+// @function compareExchange
+int AtomicUserdata::compareExchange(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    Poco::Int64 expected = checkInteger(L, 2);
+    Poco::Int64 desired = checkInteger(L, 3);
+
+    bool exchanged = aud->mAtomic->value().compare_exchange_strong(expected, desired);
+    lua_pushboolean(L, exchanged);
+    pushInteger(L, expected);
+    return 2;
+}
+
+/// Sets the value, as a single atomic step.
+// @int value new value.
+// @return the value held prior to the call.
+// @function exchange
+int AtomicUserdata::exchange(lua_State* L)
+{
+    AtomicUserdata* aud = checkPrivateUserdata<AtomicUserdata>(L, 1);
+    Poco::Int64 value = checkInteger(L, 2);
+    pushInteger(L, aud->mAtomic->value().exchange(value));
+    return 1;
+}
+
+} // LuaPoco
@@ -0,0 +1,65 @@
+#ifndef LUA_POCO_ATOMIC_H
+#define LUA_POCO_ATOMIC_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/SharedMemory.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+#include <atomic>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_atomic(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_ATOMIC_METATABLE_NAME;
+
+// 64 bit atomic integer, held either in the object itself or at an offset within a shared memory region.
+class AtomicInteger
+{
+public:
+    AtomicInteger(Poco::Int64 initial);
+    // the region is kept mapped for the lifetime of the object.
+    AtomicInteger(const Poco::SharedMemory& region, size_t offset);
+    ~AtomicInteger();
+
+    std::atomic<Poco::Int64>& value();
+
+private:
+    std::atomic<Poco::Int64> mLocal;
+    std::atomic<Poco::Int64>* mValue;
+    Poco::SharedMemory mRegion;
+};
+
+class AtomicUserdata : public Userdata
+{
+public:
+    AtomicUserdata(const Poco::SharedPtr<AtomicInteger>& atomic);
+    virtual ~AtomicUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerAtomic(lua_State* L);
+    // constructor function
+    static int Atomic(lua_State* L);
+
+    Poco::SharedPtr<AtomicInteger> mAtomic;
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+
+    // userdata methods
+    static int get(lua_State* L);
+    static int set(lua_State* L);
+    static int add(lua_State* L);
+    static int fetchAdd(lua_State* L);
+    static int compareExchange(lua_State* L);
+    static int exchange(lua_State* L);
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,223 @@
+/// Reusable barrier for phased parallel work.
+// A barrier is constructed for a number of parties, each of which calls wait() when it completes a phase.
+// wait() blocks until all parties have arrived, then releases them all at once, and the barrier is ready
+// for the next phase.
+//
+// Waiting parties are woken once per phase, by the last party to arrive.
+//
+// Note: barrier userdata are copyable/sharable between threads.
+// @module barrier
+
+#include "Barrier.h"
+#include <Poco/Exception.h>
+#include <Poco/ScopedLock.h>
+
+int luaopen_poco_barrier(lua_State* L)
+{
+    LuaPoco::BarrierUserdata::registerBarrier(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::BarrierUserdata::Barrier);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_BARRIER_METATABLE_NAME = "Poco.Barrier.metatable";
+
+Barrier::Barrier(int parties) :
+    mParties(parties),
+    mWaiting(0),
+    mGeneration(0)
+{
+}
+
+Barrier::~Barrier()
+{
+}
+
+bool Barrier::wait()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    Poco::UInt64 generation = mGeneration;
+
+    if (++mWaiting == mParties)
+    {
+        mWaiting = 0;
+        ++mGeneration;
+        mCondition.broadcast();
+        return true;
+    }
+
+    // guards against spurious wakeups, a waiter is only released by a change of generation.
+    while (generation == mGeneration) { mCondition.wait(mMutex); }
+    return false;
+}
+
+int Barrier::parties() const
+{
+    return mParties;
+}
+
+int Barrier::waiting()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    return mWaiting;
+}
+
+Poco::UInt64 Barrier::generation()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    return mGeneration;
+}
+
+BarrierUserdata::BarrierUserdata(int parties) :
+    mBarrier(new LuaPoco::Barrier(parties))
+{
+}
+
+// construct new Ud from existing SharedPtr (only useful for copyToState)
+BarrierUserdata::BarrierUserdata(const Poco::SharedPtr<LuaPoco::Barrier>& barrier) :
+    mBarrier(barrier)
+{
+}
+
+BarrierUserdata::~BarrierUserdata()
+{
+}
+
+bool BarrierUserdata::copyToState(lua_State *L)
+{
+    registerBarrier(L);
+    BarrierUserdata* bud = NULL;
+    void* p = lua_newuserdata(L, sizeof *bud);
+
+    try
+    {
+        bud = new(p) BarrierUserdata(mBarrier);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, bud, POCO_BARRIER_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool BarrierUserdata::registerBarrier(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "wait", wait },
+        { "parties", parties },
+        { "waiting", waiting },
+        { "generation", generation },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_BARRIER_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new barrier userdata.
+// @int parties number of parties which must call wait() to complete each phase.
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+int BarrierUserdata::Barrier(lua_State* L)
+{
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    lua_Integer parties = luaL_checkinteger(L, firstArg);
+    if (parties < 1 || parties > 0x7fffffff)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "parties must be between 1 and 2147483647.");
+        return 2;
+    }
+
+    BarrierUserdata* bud = NULL;
+    void* p = lua_newuserdata(L, sizeof *bud);
+
+    try
+    {
+        bud = new(p) BarrierUserdata(static_cast<int>(parties));
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    setupPocoUserdata(L, bud, POCO_BARRIER_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type barrier
+
+// metamethod infrastructure
+int BarrierUserdata::metamethod__tostring(lua_State* L)
+{
+    BarrierUserdata* bud = checkPrivateUserdata<BarrierUserdata>(L, 1);
+
+    lua_pushfstring(L, "Poco.Barrier (%p)", static_cast<void*>(bud));
+    return 1;
+}
+
+// userdata methods
+
+/// Waits for all parties to arrive at the barrier.
+// @return true for exactly one party of each phase, the last to arrive, false for the others.
+// @function wait
+int BarrierUserdata::wait(lua_State* L)
+{
+    BarrierUserdata* bud = checkPrivateUserdata<BarrierUserdata>(L, 1);
+    bool last = false;
+
+    try
+    {
+        last = bud->mBarrier->wait();
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    lua_pushboolean(L, last);
+    return 1;
+}
+
+/// Gets the number of parties required to complete a phase.
+// @return number of parties.
+// @function parties
+int BarrierUserdata::parties(lua_State* L)
+{
+    BarrierUserdata* bud = checkPrivateUserdata<BarrierUserdata>(L, 1);
+    lua_pushinteger(L, bud->mBarrier->parties());
+    return 1;
+}
+
+/// Gets the number of parties waiting in the current phase.
+// @return number of parties.
+// @function waiting
+int BarrierUserdata::waiting(lua_State* L)
+{
+    BarrierUserdata* bud = checkPrivateUserdata<BarrierUserdata>(L, 1);
+    lua_pushinteger(L, bud->mBarrier->waiting());
+    return 1;
+}
+
+/// Gets the number of phases completed.
+// @return number of phases.
+// @function generation
+int BarrierUserdata::generation(lua_State* L)
+{
+    BarrierUserdata* bud = checkPrivateUserdata<BarrierUserdata>(L, 1);
+    lua_pushinteger(L, static_cast<lua_Integer>(bud->mBarrier->generation()));
+    return 1;
+}
+
+} // LuaPoco
@@ -0,0 +1,71 @@
+#ifndef LUA_POCO_BARRIER_H
+#define LUA_POCO_BARRIER_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_barrier(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_BARRIER_METATABLE_NAME;
+
+// reusable barrier for a fixed number of parties.
+// each round is a generation, waiters sleep until the generation changes, and only the last party to
+// arrive wakes them, starting the next generation.
+class Barrier
+{
+public:
+    Barrier(int parties);
+    ~Barrier();
+
+    // returns true for the last party to arrive.
+    bool wait();
+    int parties() const;
+    int waiting();
+    Poco::UInt64 generation();
+
+private:
+    Poco::FastMutex mMutex;
+    Poco::Condition mCondition;
+    const int mParties;
+    int mWaiting;
+    Poco::UInt64 mGeneration;
+};
+
+class BarrierUserdata : public Userdata
+{
+public:
+    BarrierUserdata(int parties);
+    BarrierUserdata(const Poco::SharedPtr<Barrier>& barrier);
+    virtual ~BarrierUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerBarrier(lua_State* L);
+    // constructor function
+    static int Barrier(lua_State* L);
+
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+
+    // userdata methods
+    static int wait(lua_State* L);
+    static int parties(lua_State* L);
+    static int waiting(lua_State* L);
+    static int generation(lua_State* L);
+
+    Poco::SharedPtr<LuaPoco::Barrier> mBarrier;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,298 @@
+#include "BinaryCodec.h"
+#include "JSON.h"
+#include "Userdata.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+const size_t INITIAL_CAPACITY = 4096;
+// size of the chunks written to a sink, and read from a stream.
+const size_t CHUNK_CAPACITY = 64 * 1024;
+
+}
+
+BinaryOutput::BinaryOutput() :
+    mSink(NULL),
+    mData(NULL),
+    mSize(0),
+    mCapacity(0)
+{
+}
+
+BinaryOutput::BinaryOutput(std::ostream& sink) :
+    mSink(&sink),
+    mData(NULL),
+    mSize(0),
+    mCapacity(0)
+{
+}
+
+BinaryOutput::~BinaryOutput()
+{
+    std::free(mData);
+}
+
+void BinaryOutput::write(const char* s, size_t len)
+{
+    // long strings are written to the sink directly rather than through the buffer.
+    if (mSink && len >= CHUNK_CAPACITY)
+    {
+        flush();
+        mSink->write(s, static_cast<std::streamsize>(len));
+        if (mSink->fail()) { throw Poco::IOException("binary output write failed."); }
+        return;
+    }
+
+    reserve(len);
+    if (len > 0) { std::memcpy(mData + mSize, s, len); }
+    mSize += len;
+}
+
+void BinaryOutput::flush()
+{
+    if (!mSink || mSize == 0) { return; }
+
+    mSink->write(mData, static_cast<std::streamsize>(mSize));
+    if (mSink->fail()) { throw Poco::IOException("binary output write failed."); }
+
+    mSize = 0;
+}
+
+const char* BinaryOutput::data() const
+{
+    return mData;
+}
+
+size_t BinaryOutput::size() const
+{
+    return mSize;
+}
+
+void BinaryOutput::grow(size_t n)
+{
+    if (mSink)
+    {
+        flush();
+        if (mCapacity - mSize >= n) { return; }
+    }
+
+    size_t capacity = mCapacity ? mCapacity : (mSink ? CHUNK_CAPACITY : INITIAL_CAPACITY);
+    while (capacity - mSize < n)
+    {
+        if (capacity > static_cast<size_t>(-1) / 2) { throw Poco::OutOfMemoryException("binary output is too large."); }
+        capacity *= 2;
+    }
+
+    char* data = static_cast<char*>(std::realloc(mData, capacity));
+    if (!data) { throw Poco::OutOfMemoryException("unable to allocate binary output buffer."); }
+
+    mData = data;
+    mCapacity = capacity;
+}
+
+BinaryInput::BinaryInput(const char* data, size_t size) :
+    mStream(NULL),
+    mBegin(data),
+    mPos(data),
+    mEnd(data + size),
+    mDiscarded(0)
+{
+}
+
+BinaryInput::BinaryInput(std::istream& stream) :
+    mStream(&stream),
+    mBegin(NULL),
+    mPos(NULL),
+    mEnd(NULL),
+    mDiscarded(0)
+{
+}
+
+BinaryInput::~BinaryInput()
+{
+}
+
+const char* BinaryInput::read(size_t n)
+{
+    if (static_cast<size_t>(mEnd - mPos) < n && !fill(n)) { fail("unexpected end of input", offset()); }
+
+    const char* p = mPos;
+    mPos += n;
+    return p;
+}
+
+Poco::UInt8 BinaryInput::readByte()
+{
+    if (mPos == mEnd && !fill(1)) { fail("unexpected end of input", offset()); }
+    return static_cast<Poco::UInt8>(*mPos++);
+}
+
+Poco::UInt64 BinaryInput::readValue(size_t bytes)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(read(bytes));
+    Poco::UInt64 value = 0;
+    for (size_t i = 0; i < bytes; ++i) { value = (value << 8) | p[i]; }
+    return value;
+}
+
+size_t BinaryInput::buffered() const
+{
+    return static_cast<size_t>(mEnd - mPos);
+}
+
+bool BinaryInput::atEnd()
+{
+    return mPos == mEnd && !fill(1);
+}
+
+size_t BinaryInput::offset() const
+{
+    return mDiscarded + static_cast<size_t>(mPos - mBegin);
+}
+
+void BinaryInput::fail(const std::string& message, size_t offset) const
+{
+    throw Poco::DataFormatException(message + " at byte " + Poco::NumberFormatter::format(static_cast<Poco::UInt64>(offset)));
+}
+
+bool BinaryInput::fill(size_t n)
+{
+    if (!mStream) { return false; }
+
+    size_t unread = static_cast<size_t>(mEnd - mPos);
+    if (mBuffer.empty()) { mBuffer.resize(CHUNK_CAPACITY); }
+
+    char* buffer = &mBuffer[0];
+    if (unread > 0) { std::memmove(buffer, mPos, unread); }
+    mDiscarded += static_cast<size_t>(mPos - mBegin);
+
+    // the buffer only grows as data arrives, so a corrupt length can not allocate more than the input holds.
+    while (unread < n)
+    {
+        if (unread == mBuffer.size())
+        {
+            mBuffer.resize(mBuffer.size() * 2);
+            buffer = &mBuffer[0];
+        }
+
+        mStream->read(buffer + unread, static_cast<std::streamsize>(mBuffer.size() - unread));
+        size_t count = static_cast<size_t>(mStream->gcount());
+        if (count == 0 && mStream->bad()) { throw Poco::IOException("error reading the binary stream."); }
+        if (count == 0) { break; }
+        unread += count;
+    }
+
+    mBegin = buffer;
+    mPos = buffer;
+    mEnd = buffer + unread;
+
+    return unread >= n;
+}
+
+BinaryDecoder::BinaryDecoder(lua_State* L, BinaryReader& reader) :
+    mState(L),
+    mReader(reader)
+{
+}
+
+BinaryDecoder::~BinaryDecoder()
+{
+}
+
+void BinaryDecoder::decode()
+{
+    BinaryItem item;
+
+    for (;;)
+    {
+        size_t itemOffset = mReader.input().offset();
+        mReader.next(item);
+
+        bool keyExpected = !mFrames.empty() && mFrames.back().map && !mFrames.back().haveKey;
+
+        switch (item.type)
+        {
+        case BinaryItem::MAP:
+        case BinaryItem::ARRAY:
+        {
+            if (keyExpected) { mReader.input().fail("map keys must be strings, numbers or booleans", itemOffset); }
+            // room for the table and key of each level, and the value being set.
+            if (!lua_checkstack(mState, 4)) { mReader.input().fail("nesting is too deep", itemOffset); }
+
+            // each member or element takes at least one byte, which bounds the size of tables from corrupt input.
+            size_t size = item.count == BinaryItem::INDEFINITE ? 0 : item.count;
+            if (size > mReader.input().buffered()) { size = mReader.input().buffered(); }
+            if (size > 0x7fffffff) { size = 0x7fffffff; }
+
+            bool map = item.type == BinaryItem::MAP;
+            if (map) { lua_createtable(mState, 0, static_cast<int>(size)); }
+            else { lua_createtable(mState, static_cast<int>(size), 0); }
+
+            if (item.count != 0)
+            {
+                Frame frame = { map, lua_gettop(mState), item.count, 0, false };
+                mFrames.push_back(frame);
+                continue;
+            }
+            break;
+        }
+        case BinaryItem::BREAK:
+            if (mFrames.empty() || mFrames.back().remaining != BinaryItem::INDEFINITE || mFrames.back().haveKey)
+            {
+                mReader.input().fail("unexpected break", itemOffset);
+            }
+            // the table is left on the top of the stack as a complete value.
+            mFrames.pop_back();
+            break;
+        case BinaryItem::STRING:
+            lua_pushlstring(mState, item.string, item.count);
+            break;
+        case BinaryItem::INTEGER:
+            pushInteger(mState, item.integer);
+            break;
+        case BinaryItem::NUMBER:
+            if (keyExpected && item.number != item.number) { mReader.input().fail("map keys can not be nan", itemOffset); }
+            lua_pushnumber(mState, static_cast<lua_Number>(item.number));
+            break;
+        case BinaryItem::BOOLEAN:
+            lua_pushboolean(mState, static_cast<int>(item.boolean));
+            break;
+        case BinaryItem::NUL:
+            // use sentinel value jsonNull
+            lua_pushlightuserdata(mState, static_cast<void*>(jsonNull));
+            break;
+        }
+
+        // sets the complete value on the top of the stack in its table, along with each table it completes.
+        for (;;)
+        {
+            if (mFrames.empty()) { return; }
+
+            Frame& frame = mFrames.back();
+            if (frame.map)
+            {
+                if (!frame.haveKey)
+                {
+                    frame.haveKey = true;
+                    break;
+                }
+                lua_rawset(mState, frame.table);
+                frame.haveKey = false;
+            }
+            else { lua_rawseti(mState, frame.table, static_cast<int>(++frame.count)); }
+
+            if (frame.remaining == BinaryItem::INDEFINITE || --frame.remaining > 0) { break; }
+            mFrames.pop_back();
+        }
+    }
+}
+
+} // LuaPoco
@@ -0,0 +1,326 @@
+#ifndef LUA_POCO_BINARY_CODEC_H
+#define LUA_POCO_BINARY_CODEC_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include "OStream.h"
+#include "TableEncoder.h"
+#include "JsonDecoder.h"
+#include <Poco/Exception.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// output of the binary encoders, a growable byte buffer, or a fixed size buffer written to a stream.
+class BinaryOutput
+{
+public:
+    BinaryOutput();
+    // writes the output to sink in chunks, whenever the buffer is full and on flush().
+    BinaryOutput(std::ostream& sink);
+    ~BinaryOutput();
+
+    void put(Poco::UInt8 b)
+    {
+        reserve(1);
+        mData[mSize++] = static_cast<char>(b);
+    }
+
+    // writes a type byte followed by a big endian value of 1, 2, 4 or 8 bytes.
+    void put(Poco::UInt8 b, Poco::UInt64 value, size_t bytes)
+    {
+        reserve(bytes + 1);
+        mData[mSize++] = static_cast<char>(b);
+        for (size_t i = bytes; i-- > 0;) { mData[mSize++] = static_cast<char>(value >> (i * 8)); }
+    }
+
+    void write(const char* s, size_t len);
+
+    // writes the buffered output to the sink, throws if the write fails.
+    void flush();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    BinaryOutput(const BinaryOutput&);
+    BinaryOutput& operator=(const BinaryOutput&);
+
+    void reserve(size_t n)
+    {
+        if (mCapacity - mSize < n) { grow(n); }
+    }
+
+    void grow(size_t n);
+
+    std::ostream* mSink;
+    char* mData;
+    size_t mSize;
+    size_t mCapacity;
+};
+
+// input of the binary decoders, either memory read in place or a stream read in chunks.
+class BinaryInput
+{
+public:
+    BinaryInput(const char* data, size_t size);
+    BinaryInput(std::istream& stream);
+    ~BinaryInput();
+
+    // returns the next n bytes, which remain valid until the next read, throws if the input ends first.
+    const char* read(size_t n);
+    Poco::UInt8 readByte();
+    // reads a big endian value of 1, 2, 4 or 8 bytes.
+    Poco::UInt64 readValue(size_t bytes);
+    // bytes which can be read without reading from the stream.
+    size_t buffered() const;
+    // true when the input has no bytes left.
+    bool atEnd();
+    // offset of the next byte in the input.
+    size_t offset() const;
+    // throws a Poco::DataFormatException for the input at offset.
+    void fail(const std::string& message, size_t offset) const;
+
+private:
+    BinaryInput(const BinaryInput&);
+    BinaryInput& operator=(const BinaryInput&);
+
+    // reads from the stream until n bytes are buffered, returns false if the stream ends first.
+    bool fill(size_t n);
+
+    std::istream* mStream;
+    const char* mBegin;
+    const char* mPos;
+    const char* mEnd;
+    std::vector<char> mBuffer;
+    // bytes of the stream discarded from the buffer.
+    size_t mDiscarded;
+};
+
+// a data item read by a BinaryReader.
+struct BinaryItem
+{
+    enum Type
+    {
+        MAP,
+        ARRAY,
+        STRING,
+        INTEGER,
+        NUMBER,
+        BOOLEAN,
+        NUL,
+        // ends a map or array of INDEFINITE size.
+        BREAK
+    };
+
+    static const size_t INDEFINITE = static_cast<size_t>(-1);
+
+    Type type;
+    // number of map members or array elements, or the length of a string.
+    size_t count;
+    const char* string;
+    Poco::Int64 integer;
+    double number;
+    bool boolean;
+};
+
+// reads the data items of a binary format from an input.
+class BinaryReader
+{
+public:
+    BinaryReader(BinaryInput& input) : mInput(input) {}
+    virtual ~BinaryReader() {}
+
+    // reads the next item, throws for invalid data or if the input ends.
+    virtual void next(BinaryItem& item) = 0;
+
+    BinaryInput& input()
+    {
+        return mInput;
+    }
+
+protected:
+    BinaryInput& mInput;
+};
+
+// builds Lua values from the items of a BinaryReader.
+// tables are created with the size given by the item, and nested values are decoded without recursion.
+// map keys may be strings, numbers or booleans, and nil is decoded as the json null sentinel.
+class BinaryDecoder
+{
+public:
+    BinaryDecoder(lua_State* L, BinaryReader& reader);
+    ~BinaryDecoder();
+
+    // reads one complete value onto the top of the stack.
+    void decode();
+
+private:
+    BinaryDecoder(const BinaryDecoder&);
+    BinaryDecoder& operator=(const BinaryDecoder&);
+
+    struct Frame
+    {
+        bool map;
+        // stack index of the table.
+        int table;
+        // members or elements left, or INDEFINITE.
+        size_t remaining;
+        // elements set in the array so far.
+        size_t count;
+        // the key of the next member is on the top of the stack.
+        bool haveKey;
+    };
+
+    lua_State* mState;
+    BinaryReader& mReader;
+    std::vector<Frame> mFrames;
+};
+
+// the TableEncoderTraits shared by the binary writers, to which each format adds its name().
+// objects and arrays are counted, as the formats write their size ahead of their members and elements,
+// and number and boolean keys are written as numbers and booleans.
+template <class Writer>
+struct BinaryEncoderTraits
+{
+    static const bool COUNTED = true;
+
+    static void fail(const std::string& message)
+    {
+        throw Poco::DataFormatException(message);
+    }
+
+    static void startObject(Writer& w, size_t count)
+    {
+        w.startObject(count);
+    }
+
+    static void startArray(Writer& w, size_t count)
+    {
+        w.startArray(count);
+    }
+
+    static void number(Writer& w, lua_State* L, int index)
+    {
+    #if LUA_VERSION_NUM > 502
+        if (lua_isinteger(L, index))
+        {
+            w.value(static_cast<Poco::Int64>(lua_tointeger(L, index)));
+            return;
+        }
+        w.value(static_cast<double>(lua_tonumber(L, index)));
+    #else
+        // numbers with an integral value are written as integers, as Lua has no integer type to tell them apart.
+        double n = static_cast<double>(lua_tonumber(L, index));
+        if (n >= -9223372036854775808.0 && n < 9223372036854775808.0 && n == static_cast<double>(static_cast<Poco::Int64>(n)))
+        {
+            w.value(static_cast<Poco::Int64>(n));
+        }
+        else { w.value(n); }
+    #endif
+    }
+
+    static void numberKey(Writer& w, lua_State* L, int index)
+    {
+        number(w, L, index);
+    }
+
+    static void otherKey(Writer& w, lua_State* L, int index)
+    {
+        if (lua_type(L, index) != LUA_TBOOLEAN) { fail("encountered key value that is not a string, number or boolean."); }
+        w.value(lua_toboolean(L, index) != 0);
+    }
+};
+
+// the encode, encodeTo and decode functions of a binary format module, given the writer and reader of the format.
+
+template <class Writer>
+int encodeBinary(lua_State* L)
+{
+    int rv = 0;
+
+    luaL_checkany(L, 1);
+    // TableEncoder expects the value it is encoding at the top of the stack.
+    lua_settop(L, 1);
+
+    try
+    {
+        Writer writer;
+        TableEncoder<Writer> te(L, writer);
+        te.encode();
+        rv = 1;
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+
+    return rv;
+}
+
+template <class Writer>
+int encodeBinaryTo(lua_State* L)
+{
+    int rv = 0;
+
+    OStream* os = checkPrivateUserdata<OStream>(L, 1);
+    luaL_checkany(L, 2);
+    lua_settop(L, 2);
+
+    try
+    {
+        Writer writer(os->ostream());
+        TableEncoder<Writer> te(L, writer);
+        te.encodeToSink();
+
+        lua_pushboolean(L, 1);
+        rv = 1;
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+
+    return rv;
+}
+
+template <class Reader>
+int decodeBinary(lua_State* L)
+{
+    int rv = 0;
+    DecodeInput source;
+
+    if (!getDecodeInput(L, 1, source, false))
+    {
+        return luaL_argerror(L, 1, "expected string, istream, buffer or sharedmemory");
+    }
+
+    try
+    {
+        Poco::SharedPtr<BinaryInput> input(source.stream ? new BinaryInput(*source.stream) : new BinaryInput(source.data, source.size));
+        Reader reader(*input);
+        BinaryDecoder decoder(L, reader);
+        decoder.decode();
+
+        // a buffer or sharedmemory may hold anything after the value, a string or stream only the value.
+        if (!source.region && !input->atEnd()) { input->fail("unexpected data after the value", input->offset()); }
+
+        rv = 1;
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+
+    return rv;
+}
+
+} // LuaPoco
+
+#endif
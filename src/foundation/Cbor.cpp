@@ -0,0 +1,373 @@
+/// CBOR encoding and decoding
+// Encoding Lua values to CBOR (RFC 8949) strings, and decoding CBOR to Lua values.
+//
+// Tables are encoded as by json.encode: tables with a value at [1] are arrays, and other tables are maps.
+// Unlike JSON, integers and floats are kept distinct, and maps may have number and boolean keys. Strings are
+// encoded as text strings, and both text and byte strings are decoded as strings. The json null, emptyArray and
+// emptyObject sentinels encode null, empty arrays and empty maps, and null and undefined are decoded as the null
+// sentinel. Floats are written as 32 bit floats when that holds the value exactly.
+// @module cbor
+
+#include "Cbor.h"
+#include "JSON.h"
+#include <Poco/Exception.h>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+int luaopen_poco_cbor(lua_State* L)
+{
+    struct LuaPoco::CFunctions methods[] =
+    {
+        { "encode", LuaPoco::Cbor::encode },
+        { "encodeTo", LuaPoco::Cbor::encodeTo },
+        { "decode", LuaPoco::Cbor::decode },
+        { "null", LuaPoco::JSON::getNull },
+        { "emptyObject", LuaPoco::JSON::getEmptyObject },
+        { "emptyArray", LuaPoco::JSON::getEmptyArray },
+        { NULL, NULL}
+    };
+
+    lua_createtable(L, 0, 6);
+    setCFunctions(L, methods);
+
+    return 1;
+}
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+enum
+{
+    MAJOR_UNSIGNED = 0,
+    MAJOR_NEGATIVE = 1,
+    MAJOR_BYTES = 2,
+    MAJOR_TEXT = 3,
+    MAJOR_ARRAY = 4,
+    MAJOR_MAP = 5,
+    MAJOR_TAG = 6,
+    MAJOR_SIMPLE = 7
+};
+
+// additional information of an item whose length is indefinite, and of the break ending it.
+const Poco::UInt8 INFO_INDEFINITE = 31;
+
+double halfToDouble(Poco::UInt16 half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value = 0;
+
+    if (exponent == 0) { value = std::ldexp(static_cast<double>(mantissa), -24); }
+    else if (exponent != 31) { value = std::ldexp(static_cast<double>(mantissa + 1024), exponent - 25); }
+    else if (mantissa == 0) { value = std::numeric_limits<double>::infinity(); }
+    else { value = std::numeric_limits<double>::quiet_NaN(); }
+
+    return half & 0x8000 ? -value : value;
+}
+
+}
+
+template <>
+struct TableEncoderTraits<CborWriter> : public BinaryEncoderTraits<CborWriter>
+{
+    static const char* name()
+    {
+        return "cbor";
+    }
+};
+
+CborWriter::CborWriter()
+{
+}
+
+CborWriter::CborWriter(std::ostream& sink) :
+    mOutput(sink)
+{
+}
+
+CborWriter::~CborWriter()
+{
+}
+
+void CborWriter::startObject(size_t count)
+{
+    head(MAJOR_MAP, count);
+}
+
+void CborWriter::startArray(size_t count)
+{
+    head(MAJOR_ARRAY, count);
+}
+
+void CborWriter::key(const char* k, size_t len)
+{
+    value(k, len);
+}
+
+void CborWriter::null()
+{
+    mOutput.put(0xf6);
+}
+
+void CborWriter::value(bool b)
+{
+    mOutput.put(b ? 0xf5 : 0xf4);
+}
+
+void CborWriter::value(Poco::Int64 i)
+{
+    // negative integers n are written as -1 - n, the bitwise complement of n.
+    if (i >= 0) { head(MAJOR_UNSIGNED, static_cast<Poco::UInt64>(i)); }
+    else { head(MAJOR_NEGATIVE, ~static_cast<Poco::UInt64>(i)); }
+}
+
+void CborWriter::value(double d)
+{
+    if (d >= -FLT_MAX && d <= FLT_MAX && static_cast<double>(static_cast<float>(d)) == d)
+    {
+        float f = static_cast<float>(d);
+        Poco::UInt32 bits = 0;
+        std::memcpy(&bits, &f, sizeof f);
+        mOutput.put(0xfa, bits, 4);
+    }
+    else
+    {
+        Poco::UInt64 bits = 0;
+        std::memcpy(&bits, &d, sizeof d);
+        mOutput.put(0xfb, bits, 8);
+    }
+}
+
+void CborWriter::value(const char* s, size_t len)
+{
+    head(MAJOR_TEXT, len);
+    mOutput.write(s, len);
+}
+
+void CborWriter::flush()
+{
+    mOutput.flush();
+}
+
+const char* CborWriter::data() const
+{
+    return mOutput.data();
+}
+
+size_t CborWriter::size() const
+{
+    return mOutput.size();
+}
+
+void CborWriter::head(Poco::UInt8 major, Poco::UInt64 argument)
+{
+    Poco::UInt8 type = static_cast<Poco::UInt8>(major << 5);
+
+    if (argument < 24) { mOutput.put(static_cast<Poco::UInt8>(type | argument)); }
+    else if (argument <= 0xff) { mOutput.put(type | 24, argument, 1); }
+    else if (argument <= 0xffff) { mOutput.put(type | 25, argument, 2); }
+    else if (argument <= 0xffffffffULL) { mOutput.put(type | 26, argument, 4); }
+    else { mOutput.put(type | 27, argument, 8); }
+}
+
+CborReader::CborReader(BinaryInput& input) :
+    BinaryReader(input)
+{
+}
+
+CborReader::~CborReader()
+{
+}
+
+void CborReader::next(BinaryItem& item)
+{
+    for (;;)
+    {
+        size_t start = mInput.offset();
+        Poco::UInt8 b = mInput.readByte();
+        Poco::UInt8 major = b >> 5;
+        Poco::UInt8 info = b & 0x1f;
+
+        if (major == MAJOR_SIMPLE)
+        {
+            switch (info)
+            {
+            case 20:
+            case 21:
+                item.type = BinaryItem::BOOLEAN;
+                item.boolean = info == 21;
+                break;
+            case 22:
+            case 23:
+                item.type = BinaryItem::NUL;
+                break;
+            case 25:
+                item.type = BinaryItem::NUMBER;
+                item.number = halfToDouble(static_cast<Poco::UInt16>(mInput.readValue(2)));
+                break;
+            case 26:
+            {
+                Poco::UInt32 bits = static_cast<Poco::UInt32>(mInput.readValue(4));
+                float f = 0;
+                std::memcpy(&f, &bits, sizeof f);
+                item.type = BinaryItem::NUMBER;
+                item.number = f;
+                break;
+            }
+            case 27:
+            {
+                Poco::UInt64 bits = mInput.readValue(8);
+                item.type = BinaryItem::NUMBER;
+                std::memcpy(&item.number, &bits, sizeof item.number);
+                break;
+            }
+            case INFO_INDEFINITE:
+                item.type = BinaryItem::BREAK;
+                break;
+            default:
+                mInput.fail("unsupported cbor simple value", start);
+                break;
+            }
+            return;
+        }
+
+        if (info == INFO_INDEFINITE)
+        {
+            if (major == MAJOR_BYTES || major == MAJOR_TEXT) { readChunks(item, major); }
+            else if (major == MAJOR_ARRAY || major == MAJOR_MAP)
+            {
+                item.type = major == MAJOR_MAP ? BinaryItem::MAP : BinaryItem::ARRAY;
+                item.count = BinaryItem::INDEFINITE;
+            }
+            else { mInput.fail("invalid cbor indefinite length", start); }
+            return;
+        }
+
+        Poco::UInt64 argument = readArgument(info, start);
+
+        switch (major)
+        {
+        case MAJOR_UNSIGNED:
+            // integers beyond the range of Int64 are read as floats.
+            if (argument > 0x7fffffffffffffffULL)
+            {
+                item.type = BinaryItem::NUMBER;
+                item.number = static_cast<double>(argument);
+            }
+            else
+            {
+                item.type = BinaryItem::INTEGER;
+                item.integer = static_cast<Poco::Int64>(argument);
+            }
+            return;
+        case MAJOR_NEGATIVE:
+            if (argument > 0x7fffffffffffffffULL)
+            {
+                item.type = BinaryItem::NUMBER;
+                item.number = -1.0 - static_cast<double>(argument);
+            }
+            else
+            {
+                item.type = BinaryItem::INTEGER;
+                item.integer = -1 - static_cast<Poco::Int64>(argument);
+            }
+            return;
+        case MAJOR_BYTES:
+        case MAJOR_TEXT:
+            if (argument >= BinaryItem::INDEFINITE) { mInput.fail("cbor string is too long", start); }
+            item.type = BinaryItem::STRING;
+            item.count = static_cast<size_t>(argument);
+            item.string = mInput.read(item.count);
+            return;
+        case MAJOR_ARRAY:
+        case MAJOR_MAP:
+            if (argument >= BinaryItem::INDEFINITE) { mInput.fail("cbor array or map is too long", start); }
+            item.type = major == MAJOR_MAP ? BinaryItem::MAP : BinaryItem::ARRAY;
+            item.count = static_cast<size_t>(argument);
+            return;
+        default:
+            // the tagged item follows the tag.
+            break;
+        }
+    }
+}
+
+Poco::UInt64 CborReader::readArgument(Poco::UInt8 info, size_t start)
+{
+    if (info < 24) { return info; }
+    if (info > 27) { mInput.fail("invalid cbor additional information", start); }
+
+    // 24 to 27 are followed by a 1, 2, 4 or 8 byte argument.
+    return mInput.readValue(static_cast<size_t>(1) << (info - 24));
+}
+
+void CborReader::readChunks(BinaryItem& item, Poco::UInt8 major)
+{
+    mScratch.clear();
+
+    for (;;)
+    {
+        size_t start = mInput.offset();
+        Poco::UInt8 b = mInput.readByte();
+        if (b == 0xff) { break; }
+
+        // each chunk is a definite length string of the same major type.
+        if ((b >> 5) != major || (b & 0x1f) == INFO_INDEFINITE) { mInput.fail("invalid cbor string chunk", start); }
+
+        Poco::UInt64 len = readArgument(b & 0x1f, start);
+        if (len >= BinaryItem::INDEFINITE) { mInput.fail("cbor string is too long", start); }
+        mScratch.append(mInput.read(static_cast<size_t>(len)), static_cast<size_t>(len));
+    }
+
+    item.type = BinaryItem::STRING;
+    item.count = mScratch.size();
+    item.string = mScratch.data();
+}
+
+/// encodes a value as a CBOR string.
+// @param value table, string, number, boolean, or json sentinel value to encode.
+// @return value as string or nil. (error)
+// @return error message.
+// @function encode
+int Cbor::encode(lua_State* L)
+{
+    return encodeBinary<CborWriter>(L);
+}
+
+/// encodes a value as CBOR, written to an ostream.
+// The output is written in chunks as it is encoded, such that memory use does not grow with the size of the
+// value. On error, the part of the value encoded before the error may have been written.
+// @param ostream ostream userdata, such as a fileostream, pipeostream, teeostream or deflatingostream.
+// @param value table, string, number, boolean, or json sentinel value to encode.
+// @return true or nil. (error)
+// @return error message.
+// @function encodeTo
+// @see ostream
+int Cbor::encodeTo(lua_State* L)
+{
+    return encodeBinaryTo<CborWriter>(L);
+}
+
+/// decodes a CBOR value.
+// The value can be read from a string, from an istream, or from the memory of a buffer or sharedmemory.
+// A string or istream must hold nothing but the value, while anything following the value in the memory of a
+// buffer or sharedmemory is ignored. An istream is read in chunks as the value is decoded.
+// Errors include the byte offset in the input at which the value is invalid.
+// @param input string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return value or nil. (error)
+// @return error message.
+// @function decode
+// @see istream
+// @see buffer
+// @see sharedmemory
+int Cbor::decode(lua_State* L)
+{
+    return decodeBinary<CborReader>(L);
+}
+
+} // LuaPoco
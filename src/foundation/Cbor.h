@@ -0,0 +1,81 @@
+#ifndef LUA_POCO_CBOR_H
+#define LUA_POCO_CBOR_H
+
+#include "LuaPoco.h"
+#include "BinaryCodec.h"
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_cbor(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+// writes CBOR (RFC 8949), using the smallest encoding of each value, with strings written as text strings.
+class CborWriter
+{
+public:
+    CborWriter();
+    // writes the output to sink in chunks, whenever the buffer is full and on flush().
+    CborWriter(std::ostream& sink);
+    ~CborWriter();
+
+    void startObject(size_t count);
+    void endObject() {}
+    void startArray(size_t count);
+    void endArray() {}
+    void key(const char* k, size_t len);
+    void null();
+    void value(bool b);
+    void value(Poco::Int64 i);
+    // written as a 32 bit float when it holds the value exactly.
+    void value(double d);
+    void value(const char* s, size_t len);
+
+    // writes the buffered output to the sink, throws if the write fails.
+    void flush();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    CborWriter(const CborWriter&);
+    CborWriter& operator=(const CborWriter&);
+
+    // writes the initial byte of an item of major type, followed by its argument.
+    void head(Poco::UInt8 major, Poco::UInt64 argument);
+
+    BinaryOutput mOutput;
+};
+
+// reads CBOR data items. byte and text strings are read as strings, including those of indefinite length,
+// tags are skipped, reading the tagged item as is, and undefined is read as null.
+class CborReader : public BinaryReader
+{
+public:
+    CborReader(BinaryInput& input);
+    virtual ~CborReader();
+
+    virtual void next(BinaryItem& item);
+
+private:
+    // reads the argument following the initial byte of an item, whose first byte is at start.
+    Poco::UInt64 readArgument(Poco::UInt8 info, size_t start);
+    // reads the chunks of an indefinite length string into mScratch.
+    void readChunks(BinaryItem& item, Poco::UInt8 major);
+
+    std::string mScratch;
+};
+
+namespace Cbor
+{
+
+int encode(lua_State* L);
+int encodeTo(lua_State* L);
+int decode(lua_State* L);
+
+}
+} // LuaPoco
+
+#endif
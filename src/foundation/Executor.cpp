@@ -0,0 +1,719 @@
+/// Lightweight executor for running functions on a threadpool.
+// Functions are submitted with their parameters and run in a private Lua state on a worker thread,
+// in the same manner as the thread module. Unlike taskmanager, no notifications are posted as jobs start
+// and finish, which makes the executor suited to large numbers of small fire and forget jobs.
+//
+// Jobs submitted with a callback have their results returned to the executor's owner. Completed jobs are
+// collected in batches by poll(), which calls each callback with a boolean indicating success, followed by
+// the job's return values, or an error message.
+//
+// Each worker thread keeps a single Lua state for all of the jobs it runs back to back, which avoids
+// creating a new state per job. Jobs must not rely on globals left behind by earlier jobs, and
+// reuseStates can be disabled to give every job a fresh state.
+//
+// Note: executor userdata are not copyable/sharable between threads, as callbacks run in the owner's state.
+// @module executor
+
+/// ExecutorSettings table is optionally supplied to the executor constructor to provide
+// non-default settings.
+// @table ExecutorSettings
+// @field minThreads Minimum number of threads in the thread pool to keep warm, waiting for jobs.
+// @field maxThreads Maximum number of threads made available to run jobs on.
+// @field idleTime Time permitted in seconds for a threads above the minimum to be idle without jobs running before it is shut down.
+// @field stackSize The stack size for the native OS thread.
+// @field reuseStates boolean, when true workers run consecutive jobs in the same Lua state, default is true.
+// @field linger Time in milliseconds a worker waits for another job before giving up its thread and Lua state, default is 50.
+// @field cpuSet cpu index or array of cpu indices the worker threads are restricted to, default is unrestricted.
+// @field numaNode NUMA node whose CPUs are used as the cpuSet when cpuSet is not supplied, see thread.numaNodeCpus().
+// @field pinWorkers boolean, when true each worker thread is pinned to a single CPU of the cpuSet in turn, default is false.
+
+#include "Executor.h"
+#include "StateTransfer.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Clock.h>
+#include <Poco/Exception.h>
+#include <Poco/NumberFormatter.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/Thread.h>
+
+int luaopen_poco_executor(lua_State* L)
+{
+    LuaPoco::ExecutorUserdata::registerExecutor(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::ExecutorUserdata::Executor);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_EXECUTOR_METATABLE_NAME = "Poco.Executor.metatable";
+// attempts made to start a runner while exited runners are still returning their threads to the pool.
+const int RUNNER_START_ATTEMPTS = 100;
+
+ExecutorSettings::ExecutorSettings() :
+    minThreads(1),
+    maxThreads(16),
+    idleTime(60),
+    stackSize(0),
+    reuseStates(true),
+    linger(50),
+    pinWorkers(false)
+{
+}
+
+ExecutorJob::ExecutorJob(Poco::UInt64 id, bool callback) :
+    mState(luaL_newstate()),
+    mId(id),
+    mCallback(callback),
+    mOk(true)
+{
+    if (!mState) { throw Poco::OutOfMemoryException("unable to create a Lua state."); }
+    setupPrivateUserdata(mState);
+}
+
+ExecutorJob::~ExecutorJob()
+{
+    lua_close(mState);
+}
+
+Executor::Executor(const ExecutorSettings& settings) :
+    mPending(0),
+    mFailures(0),
+    mRunners(0),
+    mLingering(0),
+    mMaxRunners(settings.maxThreads),
+    mStopping(false),
+    mReuseStates(settings.reuseStates),
+    mLinger(settings.linger),
+    mCpuSet(settings.cpuSet),
+    mPinWorkers(settings.pinWorkers),
+    mThreadPool(settings.minThreads, settings.maxThreads, settings.idleTime, settings.stackSize)
+{
+}
+
+Executor::~Executor()
+{
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+        mStopping = true;
+        mJobReady.broadcast();
+    }
+
+    // queued jobs are still run, only lingering runners are released early.
+    mThreadPool.joinAll();
+
+    for (size_t i = 0; i < mCompleted.size(); ++i) { delete mCompleted[i]; }
+    for (size_t i = 0; i < mQueue.size(); ++i) { delete mQueue[i]; }
+}
+
+void Executor::submit(ExecutorJob* job)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    mQueue.push_back(job);
+    ++mPending;
+
+    // each lingering runner takes one queued job when it wakes.
+    if (mLingering >= static_cast<int>(mQueue.size()))
+    {
+        mJobReady.signal();
+        return;
+    }
+
+    if (mRunners >= mMaxRunners) { return; }
+
+    ++mRunners;
+    for (int attempt = 1; ; ++attempt)
+    {
+        try
+        {
+            mThreadPool.start(*this);
+            return;
+        }
+        catch (const Poco::NoThreadAvailableException&)
+        {
+            // a runner which just exited may not have returned its thread to the pool yet.
+            if (attempt < RUNNER_START_ATTEMPTS) { Poco::Thread::yield(); continue; }
+            --mRunners;
+            // other runners drain the queue, only fail when no runner is left to run the job.
+            if (mRunners > 0) { return; }
+        }
+        catch (...)
+        {
+            --mRunners;
+            if (mRunners > 0) { return; }
+        }
+
+        mQueue.pop_back();
+        --mPending;
+        delete job;
+        throw Poco::NoThreadAvailableException("unable to start a worker thread.");
+    }
+}
+
+void Executor::takeCompleted(std::vector<ExecutorJob*>& jobs, long ms)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    if (mCompleted.empty() && ms > 0) { mJobDone.tryWait(mMutex, ms); }
+    jobs.swap(mCompleted);
+}
+
+bool Executor::join(long ms)
+{
+    Poco::Clock start;
+    Poco::Clock::ClockDiff timeout = static_cast<Poco::Clock::ClockDiff>(ms) * 1000;
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+
+    while (mPending > 0)
+    {
+        if (ms < 0)
+        {
+            mJobDone.wait(mMutex);
+            continue;
+        }
+
+        // the remaining time is recomputed, as each finished job wakes the waiters.
+        Poco::Clock::ClockDiff remaining = timeout - start.elapsed();
+        if (remaining <= 0) { return false; }
+
+        long remainingMs = static_cast<long>((remaining + 999) / 1000);
+        mJobDone.tryWait(mMutex, remainingMs);
+    }
+
+    return true;
+}
+
+Poco::UInt64 Executor::pending()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    return mPending;
+}
+
+Poco::UInt64 Executor::failures(std::string& lastError)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    lastError = mLastError;
+    return mFailures;
+}
+
+void Executor::run()
+{
+    placeWorker();
+    lua_State* worker = NULL;
+
+    mMutex.lock();
+    for (;;)
+    {
+        if (mQueue.empty() && !mStopping && mLinger > 0)
+        {
+            ++mLingering;
+            try
+            {
+                mJobReady.tryWait(mMutex, mLinger);
+            }
+            catch (...)
+            {
+            }
+            --mLingering;
+        }
+
+        if (mQueue.empty())
+        {
+            if (!worker) { break; }
+
+            // the state is closed without the lock held, after which the queue is checked again.
+            mMutex.unlock();
+            lua_close(worker);
+            worker = NULL;
+            mMutex.lock();
+            if (mQueue.empty()) { break; }
+        }
+
+        ExecutorJob* job = mQueue.front();
+        mQueue.pop_front();
+        mMutex.unlock();
+
+        runJob(worker, job);
+        bool failed = !job->mOk;
+        std::string error;
+        if (!job->mCallback)
+        {
+            error.swap(job->mError);
+            delete job;
+            job = NULL;
+        }
+
+        mMutex.lock();
+        if (job) { mCompleted.push_back(job); }
+        else if (failed)
+        {
+            ++mFailures;
+            mLastError.swap(error);
+        }
+        --mPending;
+        mJobDone.broadcast();
+    }
+
+    --mRunners;
+    mMutex.unlock();
+}
+
+void Executor::placeWorker()
+{
+    if (mCpuSet.empty()) { return; }
+
+    if (mPinWorkers)
+    {
+        int worker = mNextWorkerCpu++;
+        CpuSet cpu(1, mCpuSet[static_cast<size_t>(worker) % mCpuSet.size()]);
+        setCurrentThreadAffinity(cpu);
+    }
+    else { setCurrentThreadAffinity(mCpuSet); }
+}
+
+// moves the function and parameters from the job to the worker state and runs it,
+// leaving the results or error in the job.
+void Executor::runJob(lua_State*& worker, ExecutorJob* job)
+{
+    if (!worker)
+    {
+        worker = luaL_newstate();
+        if (!worker)
+        {
+            job->mOk = false;
+            job->mError = "unable to create a Lua state.";
+            return;
+        }
+        luaL_openlibs(worker);
+        setupPrivateUserdata(worker);
+    }
+
+    int count = lua_gettop(job->mState);
+    lua_checkstack(worker, count);
+
+    for (int i = 1; i <= count; ++i)
+    {
+        lua_pushvalue(job->mState, i);
+        transferValue(worker, job->mState);
+        lua_pop(job->mState, 1);
+    }
+    lua_settop(job->mState, 0);
+
+    int result = lua_pcall(worker, count - 1, job->mCallback ? LUA_MULTRET : 0, 0);
+    if (result != 0)
+    {
+        const char* msg = lua_tostring(worker, -1);
+        job->mOk = false;
+        job->mError = msg ? msg : "error object is not a string.";
+    }
+    else if (job->mCallback)
+    {
+        int results = lua_gettop(worker);
+        lua_checkstack(job->mState, results);
+
+        for (int i = 1; i <= results; ++i)
+        {
+            lua_pushvalue(worker, i);
+            bool transferred = transferValue(job->mState, worker);
+            lua_pop(worker, 1);
+
+            if (!transferred)
+            {
+                lua_settop(job->mState, 0);
+                job->mOk = false;
+                job->mError = "non-copyable return value ";
+                job->mError.append(Poco::NumberFormatter::format(i));
+                break;
+            }
+        }
+    }
+
+    lua_settop(worker, 0);
+    if (!mReuseStates)
+    {
+        lua_close(worker);
+        worker = NULL;
+    }
+}
+
+ExecutorUserdata::ExecutorUserdata(const ExecutorSettings& settings) :
+    mExecutor(settings),
+    mCallbacksRef(LUA_NOREF),
+    mNextId(1)
+{
+}
+
+ExecutorUserdata::~ExecutorUserdata()
+{
+}
+
+// register metatable for this class
+bool ExecutorUserdata::registerExecutor(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "submit", submit },
+        { "submitWithCallback", submitWithCallback },
+        { "poll", poll },
+        { "join", join },
+        { "pending", pending },
+        { "failures", failures },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_EXECUTOR_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new executor userdata.
+// @param[opt] ExecutorSettings table
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+// @see ExecutorSettings
+int ExecutorUserdata::Executor(lua_State* L)
+{
+    ExecutorSettings settings;
+
+    int firstArg = constructorFirstArg(L, Executor);
+    int top = lua_gettop(L);
+
+    if (top >= firstArg)
+    {
+        luaL_checktype(L, firstArg, LUA_TTABLE);
+
+        lua_getfield(L, firstArg, "minThreads");
+        if (!lua_isnil(L, -1)) { settings.minThreads = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "maxThreads");
+        if (!lua_isnil(L, -1)) { settings.maxThreads = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "idleTime");
+        if (!lua_isnil(L, -1)) { settings.idleTime = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "stackSize");
+        if (!lua_isnil(L, -1)) { settings.stackSize = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "reuseStates");
+        if (!lua_isnil(L, -1)) { settings.reuseStates = lua_toboolean(L, -1) != 0; }
+        lua_getfield(L, firstArg, "linger");
+        if (!lua_isnil(L, -1)) { settings.linger = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "pinWorkers");
+        if (!lua_isnil(L, -1)) { settings.pinWorkers = lua_toboolean(L, -1) != 0; }
+        lua_getfield(L, firstArg, "cpuSet");
+        if (!lua_isnil(L, -1) && !readCpuSet(L, -1, settings.cpuSet))
+        {
+            return luaL_argerror(L, firstArg, "cpuSet expected a cpu index or an array of cpu indices");
+        }
+        lua_getfield(L, firstArg, "numaNode");
+        if (!lua_isnil(L, -1) && settings.cpuSet.empty())
+        {
+            int node = static_cast<int>(lua_tointeger(L, -1));
+            if (!numaNodeCpus(node, settings.cpuSet))
+            {
+                lua_pushnil(L);
+                lua_pushfstring(L, "unable to get the cpus of NUMA node %d.", node);
+                return 2;
+            }
+        }
+    }
+
+    if (settings.maxThreads < 1 || settings.minThreads < 0 || settings.minThreads > settings.maxThreads)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "maxThreads must be at least 1, and minThreads between 0 and maxThreads.");
+        return 2;
+    }
+
+    if (!settings.cpuSet.empty() && !cpuAffinitySupported())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "cpu affinity is not supported on this platform.");
+        return 2;
+    }
+
+    int unavailable = unavailableCpu(settings.cpuSet);
+    if (unavailable >= 0)
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cpu %d is not available to this process.", unavailable);
+        return 2;
+    }
+
+    ExecutorUserdata* exud = NULL;
+    void* p = lua_newuserdata(L, sizeof *exud);
+
+    try
+    {
+        exud = new(p) ExecutorUserdata(settings);
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    // callbacks are kept in a table keyed by job id until poll() runs them.
+    lua_newtable(L);
+    exud->mCallbacksRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    setupPocoUserdata(L, exud, POCO_EXECUTOR_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type executor
+
+// metamethod infrastructure
+int ExecutorUserdata::metamethod__gc(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, exud->mCallbacksRef);
+    // waits for submitted jobs to finish.
+    exud->~ExecutorUserdata();
+
+    return 0;
+}
+
+int ExecutorUserdata::metamethod__tostring(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+
+    lua_pushfstring(L, "Poco.Executor (%p)", static_cast<void*>(exud));
+    return 1;
+}
+
+// copies the function at functionIndex and the parameters following it to a new job, and submits it.
+int ExecutorUserdata::submitJob(lua_State* L, int functionIndex, bool callback)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+    luaL_checktype(L, functionIndex, LUA_TFUNCTION);
+    int top = lua_gettop(L);
+
+    ExecutorJob* job = NULL;
+    try
+    {
+        job = new ExecutorJob(exud->mNextId, callback);
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    lua_checkstack(job->mState, top - functionIndex + 1);
+    for (int i = functionIndex; i <= top; ++i)
+    {
+        lua_pushvalue(L, i);
+        if (!transferValue(job->mState, L))
+        {
+            delete job;
+            lua_pushnil(L);
+            lua_pushfstring(L, "non-copyable value at parameter %d\n", i);
+            return 2;
+        }
+        lua_pop(L, 1);
+    }
+
+    // the callback is stored first, as the job may complete before submit returns.
+    if (callback)
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, exud->mCallbacksRef);
+        pushInteger(L, exud->mNextId);
+        lua_pushvalue(L, 2);
+        lua_rawset(L, -3);
+        lua_pop(L, 1);
+    }
+
+    try
+    {
+        exud->mExecutor.submit(job);
+    }
+    catch (const std::exception& e)
+    {
+        if (callback)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, exud->mCallbacksRef);
+            pushInteger(L, exud->mNextId);
+            lua_pushnil(L);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+        }
+        return pushException(L, e);
+    }
+
+    pushInteger(L, exud->mNextId++);
+    return 1;
+}
+
+// userdata methods
+
+/// Submits a function to run on the executor.
+// The function and parameters are copied to the worker's Lua state, as with thread:start().
+// Errors raised by the function are only counted, see failures().
+// @func func function to run.
+// @param[opt] ... parameters passed to the function.
+// @return job id or nil. (error)
+// @return error message.
+// @function submit
+int ExecutorUserdata::submit(lua_State* L)
+{
+    return submitJob(L, 2, false);
+}
+
+/// Submits a function to run on the executor, with a callback for its results.
+// The callback is called by poll() in the owner's state, as callback(true, ...) with the function's
+// return values, or callback(false, errorMessage) if the function failed.
+// @func callback function called with the results of the job.
+// @func func function to run.
+// @param[opt] ... parameters passed to the function.
+// @return job id or nil. (error)
+// @return error message.
+// @function submitWithCallback
+int ExecutorUserdata::submitWithCallback(lua_State* L)
+{
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    return submitJob(L, 3, true);
+}
+
+/// Runs the callbacks of completed jobs.
+// All jobs completed since the last poll are collected at once. When a callback raises an error,
+// the remaining callbacks still run, and the first error is raised once they have.
+// @int[opt] ms milliseconds to wait for a job to complete when none have. (default: 0)
+// @return number of callbacks run.
+// @function poll
+int ExecutorUserdata::poll(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+    long ms = static_cast<long>(luaL_optinteger(L, 2, 0));
+    std::vector<ExecutorJob*> jobs;
+    // room for the callbacks table, and a callback with a failed job's arguments.
+    luaL_checkstack(L, 5, "too many job results");
+
+    try
+    {
+        exud->mExecutor.takeCompleted(jobs, ms);
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, exud->mCallbacksRef);
+    int callbacksIndex = lua_gettop(L);
+    int errorIndex = 0;
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        ExecutorJob* job = jobs[i];
+        int results = job->mOk ? lua_gettop(job->mState) : 1;
+        // the jobs are already taken from the executor, so a job whose results do not fit fails instead of raising.
+        if (job->mOk && (!lua_checkstack(L, results + 3 + TRANSFER_STACK_SLOTS) ||
+            !lua_checkstack(job->mState, TRANSFER_STACK_SLOTS + 1)))
+        {
+            job->mOk = false;
+            job->mError = "too many job results";
+            results = 1;
+        }
+
+        pushInteger(L, job->mId);
+        lua_rawget(L, callbacksIndex);
+        pushInteger(L, job->mId);
+        lua_pushnil(L);
+        lua_rawset(L, callbacksIndex);
+
+        lua_pushboolean(L, job->mOk);
+        if (job->mOk)
+        {
+            for (int r = 1; r <= results; ++r)
+            {
+                lua_pushvalue(job->mState, r);
+                transferValue(L, job->mState);
+                lua_pop(job->mState, 1);
+            }
+        }
+        else { lua_pushlstring(L, job->mError.data(), job->mError.size()); }
+
+        delete job;
+        jobs[i] = NULL;
+
+        // the first error is kept on the stack below later callbacks.
+        if (lua_pcall(L, results + 1, 0, 0) != 0)
+        {
+            if (errorIndex == 0) { errorIndex = lua_gettop(L); }
+            else { lua_pop(L, 1); }
+        }
+    }
+
+    size_t count = jobs.size();
+    if (errorIndex != 0)
+    {
+        // lua_error does not unwind the stack, so the vector is released first.
+        std::vector<ExecutorJob*>().swap(jobs);
+        lua_pushvalue(L, errorIndex);
+        lua_error(L);
+    }
+
+    pushInteger(L, count);
+    return 1;
+}
+
+/// Waits for all submitted jobs to finish.
+// Callbacks are not run, see poll().
+// @int[opt] ms milliseconds to wait, waits indefinitely when omitted.
+// @return boolean indicating if all jobs finished.
+// @function join
+int ExecutorUserdata::join(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+    long ms = static_cast<long>(luaL_optinteger(L, 2, -1));
+    bool result = false;
+
+    try
+    {
+        result = exud->mExecutor.join(ms);
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    lua_pushboolean(L, result);
+    return 1;
+}
+
+/// Gets the number of submitted jobs which have not finished.
+// @return number of jobs.
+// @function pending
+int ExecutorUserdata::pending(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+    pushInteger(L, exud->mExecutor.pending());
+    return 1;
+}
+
+/// Gets the number of jobs submitted without a callback that failed.
+// The errors of jobs submitted with submitWithCallback are passed to their callbacks instead.
+// @return number of failed jobs.
+// @return error message of the most recent failure, or nil if no job has failed.
+// @function failures
+int ExecutorUserdata::failures(lua_State* L)
+{
+    ExecutorUserdata* exud = checkPrivateUserdata<ExecutorUserdata>(L, 1);
+    std::string lastError;
+    Poco::UInt64 count = 0;
+
+    try
+    {
+        count = exud->mExecutor.failures(lastError);
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    pushInteger(L, count);
+    if (count > 0) { lua_pushlstring(L, lastError.data(), lastError.size()); }
+    else { lua_pushnil(L); }
+    return 2;
+}
+
+} // LuaPoco
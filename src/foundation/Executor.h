@@ -0,0 +1,141 @@
+#ifndef LUA_POCO_EXECUTOR_H
+#define LUA_POCO_EXECUTOR_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include "CpuAffinity.h"
+#include <Poco/AtomicCounter.h>
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+#include <Poco/Types.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_executor(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_EXECUTOR_METATABLE_NAME;
+
+// settings parsed from the ExecutorSettings table supplied to the executor constructor.
+struct ExecutorSettings
+{
+    ExecutorSettings();
+    int minThreads;
+    int maxThreads;
+    int idleTime;
+    int stackSize;
+    bool reuseStates;
+    long linger;
+    CpuSet cpuSet;
+    bool pinWorkers;
+};
+
+// a submitted function and its parameters, held in a private state until a worker runs it.
+// when the job has a callback, the state then holds the function's return values.
+class ExecutorJob
+{
+public:
+    ExecutorJob(Poco::UInt64 id, bool callback);
+    ~ExecutorJob();
+
+    lua_State* mState;
+    Poco::UInt64 mId;
+    bool mCallback;
+    bool mOk;
+    std::string mError;
+};
+
+// runs jobs on a private Poco::ThreadPool. jobs are queued and drained by up to maxThreads runners,
+// each of which keeps a single Lua state for all of the jobs it runs when reuseStates is set.
+class Executor : public Poco::Runnable
+{
+public:
+    Executor(const ExecutorSettings& settings);
+    virtual ~Executor();
+
+    // takes ownership of job, which is deleted if it cannot be queued.
+    void submit(ExecutorJob* job);
+    // moves finished jobs with callbacks to jobs, waiting up to ms milliseconds for one when there are none.
+    void takeCompleted(std::vector<ExecutorJob*>& jobs, long ms);
+    // waits until all submitted jobs have finished, returns false if ms elapses first. negative ms waits indefinitely.
+    bool join(long ms);
+    // jobs submitted which have not finished.
+    Poco::UInt64 pending();
+    // count of failed jobs without a callback, and the error of the most recent one.
+    Poco::UInt64 failures(std::string& lastError);
+    // runner loop, executed on pool threads.
+    virtual void run();
+
+private:
+    void placeWorker();
+    void runJob(lua_State*& worker, ExecutorJob* job);
+
+    Poco::FastMutex mMutex;
+    // signalled when a job is queued for a lingering runner.
+    Poco::Condition mJobReady;
+    // signalled when a job finishes.
+    Poco::Condition mJobDone;
+    std::deque<ExecutorJob*> mQueue;
+    std::vector<ExecutorJob*> mCompleted;
+    Poco::UInt64 mPending;
+    // jobs without a callback whose errors have no other way to be reported.
+    Poco::UInt64 mFailures;
+    std::string mLastError;
+    int mRunners;
+    int mLingering;
+    int mMaxRunners;
+    bool mStopping;
+
+    bool mReuseStates;
+    // milliseconds a runner waits for another job before returning its thread to the pool.
+    long mLinger;
+    // CPUs the worker threads run on, when mPinWorkers is set each runner is given a single CPU in turn.
+    CpuSet mCpuSet;
+    bool mPinWorkers;
+    Poco::AtomicCounter mNextWorkerCpu;
+
+    Poco::ThreadPool mThreadPool;
+};
+
+class ExecutorUserdata : public Userdata
+{
+public:
+    ExecutorUserdata(const ExecutorSettings& settings);
+    virtual ~ExecutorUserdata();
+    // register metatable for this class
+    static bool registerExecutor(lua_State* L);
+    // constructor function
+    static int Executor(lua_State* L);
+
+private:
+    // metamethod infrastructure
+    static int metamethod__gc(lua_State* L);
+    static int metamethod__tostring(lua_State* L);
+
+    // userdata methods
+    static int submit(lua_State* L);
+    static int submitWithCallback(lua_State* L);
+    static int poll(lua_State* L);
+    static int join(lua_State* L);
+    static int pending(lua_State* L);
+    static int failures(lua_State* L);
+
+    static int submitJob(lua_State* L, int functionIndex, bool callback);
+
+    LuaPoco::Executor mExecutor;
+    // registry reference to the table of callbacks keyed by job id.
+    int mCallbacksRef;
+    Poco::UInt64 mNextId;
+};
+
+} // LuaPoco
+
+#endif
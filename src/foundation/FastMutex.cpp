@@ -1,6 +1,8 @@
 /// Non-recursive synchronization mechanism used to control access to a shared resource.
 // Note: A deadlock will occur if the same thread tries to lock a mutex that has already locked.
 // Note: fastmutex userdata are copyable/sharable between threads.
+//
+// A fastmutex can optionally be profiled to find contended locks, see new and stats.
 // @module fastmutex
 
 #include "FastMutex.h"
@@ -17,14 +19,16 @@ namespace LuaPoco
 
 const char* POCO_FASTMUTEX_METATABLE_NAME = "Poco.FastMutex.metatable";
 
-FastMutexUserdata::FastMutexUserdata() :
-    mFastMutex(new Poco::FastMutex())
+FastMutexUserdata::FastMutexUserdata(const Poco::SharedPtr<LockProfile>& profile) :
+    mFastMutex(new Poco::FastMutex()),
+    mProfile(profile)
 {
 }
 
 // construct new Ud from existing SharedPtr
-FastMutexUserdata::FastMutexUserdata(const Poco::SharedPtr<Poco::FastMutex>& fm) :
-    mFastMutex(fm)
+FastMutexUserdata::FastMutexUserdata(const Poco::SharedPtr<Poco::FastMutex>& fm, const Poco::SharedPtr<LockProfile>& profile) :
+    mFastMutex(fm),
+    mProfile(profile)
 {
 }
 
@@ -40,7 +44,7 @@ bool FastMutexUserdata::copyToState(lua_State *L)
     
     try
     {
-        fmud = new(p) FastMutexUserdata(mFastMutex);
+        fmud = new(p) FastMutexUserdata(mFastMutex, mProfile);
     }
     catch (const std::exception& e)
     {
@@ -62,6 +66,7 @@ bool FastMutexUserdata::registerFastMutex(lua_State* L)
         { "lock", lock },
         { "tryLock", tryLock },
         { "unlock", unlock },
+        { "stats", stats },
         { NULL, NULL}
     };
 
@@ -71,18 +76,22 @@ bool FastMutexUserdata::registerFastMutex(lua_State* L)
 }
 
 /// constructs a new fastmutex userdata.
+// @param[opt] profile true to count acquisitions, contention, wait and hold times, or a name to add them
+// to the counts of all mutexes, fastmutexes, and semaphores profiled with the same name.
 // @return userdata or nil. (error)
 // @return error message
 // @function new
 int FastMutexUserdata::FastMutex(lua_State* L)
 {
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    Poco::SharedPtr<LockProfile> profile = readLockProfile(L, firstArg, true);
 
     FastMutexUserdata* fmud = NULL;
     void* p = lua_newuserdata(L, sizeof *fmud);
     
     try
     {
-        fmud = new(p) FastMutexUserdata();
+        fmud = new(p) FastMutexUserdata(profile);
     }
     catch (const std::exception& e)
     {
@@ -114,7 +123,8 @@ int FastMutexUserdata::lock(lua_State* L)
     
     try
     {
-        fmud->mFastMutex->lock();
+        if (fmud->mProfile.isNull()) { fmud->mFastMutex->lock(); }
+        else { fmud->mProfile->lock(*fmud->mFastMutex); }
     }
     catch (const std::exception& e)
     {
@@ -142,7 +152,9 @@ int FastMutexUserdata::tryLock(lua_State* L)
     
     try
     {
-        if (ms > 0)
+        if (!fmud->mProfile.isNull())
+            result = fmud->mProfile->tryLock(*fmud->mFastMutex, ms);
+        else if (ms > 0)
             result = fmud->mFastMutex->tryLock(ms);
         else
             result = fmud->mFastMutex->tryLock();
@@ -164,7 +176,8 @@ int FastMutexUserdata::unlock(lua_State* L)
     
     try
     {
-        fmud->mFastMutex->unlock();
+        if (fmud->mProfile.isNull()) { fmud->mFastMutex->unlock(); }
+        else { fmud->mProfile->unlock(*fmud->mFastMutex); }
     }
     catch (const std::exception& e)
     {
@@ -175,4 +188,17 @@ int FastMutexUserdata::unlock(lua_State* L)
     return 0;
 }
 
+/// Gets the profiling counts of the fastmutex, or of all locks sharing its profile name.
+// Times are in microseconds. The counts are shared by all copies of the fastmutex.
+// Note: waiting on a condition with the fastmutex is counted as holding it.
+// @return table with the fields: name, acquisitions, contended (acquisitions which had to wait), failed
+// (tryLock calls which did not acquire the fastmutex), waitTime, maxWait, holdTime and maxHold.
+// Or nil and an error message if the fastmutex was not constructed with profiling.
+// @function stats
+int FastMutexUserdata::stats(lua_State* L)
+{
+    FastMutexUserdata* fmud = checkPrivateUserdata<FastMutexUserdata>(L, 1);
+    return pushLockStats(L, fmud->mProfile);
+}
+
 } // LuaPoco
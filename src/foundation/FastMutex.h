@@ -3,6 +3,7 @@
 
 #include "LuaPoco.h"
 #include "Userdata.h"
+#include "LockProfile.h"
 #include <Poco/Mutex.h>
 #include <Poco/SharedPtr.h>
 
@@ -19,8 +20,8 @@ extern const char* POCO_FASTMUTEX_METATABLE_NAME;
 class FastMutexUserdata : public Userdata
 {
 public:
-    FastMutexUserdata();
-    FastMutexUserdata(const Poco::SharedPtr<Poco::FastMutex>& mtx);
+    FastMutexUserdata(const Poco::SharedPtr<LockProfile>& profile);
+    FastMutexUserdata(const Poco::SharedPtr<Poco::FastMutex>& mtx, const Poco::SharedPtr<LockProfile>& profile);
     virtual ~FastMutexUserdata();
     virtual bool copyToState(lua_State *L);
     // register metatable for this class
@@ -29,6 +30,8 @@ public:
     static int FastMutex(lua_State* L);
     
     Poco::SharedPtr<Poco::FastMutex> mFastMutex;
+    // null unless profiling was requested at construction.
+    Poco::SharedPtr<LockProfile> mProfile;
 private:
     // metamethod infrastructure
     static int metamethod__tostring(lua_State* L);
@@ -37,6 +40,7 @@ private:
     static int lock(lua_State* L);
     static int tryLock(lua_State* L);
     static int unlock(lua_State* L);
+    static int stats(lua_State* L);
 };
 
 } // LuaPoco
@@ -0,0 +1,603 @@
+/// Immutable tables shared between threads.
+// A frozen table is built once from a Lua table, converting it and all of its subtables into an immutable tree
+// of booleans, numbers, strings, and tables. Reading a frozen table works like reading a Lua table, via indexing,
+// the length operator, and pairs. (frozen.pairs for Lua 5.1)
+//
+// Keys may be booleans, numbers, or strings. Values may be booleans, numbers, strings, or tables.
+// Subtables referenced more than once, including cycles, are frozen once and shared.
+//
+// Note: frozen userdata are sharable between threads. Copying one to another thread shares the same tree
+// without copying it, and the tree is read without any locking.
+//
+// Note: indexing a subtable returns a new frozen userdata referencing the shared tree, use == to compare them.
+// @module frozen
+
+#include "Frozen.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Exception.h>
+#include <cstring>
+
+int luaopen_poco_frozen(lua_State* L)
+{
+    struct LuaPoco::CFunctions methods[] =
+    {
+        { "pairs", LuaPoco::FrozenUserdata::pairs },
+        { NULL, NULL}
+    };
+
+    LuaPoco::FrozenUserdata::registerFrozen(L);
+    int rv = LuaPoco::loadConstructor(L, LuaPoco::FrozenUserdata::Frozen);
+    if (rv == 1) { setCFunctions(L, methods); }
+
+    return rv;
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_FROZEN_METATABLE_NAME = "Poco.Frozen.metatable";
+
+namespace
+{
+
+Poco::UInt64 mix(Poco::UInt64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// gets numbers with an integral value as an integer, such that 1 and 1.0 are the same key.
+bool toInteger(lua_State* L, int index, Poco::Int64& integer)
+{
+#if LUA_VERSION_NUM > 502
+    if (lua_isinteger(L, index))
+    {
+        integer = static_cast<Poco::Int64>(lua_tointeger(L, index));
+        return true;
+    }
+#endif
+    lua_Number n = lua_tonumber(L, index);
+    if (n >= -9223372036854775808.0 && n < 9223372036854775808.0 && n == static_cast<lua_Number>(static_cast<Poco::Int64>(n)))
+    {
+        integer = static_cast<Poco::Int64>(n);
+        return true;
+    }
+
+    return false;
+}
+
+bool isInteger(lua_State* L, int index, Poco::Int64& integer)
+{
+#if LUA_VERSION_NUM > 502
+    if (lua_isinteger(L, index))
+    {
+        integer = static_cast<Poco::Int64>(lua_tointeger(L, index));
+        return true;
+    }
+#else
+    (void) L;
+    (void) index;
+    (void) integer;
+#endif
+    return false;
+}
+
+}
+
+FrozenTree::FrozenTree()
+{
+}
+
+FrozenTree::~FrozenTree()
+{
+}
+
+// subtables are read breadth first from a queue of pending tables rather than recursively,
+// such that deeply nested tables are not constrained by the C stack.
+bool FrozenTree::build(lua_State* L, int index)
+{
+    index = index < 0 ? lua_gettop(L) + 1 + index : index;
+    int top = lua_gettop(L);
+
+    // source table -> mTables index.
+    lua_newtable(L);
+    int seenIndex = top + 1;
+    // mTables index + 1 -> source table.
+    lua_newtable(L);
+    int pendingIndex = top + 2;
+    // string -> mStrings index, which stores each distinct string once.
+    lua_newtable(L);
+    int stringsIndex = top + 3;
+
+    lua_pushvalue(L, index);
+    lua_pushinteger(L, 0);
+    lua_rawset(L, seenIndex);
+    lua_pushvalue(L, index);
+    lua_rawseti(L, pendingIndex, 1);
+    mTables.push_back(Table());
+
+    // mTables grows as subtables are found, so tables are always accessed by index.
+    for (size_t t = 0; t < mTables.size(); ++t)
+    {
+        lua_rawgeti(L, pendingIndex, static_cast<int>(t + 1));
+        int tableIndex = lua_gettop(L);
+#if LUA_VERSION_NUM > 501
+        size_t length = lua_rawlen(L, tableIndex);
+#else
+        size_t length = lua_objlen(L, tableIndex);
+#endif
+        Value hole;
+        hole.type = Value::NIL;
+        mTables[t].array.assign(length, hole);
+
+        lua_pushnil(L);
+        while (lua_next(L, tableIndex))
+        {
+            Value value;
+            if (!readValue(L, seenIndex, pendingIndex, stringsIndex, false, value))
+            {
+                const char* typeName = lua_typename(L, lua_type(L, -1));
+                lua_settop(L, top);
+                lua_pushnil(L);
+                lua_pushfstring(L, "non-freezable value of type %s\n", typeName);
+                return false;
+            }
+            lua_pop(L, 1);
+
+            Poco::Int64 integer = 0;
+            if (lua_type(L, -1) == LUA_TNUMBER && toInteger(L, -1, integer) &&
+                integer >= 1 && static_cast<Poco::UInt64>(integer) <= length)
+            {
+                mTables[t].array[static_cast<size_t>(integer - 1)] = value;
+                continue;
+            }
+
+            Entry entry;
+            entry.value = value;
+            if (lua_type(L, -1) == LUA_TTABLE || !readValue(L, seenIndex, pendingIndex, stringsIndex, true, entry.key))
+            {
+                const char* typeName = lua_typename(L, lua_type(L, -1));
+                lua_settop(L, top);
+                lua_pushnil(L);
+                lua_pushfstring(L, "non-freezable key of type %s\n", typeName);
+                return false;
+            }
+            mTables[t].entries.push_back(entry);
+        }
+
+        lua_pop(L, 1);
+        hashEntries(mTables[t]);
+    }
+
+    lua_settop(L, top);
+    return true;
+}
+
+// converts the value at the top of the stack, queueing tables that have not been seen yet.
+bool FrozenTree::readValue(lua_State* L, int seenIndex, int pendingIndex, int stringsIndex, bool isKey, Value& value)
+{
+    switch (lua_type(L, -1))
+    {
+    case LUA_TBOOLEAN:
+        value.type = Value::BOOLEAN;
+        value.boolean = lua_toboolean(L, -1) != 0;
+        break;
+    case LUA_TNUMBER:
+        // keys are normalized the same way lookups are, values keep their integer/float subtype.
+        if (isKey ? toInteger(L, -1, value.integer) : isInteger(L, -1, value.integer)) { value.type = Value::INTEGER; }
+        else
+        {
+            value.type = Value::NUMBER;
+            value.number = static_cast<double>(lua_tonumber(L, -1));
+        }
+        break;
+    case LUA_TSTRING:
+        value.type = Value::STRING;
+        lua_pushvalue(L, -1);
+        lua_rawget(L, stringsIndex);
+        if (lua_isnumber(L, -1)) { value.index = static_cast<size_t>(lua_tonumber(L, -1)); }
+        else
+        {
+            size_t len = 0;
+            const char* str = lua_tolstring(L, -2, &len);
+            mStrings.push_back(std::string(str, len));
+            value.index = mStrings.size() - 1;
+
+            lua_pushvalue(L, -2);
+            lua_pushnumber(L, static_cast<lua_Number>(value.index));
+            lua_rawset(L, stringsIndex);
+        }
+        lua_pop(L, 1);
+        break;
+    case LUA_TTABLE:
+        value.type = Value::TABLE;
+        lua_pushvalue(L, -1);
+        lua_rawget(L, seenIndex);
+        if (lua_isnumber(L, -1)) { value.index = static_cast<size_t>(lua_tonumber(L, -1)); }
+        else
+        {
+            mTables.push_back(Table());
+            value.index = mTables.size() - 1;
+
+            lua_pushvalue(L, -2);
+            lua_pushnumber(L, static_cast<lua_Number>(value.index));
+            lua_rawset(L, seenIndex);
+            lua_pushvalue(L, -2);
+            lua_rawseti(L, pendingIndex, static_cast<int>(value.index + 1));
+        }
+        lua_pop(L, 1);
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+void FrozenTree::hashEntries(Table& table)
+{
+    if (table.entries.empty()) { return; }
+
+    // keep the load factor at or below one half.
+    size_t slotCount = 2;
+    while (slotCount < table.entries.size() * 2) { slotCount <<= 1; }
+    table.slots.assign(slotCount, 0);
+    size_t mask = slotCount - 1;
+
+    for (size_t i = 0; i < table.entries.size(); ++i)
+    {
+        const Value& key = table.entries[i].key;
+        const char* str = key.type == Value::STRING ? mStrings[key.index].data() : NULL;
+        size_t len = key.type == Value::STRING ? mStrings[key.index].size() : 0;
+
+        size_t slot = static_cast<size_t>(hashKey(key, str, len)) & mask;
+        while (table.slots[slot] != 0) { slot = (slot + 1) & mask; }
+        table.slots[slot] = static_cast<Poco::UInt32>(i + 1);
+    }
+}
+
+bool FrozenTree::readKey(lua_State* L, int keyIndex, Value& key, const char*& str, size_t& len) const
+{
+    switch (lua_type(L, keyIndex))
+    {
+    case LUA_TSTRING:
+        key.type = Value::STRING;
+        str = lua_tolstring(L, keyIndex, &len);
+        return true;
+    case LUA_TNUMBER:
+        if (toInteger(L, keyIndex, key.integer)) { key.type = Value::INTEGER; }
+        else
+        {
+            key.type = Value::NUMBER;
+            key.number = static_cast<double>(lua_tonumber(L, keyIndex));
+        }
+        return true;
+    case LUA_TBOOLEAN:
+        key.type = Value::BOOLEAN;
+        key.boolean = lua_toboolean(L, keyIndex) != 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+Poco::UInt64 FrozenTree::hashKey(const Value& key, const char* str, size_t len) const
+{
+    switch (key.type)
+    {
+    case Value::STRING:
+    {
+        // FNV-1a
+        Poco::UInt64 h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= static_cast<unsigned char>(str[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return mix(h);
+    }
+    case Value::INTEGER:
+        return mix(static_cast<Poco::UInt64>(key.integer));
+    case Value::NUMBER:
+    {
+        Poco::UInt64 bits = 0;
+        std::memcpy(&bits, &key.number, sizeof bits);
+        return mix(bits ^ 0x9e3779b97f4a7c15ULL);
+    }
+    case Value::BOOLEAN:
+        return mix(key.boolean ? 1 : 2);
+    default:
+        return 0;
+    }
+}
+
+size_t FrozenTree::findEntry(const Table& table, const Value& key, const char* str, size_t len) const
+{
+    if (table.slots.empty()) { return 0; }
+
+    size_t mask = table.slots.size() - 1;
+    size_t slot = static_cast<size_t>(hashKey(key, str, len)) & mask;
+
+    while (table.slots[slot] != 0)
+    {
+        const Value& candidate = table.entries[table.slots[slot] - 1].key;
+        if (candidate.type == key.type)
+        {
+            bool equal = false;
+            switch (key.type)
+            {
+            case Value::STRING:
+            {
+                const std::string& s = mStrings[candidate.index];
+                equal = s.size() == len && std::memcmp(s.data(), str, len) == 0;
+                break;
+            }
+            case Value::INTEGER:
+                equal = candidate.integer == key.integer;
+                break;
+            case Value::NUMBER:
+                equal = candidate.number == key.number;
+                break;
+            case Value::BOOLEAN:
+                equal = candidate.boolean == key.boolean;
+                break;
+            default:
+                break;
+            }
+
+            if (equal) { return table.slots[slot]; }
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return 0;
+}
+
+void FrozenTree::pushValue(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, const Value& value) const
+{
+    switch (value.type)
+    {
+    case Value::NIL:
+        lua_pushnil(L);
+        break;
+    case Value::BOOLEAN:
+        lua_pushboolean(L, value.boolean);
+        break;
+    case Value::INTEGER:
+        pushInteger(L, value.integer);
+        break;
+    case Value::NUMBER:
+        lua_pushnumber(L, static_cast<lua_Number>(value.number));
+        break;
+    case Value::STRING:
+        lua_pushlstring(L, mStrings[value.index].data(), mStrings[value.index].size());
+        break;
+    case Value::TABLE:
+        if (!FrozenUserdata::push(L, tree, value.index)) { luaL_error(L, "unable to create frozen userdata."); }
+        break;
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+void FrozenTree::pushField(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table, int keyIndex) const
+{
+    const Table& t = mTables[table];
+    Value key;
+    const char* str = NULL;
+    size_t len = 0;
+
+    if (!readKey(L, keyIndex, key, str, len)) { lua_pushnil(L); return; }
+
+    if (key.type == Value::INTEGER && key.integer >= 1 && static_cast<Poco::UInt64>(key.integer) <= t.array.size())
+    {
+        pushValue(L, tree, t.array[static_cast<size_t>(key.integer - 1)]);
+        return;
+    }
+
+    size_t entry = findEntry(t, key, str, len);
+    if (entry) { pushValue(L, tree, t.entries[entry - 1].value); }
+    else { lua_pushnil(L); }
+}
+
+// iteration visits the array part in order, followed by the remaining entries.
+int FrozenTree::pushNext(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table, int keyIndex) const
+{
+    const Table& t = mTables[table];
+    size_t position = 0;
+
+    if (!lua_isnil(L, keyIndex))
+    {
+        Value key;
+        const char* str = NULL;
+        size_t len = 0;
+        size_t entry = 0;
+
+        if (!readKey(L, keyIndex, key, str, len)) { return luaL_error(L, "invalid key to 'next'"); }
+
+        if (key.type == Value::INTEGER && key.integer >= 1 && static_cast<Poco::UInt64>(key.integer) <= t.array.size())
+        {
+            position = static_cast<size_t>(key.integer);
+        }
+        else if ((entry = findEntry(t, key, str, len)) != 0) { position = t.array.size() + entry; }
+        else { return luaL_error(L, "invalid key to 'next'"); }
+    }
+
+    // holes within the border of the source table are skipped, as pairs would skip them.
+    while (position < t.array.size() && t.array[position].type == Value::NIL) { ++position; }
+
+    if (position < t.array.size())
+    {
+        pushInteger(L, static_cast<Poco::Int64>(position + 1));
+        pushValue(L, tree, t.array[position]);
+        return 2;
+    }
+
+    position -= t.array.size();
+    if (position < t.entries.size())
+    {
+        pushValue(L, tree, t.entries[position].key);
+        pushValue(L, tree, t.entries[position].value);
+        return 2;
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+size_t FrozenTree::length(size_t table) const
+{
+    return mTables[table].array.size();
+}
+
+FrozenUserdata::FrozenUserdata(const Poco::SharedPtr<FrozenTree>& tree, size_t table) :
+    mTree(tree),
+    mTable(table)
+{
+}
+
+FrozenUserdata::~FrozenUserdata()
+{
+}
+
+bool FrozenUserdata::copyToState(lua_State *L)
+{
+    registerFrozen(L);
+    return push(L, mTree, mTable);
+}
+
+bool FrozenUserdata::push(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table)
+{
+    FrozenUserdata* fud = NULL;
+    void* p = lua_newuserdata(L, sizeof *fud);
+
+    try
+    {
+        fud = new(p) FrozenUserdata(tree, table);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, fud, POCO_FROZEN_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool FrozenUserdata::registerFrozen(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "__newindex", metamethod__newindex },
+        { "__len", metamethod__len },
+        { "__eq", metamethod__eq },
+        { "__pairs", pairs },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_FROZEN_METATABLE_NAME, methods);
+    // fields are looked up in the tree rather than the metatable.
+    luaL_getmetatable(L, POCO_FROZEN_METATABLE_NAME);
+    lua_pushcfunction(L, metamethod__index);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    return true;
+}
+
+/// Constructs a new frozen userdata from a table.
+// @tab table table to freeze, later changes to it are not reflected in the frozen table.
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+int FrozenUserdata::Frozen(lua_State* L)
+{
+    int tableIndex = lua_gettop(L) > 1 ? 2 : 1;
+
+    if (lua_isuserdata(L, tableIndex) && dynamic_cast<FrozenUserdata*>(getPrivateUserdata(L, tableIndex)))
+    {
+        lua_pushvalue(L, tableIndex);
+        return 1;
+    }
+
+    luaL_checktype(L, tableIndex, LUA_TTABLE);
+
+    try
+    {
+        Poco::SharedPtr<FrozenTree> tree(new FrozenTree());
+        if (!tree->build(L, tableIndex)) { return 2; }
+        if (!push(L, tree, 0)) { throw Poco::OutOfMemoryException("unable to create frozen userdata"); }
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    return 1;
+}
+
+/// Gets an iterator over a frozen table, for Lua 5.1 where pairs() does not support userdata.
+// @param frozen userdata.
+// @return iterator function, frozen userdata, nil.
+// @function pairs
+int FrozenUserdata::pairs(lua_State* L)
+{
+    checkPrivateUserdata<FrozenUserdata>(L, 1);
+    lua_pushcfunction(L, next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+int FrozenUserdata::next(lua_State* L)
+{
+    FrozenUserdata* fud = checkPrivateUserdata<FrozenUserdata>(L, 1);
+    lua_settop(L, 2);
+    return fud->mTree->pushNext(L, fud->mTree, fud->mTable, 2);
+}
+
+// metamethod infrastructure
+int FrozenUserdata::metamethod__tostring(lua_State* L)
+{
+    FrozenUserdata* fud = checkPrivateUserdata<FrozenUserdata>(L, 1);
+    lua_pushfstring(L, "Poco.Frozen (%p)", static_cast<void*>(fud));
+    return 1;
+}
+
+int FrozenUserdata::metamethod__index(lua_State* L)
+{
+    FrozenUserdata* fud = checkPrivateUserdata<FrozenUserdata>(L, 1);
+    fud->mTree->pushField(L, fud->mTree, fud->mTable, 2);
+    return 1;
+}
+
+int FrozenUserdata::metamethod__newindex(lua_State* L)
+{
+    return luaL_error(L, "attempt to modify a frozen table.");
+}
+
+int FrozenUserdata::metamethod__len(lua_State* L)
+{
+    FrozenUserdata* fud = checkPrivateUserdata<FrozenUserdata>(L, 1);
+    pushInteger(L, static_cast<Poco::Int64>(fud->mTree->length(fud->mTable)));
+    return 1;
+}
+
+int FrozenUserdata::metamethod__eq(lua_State* L)
+{
+    FrozenUserdata* a = checkPrivateUserdata<FrozenUserdata>(L, 1);
+    FrozenUserdata* b = checkPrivateUserdata<FrozenUserdata>(L, 2);
+    lua_pushboolean(L, a->mTree.get() == b->mTree.get() && a->mTable == b->mTable);
+    return 1;
+}
+
+} // LuaPoco
@@ -0,0 +1,111 @@
+#ifndef LUA_POCO_FROZEN_H
+#define LUA_POCO_FROZEN_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_frozen(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_FROZEN_METATABLE_NAME;
+
+// immutable copy of a Lua table and all of its subtables.
+// nothing is modified once build() returns, so any number of threads may read it without locking.
+class FrozenTree
+{
+public:
+    struct Value
+    {
+        // NIL marks a hole in the array part, it is never stored as an entry.
+        enum Type { NIL, BOOLEAN, INTEGER, NUMBER, STRING, TABLE };
+        Type type;
+        union
+        {
+            bool boolean;
+            Poco::Int64 integer;
+            double number;
+            // index into mStrings or mTables.
+            size_t index;
+        };
+    };
+
+    struct Entry
+    {
+        Value key;
+        Value value;
+    };
+
+    struct Table
+    {
+        // values for keys 1 to n, NIL for holes.
+        std::vector<Value> array;
+        // remaining key/value pairs in iteration order.
+        std::vector<Entry> entries;
+        // open addressing hash of entries, each slot holds an entries index + 1, or 0 when empty.
+        std::vector<Poco::UInt32> slots;
+    };
+
+    FrozenTree();
+    ~FrozenTree();
+
+    // builds the tree from the table at index, returns false with nil, errmsg pushed on L.
+    bool build(lua_State* L, int index);
+    // pushes the value of key at keyIndex in table, or nil.
+    void pushField(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table, int keyIndex) const;
+    // pushes the key and value following the key at keyIndex in table, or nil when done.
+    int pushNext(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table, int keyIndex) const;
+    size_t length(size_t table) const;
+
+private:
+    bool readValue(lua_State* L, int seenIndex, int pendingIndex, int stringsIndex, bool isKey, Value& value);
+    void hashEntries(Table& table);
+    bool readKey(lua_State* L, int keyIndex, Value& key, const char*& str, size_t& len) const;
+    Poco::UInt64 hashKey(const Value& key, const char* str, size_t len) const;
+    // returns the entries index + 1 of a key, 0 if not present.
+    size_t findEntry(const Table& table, const Value& key, const char* str, size_t len) const;
+    void pushValue(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, const Value& value) const;
+
+    std::vector<std::string> mStrings;
+    std::vector<Table> mTables;
+};
+
+class FrozenUserdata : public Userdata
+{
+public:
+    FrozenUserdata(const Poco::SharedPtr<FrozenTree>& tree, size_t table);
+    virtual ~FrozenUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerFrozen(lua_State* L);
+    // constructor function
+    static int Frozen(lua_State* L);
+    // module functions
+    static int pairs(lua_State* L);
+    // pushes a new userdata for a table of tree.
+    static bool push(lua_State* L, const Poco::SharedPtr<FrozenTree>& tree, size_t table);
+
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+    static int metamethod__index(lua_State* L);
+    static int metamethod__newindex(lua_State* L);
+    static int metamethod__len(lua_State* L);
+    static int metamethod__eq(lua_State* L);
+    static int next(lua_State* L);
+
+    Poco::SharedPtr<FrozenTree> mTree;
+    size_t mTable;
+};
+
+} // LuaPoco
+
+#endif
@@ -3,28 +3,47 @@
 // @module json
 
 #include "JSON.h"
-#include <Poco/JSON/Parser.h>
-#include <Poco/JSON/Handler.h>
-#include <Poco/JSON/PrintHandler.h>
+#include "JsonBatch.h"
+#include "JsonDecoder.h"
+#include "JsonEvents.h"
+#include "JsonLazy.h"
+#include "JsonQuery.h"
+#include "JsonWriter.h"
+#include "OStream.h"
+#include "TableEncoder.h"
+#include <Poco/Environment.h>
 #include <Poco/JSON/JSONException.h>
-#include <Poco/JSONString.h>
 #include <Poco/SharedPtr.h>
 #include "Userdata.h"
 #include "LuaPocoUtils.h"
+#include <vector>
 
 int luaopen_poco_json(lua_State* L)
 {
     struct LuaPoco::CFunctions methods[] =
     {
         { "encode", LuaPoco::JSON::encode },
+        { "encodeTo", LuaPoco::JSON::encodeTo },
         { "decode", LuaPoco::JSON::decode },
+        { "decodeMany", LuaPoco::JSON::decodeMany },
+        { "events", LuaPoco::JSON::events },
+        { "elements", LuaPoco::JSON::elements },
+        { "query", LuaPoco::JSON::query },
+        { "parseLazy", LuaPoco::JSON::parseLazy },
+        { "materialize", LuaPoco::JSON::materialize },
+        { "pairs", LuaPoco::JSON::pairs },
+        { "ndjsonReader", LuaPoco::JSON::ndjsonReader },
+        { "ndjsonWrite", LuaPoco::JSON::ndjsonWrite },
         { "null", LuaPoco::JSON::getNull },
         { "emptyObject", LuaPoco::JSON::getEmptyObject },
         { "emptyArray", LuaPoco::JSON::getEmptyArray },
         { NULL, NULL}
     };
 
-    lua_createtable(L, 0, 5);
+    LuaPoco::JsonEventsUserdata::registerJsonEvents(L);
+    LuaPoco::JsonLazyUserdata::registerJsonLazy(L);
+
+    lua_createtable(L, 0, 15);
     setCFunctions(L, methods);
 
     return 1;
@@ -37,379 +56,552 @@ char jsonNull[] = "Poco.JSON.null";
 char jsonEmptyArray[] = "Poco.JSON.Empty.Array";
 char jsonEmptyObject[] = "Poco.JSON.Empty.Object";
 
-struct TableInfo
-{
-    enum TableType { object, array} tableType;
-    size_t currentArrayIndex;
-    int tableStackIndex;
-};
-
-class JsonDecoder : public Poco::JSON::Handler
+template <>
+struct TableEncoderTraits<JsonWriter>
 {
-public:
+    static const bool COUNTED = false;
 
-    JsonDecoder(lua_State* L) : mState(L), mBaseTop(lua_gettop(L)) {}
-    virtual ~JsonDecoder() {}
-
-    virtual void reset()
+    static const char* name()
     {
-        lua_settop(mState, mBaseTop);
+        return "json";
     }
 
-    virtual void startObject()
+    static void fail(const std::string& message)
     {
-        lua_newtable(mState);
-        TableInfo ti = { TableInfo::TableType::object, 0, lua_gettop(mState) };
-        mTableQueue.push_back(ti);
+        throw Poco::JSON::JSONException(message);
     }
 
-    virtual void endObject()
+    static void startObject(JsonWriter& w, size_t)
     {
-        mTableQueue.pop_back();
-        setValue();
+        w.startObject();
     }
 
-    virtual void startArray()
+    static void startArray(JsonWriter& w, size_t)
     {
-        lua_newtable(mState);
-        TableInfo ti = { TableInfo::TableType::array, 0, lua_gettop(mState) };
-        mTableQueue.push_back(ti);
+        w.startArray();
     }
 
-    virtual void endArray()
+    static void number(JsonWriter& w, lua_State* L, int index)
     {
-        mTableQueue.pop_back();
-        setValue();
+    #if LUA_VERSION_NUM > 502
+        if (lua_isinteger(L, index))
+        {
+            Poco::Int64 i = static_cast<Poco::Int64>(lua_tointeger(L, index));
+            w.value(i);
+        }
+        else
+    #endif
+        {
+            double n = static_cast<double>(lua_tonumber(L, index));
+            w.value(n);
+        }
     }
 
-    virtual void key(const std::string& k)
+    static void numberKey(JsonWriter& w, lua_State* L, int index)
     {
-        // leave the key on the stack such that on a value, setValue is called to pop both off.
-        lua_pushlstring(mState, k.c_str(), k.size());
+        // converted on a copy, as converting the key in place would break lua_next.
+        size_t len = 0;
+        lua_pushvalue(L, index);
+        const char* key = lua_tolstring(L, -1, &len);
+        w.key(key, len);
+        lua_pop(L, 1);
     }
 
-    virtual void null()
+    static void otherKey(JsonWriter&, lua_State*, int)
     {
-        // use sentinel value jsonNull
-        lua_pushlightuserdata(mState, static_cast<void*>(jsonNull));
-        setValue();
+        fail("encountered key value that is not a string or number.");
     }
+};
+
+typedef TableEncoder<JsonWriter> JsonTableEncoder;
+
+// the state of decodeMany shared with pushBatchValues.
+struct BatchValues
+{
+    JsonBatchDecoder* batch;
+    size_t count;
+    // position of the first invalid document, 0 when all are valid.
+    size_t failed;
+    Poco::SharedPtr<JsonTape> tape;
+    std::string error;
+};
+
+// creates the values of each document in order as it is parsed, in the table at index 2.
+// called through lua_pcall, the tape and error are kept in BatchValues as they outlive a Lua error.
+static int pushBatchValues(lua_State* L)
+{
+    BatchValues* values = static_cast<BatchValues*>(lua_touserdata(L, 1));
 
-    // based on the poco code, int and unsigned are pure virtual functions, but will never be
-    // called as ParserImpl only uses Int64s for whatever reason.  including for completeness.
-    virtual void value(int v)
+    for (size_t i = 0; i < values->count; ++i)
     {
-        lua_Integer i = 0;
-        if (checkSignedToLuaInteger<int>(v, i))
+        bool pushed = false;
+
+        try
         {
-            lua_pushinteger(mState, static_cast<lua_Integer>(i));
-            setValue();
+            if (values->batch->wait(i, values->tape, values->error))
+            {
+                values->tape->push(L, 0);
+                pushed = true;
+            }
         }
-        else throw Poco::JSON::JSONException("out of range number");
-    }
-
-    virtual void value(unsigned v)
-    {
-        lua_Integer i = 0;
-        if (checkUnsignedToLuaInteger<unsigned>(v, i))
+        catch (const std::exception& e)
         {
-            lua_pushinteger(mState, static_cast<lua_Integer>(i));
-            setValue();
+            const Poco::Exception* pe = dynamic_cast<const Poco::Exception*>(&e);
+            values->error = pe != NULL ? pe->displayText() : e.what();
         }
-        else throw Poco::JSON::JSONException("out of range number");
-    }
 
-#if defined(POCO_HAVE_INT64)
-    virtual void value(Poco::Int64 v)
-    {
-        lua_Integer i = 0;
-        if (checkSignedToLuaInteger<Poco::Int64>(v, i))
+        if (!pushed)
         {
-            lua_pushinteger(mState, static_cast<lua_Integer>(i));
-            setValue();
+            values->failed = i + 1;
+            break;
         }
-        else throw Poco::JSON::JSONException("out of range number");
+
+        lua_rawseti(L, 2, static_cast<int>(i + 1));
+        values->tape = NULL;
     }
 
-    virtual void value(Poco::UInt64 v)
+    lua_settop(L, 2);
+    return 1;
+}
+
+/// encodes a table into a JSON string.
+// @tab table to encode
+// @int[opt] indent number of spaces to indent nested values by, 0 produces compact output. (default: 0)
+// @return value as string or nil. (error)
+// @return error message.
+// @function encode
+int JSON::encode(lua_State* L)
+{
+    int rv = 0;
+    unsigned indent = 0;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (lua_isnumber(L, 2)) { indent = static_cast<unsigned>(lua_tointeger(L, 2)); }
+    // TableEncoder expects the table it is encoding at the top of the stack.
+    lua_pushvalue(L, 1);
+
+    try
     {
-        lua_Integer i = 0;
-        if (checkUnsignedToLuaInteger<Poco::UInt64>(v, i))
-        {
-            lua_pushinteger(mState, static_cast<lua_Integer>(i));
-            setValue();
-        }
-        else throw Poco::JSON::JSONException("out of range number");
+        JsonWriter writer(indent);
+        JsonTableEncoder te(L, writer);
+        // either a string is returned at the top of the stack
+        // or nil, errmsg
+        if (te.encode()) { rv = 1; }
+        else { rv = 2; }
     }
-#endif
-
-    virtual void value(const std::string& s)
+    catch (const std::exception& e)
     {
-        lua_pushlstring(mState, s.c_str(), s.size());
-        setValue();
+        rv = pushException(L, e);
     }
+    
+    return rv;
+}
+
+/// encodes a table as JSON, written to an ostream.
+// The output is written in chunks as it is encoded, such that memory use does not grow with the size of the
+// document. On error, the part of the document encoded before the error may have been written.
+// @param ostream ostream userdata, such as a fileostream, pipeostream, teeostream or deflatingostream.
+// @tab table to encode
+// @int[opt] indent number of spaces to indent nested values by, 0 produces compact output. (default: 0)
+// @return true or nil. (error)
+// @return error message.
+// @function encodeTo
+// @see ostream
+int JSON::encodeTo(lua_State* L)
+{
+    int rv = 0;
+    unsigned indent = 0;
+
+    OStream* os = checkPrivateUserdata<OStream>(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    if (lua_isnumber(L, 3)) { indent = static_cast<unsigned>(lua_tointeger(L, 3)); }
+    // TableEncoder expects the table it is encoding at the top of the stack.
+    lua_pushvalue(L, 2);
+
+    try
+    {
+        JsonWriter writer(indent, os->ostream());
+        JsonTableEncoder te(L, writer);
+        te.encodeToSink();
 
-    virtual void value(double d)
+        lua_pushboolean(L, 1);
+        rv = 1;
+    }
+    catch (const std::exception& e)
     {
-        lua_pushnumber(mState, static_cast<lua_Number>(d));
-        setValue();
+        rv = pushException(L, e);
     }
 
-    virtual void value(bool b)
+    return rv;
+}
+
+/// decodes a JSON document into a table.
+// The document can be read from a string, from an istream, or from the memory of a buffer or sharedmemory.
+// An istream is parsed incrementally, and must hold nothing but the document.
+// Memory is parsed in place, with the document ending at the first zero byte, if any.
+// Errors include the byte offset in the input at which the document is invalid.
+// @param input JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return table or nil. (error)
+// @return error message.
+// @function decode
+// @see istream
+// @see buffer
+// @see sharedmemory
+int JSON::decode(lua_State* L)
+{
+    int rv = 0;
+    DecodeInput input;
+
+    if (!getDecodeInput(L, 1, input, true))
     {
-        lua_pushboolean(mState, static_cast<int>(b));
-        setValue();
+        return luaL_argerror(L, 1, "expected string, istream, buffer or sharedmemory");
     }
 
-private:
-    // utility functions
-    void setValue()
+    try
     {
-        if (mTableQueue.size() > 0)
+        if (input.stream)
         {
-            TableInfo& ti = mTableQueue.back();
-            if (ti.tableType == TableInfo::TableType::array)
-            {
-                ++ti.currentArrayIndex;
-                lua_rawseti(mState, ti.tableStackIndex, ti.currentArrayIndex);
-            }
-            else
-            {
-                const char *tn = lua_typename(mState, lua_type(mState, -1));
-                lua_rawset(mState, ti.tableStackIndex);
-            }
+            JsonReader reader(*input.stream);
+            decodeDocument(L, reader);
         }
         else
         {
-            // the last value is a table that should be left behind and returned.
-            if (lua_type(mState, -1) != LUA_TTABLE)
-                throw Poco::JSON::JSONException("attempt to set a value when no objects present");
+            JsonReader reader(input.data, input.size);
+            decodeDocument(L, reader);
         }
+
+        rv = 1;
     }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+    
+    return rv;
+}
 
-    lua_State* mState;
-    int mBaseTop;
+/// decodes an array of JSON documents in parallel.
+// The documents are parsed on threads of the default thread pool into a compact intermediate form, while the
+// calling thread creates the Lua values of each document in order as soon as it is parsed. The calling thread
+// also parses documents while waiting, so the result does not depend on threads being available in the pool.
+// @tab documents array of JSON strings.
+// @tab[opt] options table, where threads is the number of threads parsing at once, including the calling thread.
+// defaults to the number of processors.
+// @return table or nil. (error) an array of the decoded documents, in the order of documents.
+// @return error message, prefixed by the position of the first invalid document.
+// @function decodeMany
+// @see decode
+int JSON::decodeMany(lua_State* L)
+{
+    int threads = static_cast<int>(Poco::Environment::processorCount());
 
-    std::vector<TableInfo> mTableQueue;
-};
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_getfield(L, 2, "threads");
+        if (!lua_isnil(L, -1)) { threads = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_pop(L, 1);
+    }
 
-class TableEncoder
-{
-public:
-    TableEncoder(lua_State* L, unsigned indent) : mState(L), mStream(), mPrintHandler(mStream, indent) {}
-    ~TableEncoder() {}
+    if (threads < 1)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "threads must be at least 1.");
+        return 2;
+    }
 
-    bool encode()
+    // the element types are checked before the vector exists, as luaL_argerror does not unwind it.
+    size_t count = 0;
+    for (;;)
     {
-        handleTable();
+        lua_rawgeti(L, 1, static_cast<int>(count + 1));
+        int type = lua_type(L, -1);
+        lua_pop(L, 1);
+        if (type == LUA_TNIL) { break; }
+        if (type != LUA_TSTRING) { return luaL_argerror(L, 1, "expected an array of strings"); }
+        ++count;
+    }
+
+    // everything raising a Lua error is pushed before any C++ objects with destructors are created.
+    lua_settop(L, 2);
+    BatchValues values = { NULL, 0, 0, Poco::SharedPtr<JsonTape>(), std::string() };
+    lua_pushcfunction(L, pushBatchValues);
+    lua_pushlightuserdata(L, &values);
+    lua_createtable(L, static_cast<int>(count), 0);
 
-        while (mTableQueue.size() > 0)
+    int status = 0;
+
+    try
+    {
+        // the strings stay referenced by the documents table for the duration of the call.
+        std::vector<std::pair<const char*, size_t> > documents;
+        documents.reserve(count);
+        for (size_t i = 1; i <= count; ++i)
         {
-            TableInfo& ti = mTableQueue.back();
-            if (ti.tableType == TableInfo::TableType::array)
-            {
-                lua_rawgeti(mState, ti.tableStackIndex, ++ti.currentArrayIndex);
-                if (!lua_isnil(mState, -1)) { handleValue(); }
-                else
-                {
-                    // pop nil, array
-                    lua_pop(mState, 2);
-                    mTableQueue.pop_back();
-                    mPrintHandler.endArray();
-                }
-            }
-            else
-            {
-                // handleTable() leaves nil on the stack to for the nested table iteration.
-                if (lua_next(mState, ti.tableStackIndex))
-                {
-                    if (lua_isstring(mState, -2))
-                    {
-                        const char* key = lua_tostring(mState, -2);
-                        mPrintHandler.key(key);
-                        handleValue();
-                    }
-                    else throw Poco::JSON::JSONException("encountered key value that is not a string.");
-                }
-                else
-                {
-                    // done with object, pop it.
-                    lua_pop(mState, 1);
-                    mTableQueue.pop_back();
-                    mPrintHandler.endObject();
-                }
-            }
+            lua_rawgeti(L, 1, static_cast<int>(i));
+            size_t size = 0;
+            const char* data = lua_tolstring(L, -1, &size);
+            documents.push_back(std::make_pair(data, size));
+            lua_pop(L, 1);
         }
 
-        std::string jsonString = mStream.str();
-        lua_pushlstring(mState, jsonString.c_str(), jsonString.size());
-        // return all pending tables were processed
-        return mTableQueue.empty();
+        JsonBatchDecoder batch(documents);
+        int workers = threads - 1;
+        if (static_cast<size_t>(workers) >= documents.size()) { workers = static_cast<int>(documents.size()) - 1; }
+        batch.start(workers);
+
+        values.batch = &batch;
+        values.count = count;
+        // a memory error while creating the values must not skip ~JsonBatchDecoder, which stops the workers.
+        status = lua_pcall(L, 2, 1, 0);
+        values.tape = NULL;
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
     }
 
-private:
-    // arrays are defined as tables that operate as sequences from 1 to n with [n + 1] == nil to terminate.
-    // objects are defined as not having an array part, and only string keys being present.
-    bool isArray(int index)
+    // raised once the workers are finished.
+    if (status != 0) { return lua_error(L); }
+
+    if (values.failed > 0)
     {
-        lua_rawgeti(mState, index, 1);
-        bool result = !lua_isnil(mState, -1);
-        lua_pop(mState, 1);
-        return result;
+        lua_pushnil(L);
+        lua_pushfstring(L, "document %d: %s", static_cast<int>(values.failed), values.error.c_str());
+        return 2;
     }
 
-    void handleTable()
+    return 1;
+}
+
+/// finds the values at a set of JSON pointers in a document.
+// Pointers follow RFC 6901, such as "/user/id" or "/items/0/sku", and "" refers to the whole document.
+// Only the values found are decoded, as by decode. The rest of the document is skipped without creating
+// Lua values, and is not read past the point where every pointer has been resolved.
+// The input is read as in decode.
+// @param input JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @tab pointers array of JSON pointer strings.
+// @return table or nil. (error) the values found, keyed by their pointer. pointers to values which
+// are not present in the document have no entry.
+// @return error message.
+// @function query
+int JSON::query(lua_State* L)
+{
+    int rv = 0;
+    DecodeInput input;
+
+    if (!getDecodeInput(L, 1, input, true))
     {
-        // store table information in mQueue.
-        TableInfo ti =
-        {
-            isArray(-1) ? TableInfo::TableType::array : TableInfo::TableType::object,
-            0,
-            lua_gettop(mState)
-        };
-        mTableQueue.push_back(ti);
-
-        // leave key on the top of the stack so the loop can process it with calls to lua_next.
-        // inform printer of the start of a new object/array.
-        if (ti.tableType == TableInfo::TableType::object)
-        {
-            mPrintHandler.startObject();
-            lua_pushnil(mState);
-        }
-        else { mPrintHandler.startArray(); }
+        return luaL_argerror(L, 1, "expected string, istream, buffer or sharedmemory");
     }
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    lua_settop(L, 2);
+    lua_newtable(L);
 
-    void handleValue()
+    try
     {
-        int type = lua_type(mState, -1);
+        Poco::SharedPtr<JsonReader> reader(input.stream ? new JsonReader(*input.stream) : new JsonReader(input.data, input.size));
+        JsonQuery jq(L, *reader);
 
-        switch (type)
+        for (int i = 1; ; ++i)
         {
-        case LUA_TNIL:
-            throw Poco::JSON::JSONException("nil is an invalid value, use json.null");
-            break;
-        case LUA_TNUMBER:
-        #if LUA_VERSION_NUM > 502
-            if (lua_isinteger(mState, -1))
-            {
-                Poco::Int64 i = static_cast<Poco::Int64>(lua_tointeger(mState, -1));
-                mPrintHandler.value(i);
-            }
-            else
-        #endif
+            lua_rawgeti(L, 2, i);
+            if (lua_isnil(L, -1))
             {
-                lua_Number n = lua_tonumber(mState, -1);
-                mPrintHandler.value(n);
+                lua_pop(L, 1);
+                break;
             }
-            break;
-        case LUA_TBOOLEAN:
-        {
-            bool b = static_cast<bool>(lua_toboolean(mState, -1));
-            mPrintHandler.value(b);
-            break;
-        }
-        case LUA_TSTRING:
-        {
-            const std::string str = lua_tostring(mState, -1);
-            mPrintHandler.value(str);
-            break;
-        }
-        case LUA_TTABLE:
-            handleTable();
-            // the table value must stay on the top of the stack in order to be iterated by
-            // encode loop.  when the end of the table is encountered, it is popped.
-            // returning here avoids the pop that is needed for all other values.
-            return;
-            break;
-        case LUA_TFUNCTION:
-            throw Poco::JSON::JSONException("function type invalid for json.");
-            break;
-        case LUA_TUSERDATA:
-            throw Poco::JSON::JSONException("userdata type invalid for json.");
-            break;
-        case LUA_TTHREAD:
-            throw Poco::JSON::JSONException("thread type invalid for json.");
-            break;
-        case LUA_TLIGHTUSERDATA:
-        {
-            const char *lud = static_cast<const char*>(lua_touserdata(mState, -1));
+            if (lua_type(L, -1) != LUA_TSTRING) { throw Poco::JSON::JSONException("json pointers must be strings."); }
 
-            if (lud == jsonNull) { mPrintHandler.null(); }
-            else if (lud == jsonEmptyArray) { mPrintHandler.startArray(); mPrintHandler.endArray(); }
-            else if (lud == jsonEmptyObject) { mPrintHandler.startObject(); mPrintHandler.endObject(); }
-            else throw Poco::JSON::JSONException("unknown json lightuserdata value.");
-            break;
-        }
-        default:
-            throw Poco::JSON::JSONException("unknown value for json conversion.");
-            break;
+            size_t len = 0;
+            const char* pointer = lua_tolstring(L, -1, &len);
+            jq.addPointer(pointer, len);
+            lua_pop(L, 1);
         }
 
-        // all values except for table needs to be popped.
-        // the table case returns early to avoid this pop.
-        lua_pop(mState, 1);
+        jq.run(3);
+        rv = 1;
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
     }
 
-    lua_State* mState;
-    std::stringstream mStream;
-    Poco::JSON::PrintHandler mPrintHandler;
-    std::vector<TableInfo> mTableQueue;
-};
+    return rv;
+}
 
-/// encodes a table into a JSON string.
-// @tab table to encode
-// @return value as string or nil. (error)
+/// parses a JSON document into a lazy value, creating Lua values only for the parts which are read.
+// The document is parsed once into a compact immutable form, and the returned userdata reads it like a table,
+// via indexing, the length operator, and pairs. (json.pairs for Lua 5.1) Indexing an object or array returns
+// another lazy userdata, other values are returned as by decode. Objects are indexed by string keys, and arrays
+// by integer keys from 1. A document whose top-level value is not an object or array returns the value itself.
+// The input is read as in decode.
+//
+// Note: lazy userdata are sharable between threads. Copying one to another thread shares the parsed document
+// without copying it.
+// @param input JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return userdata or nil. (error)
 // @return error message.
-// @function encode
-int JSON::encode(lua_State* L)
+// @function parseLazy
+// @see materialize
+int JSON::parseLazy(lua_State* L)
 {
     int rv = 0;
-    unsigned indent = 0;
+    DecodeInput input;
 
-    luaL_checktype(L, 1, LUA_TTABLE);
-    if (lua_isnumber(L, 2)) { indent = static_cast<unsigned>(lua_tointeger(L, 2)); }
-    // TableEncoder expects the table it is encoding at the top of the stack.
-    lua_pushvalue(L, 1);
+    if (!getDecodeInput(L, 1, input, true))
+    {
+        return luaL_argerror(L, 1, "expected string, istream, buffer or sharedmemory");
+    }
 
     try
     {
-        TableEncoder te(L, indent);
-        // either a string is returned at the top of the stack
-        // or nil, errmsg
-        if (te.encode()) { rv = 1; }
-        else { rv = 2; }
+        Poco::SharedPtr<JsonTape> tape(new JsonTape());
+        Poco::SharedPtr<JsonReader> reader(input.stream ? new JsonReader(*input.stream) : new JsonReader(input.data, input.size));
+        tape->parse(*reader);
+
+        JsonTape::Type type = tape->type(0);
+        if (type != JsonTape::OBJECT && type != JsonTape::ARRAY) { tape->pushScalar(L, 0); }
+        else if (!JsonLazyUserdata::push(L, tape, 0))
+        {
+            throw Poco::OutOfMemoryException("unable to create lazy json userdata");
+        }
+
+        rv = 1;
     }
     catch (const std::exception& e)
     {
         rv = pushException(L, e);
     }
-    
+
     return rv;
 }
 
-/// decodes a JSON string into a table.
-// @string JSON encoded string
+/// decodes a lazy value fully into a table.
+// The result is the same as decoding the part of the document the lazy value refers to with decode.
+// @param lazy userdata returned by parseLazy, or by indexing one.
 // @return table or nil. (error)
 // @return error message.
-// @function decode
-int JSON::decode(lua_State* L)
+// @function materialize
+// @see parseLazy
+int JSON::materialize(lua_State* L)
 {
     int rv = 0;
-    const char* jss = luaL_checkstring(L, 1);
+    JsonLazyUserdata* jlud = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
 
     try
     {
-        Poco::SharedPtr<JsonDecoder> lh(new JsonDecoder(L));
-        Poco::JSON::Parser jsonParser(lh);
-        jsonParser.parse(jss);
-
+        jlud->mTape->push(L, jlud->mNode);
         rv = 1;
     }
     catch (const std::exception& e)
     {
         rv = pushException(L, e);
     }
-    
+
+    return rv;
+}
+
+/// gets an iterator over a lazy value, for Lua 5.1 where pairs() does not support userdata.
+// Arrays are visited in order, and objects in document order, with duplicate keys visited once with their last value.
+// @param lazy userdata returned by parseLazy, or by indexing one.
+// @return iterator function, lazy userdata, nil.
+// @function pairs
+int JSON::pairs(lua_State* L)
+{
+    return JsonLazyUserdata::pairs(L);
+}
+
+/// returns an iterator over the parsing events of a JSON document.
+// Each iteration returns the name of an event and its value. The events are startObject, endObject, startArray
+// and endArray, which have no value, key and string, with string values, number, boolean, and null, with the null
+// sentinel value as its value. Only the current event is held in memory, so documents of any size can be read.
+// The input is read as in decode, and errors in the document are raised as Lua errors.
+// @param input JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return iterator function.
+// @return userdata.
+// @function events
+int JSON::events(lua_State* L)
+{
+    return JsonEventsUserdata::iterate(L, 1, JsonEventsUserdata::EVENTS);
+}
+
+/// returns an iterator decoding the elements of a top-level JSON array one at a time.
+// Each iteration returns the next element of the array, decoded as by decode. Only the current element is held
+// in memory, so arrays of any size can be processed. The input is read as in decode, and errors in the document,
+// including a document which is not an array, are raised as Lua errors.
+// @param input JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return iterator function.
+// @return userdata.
+// @function elements
+int JSON::elements(lua_State* L)
+{
+    return JsonEventsUserdata::iterate(L, 1, JsonEventsUserdata::ELEMENTS);
+}
+
+/// returns an iterator decoding newline delimited JSON in batches.
+// Each iteration returns an array of up to batchSize decoded records, where each record is a document of
+// the input. Documents are separated by whitespace, normally a newline each. Lines are split and parsed
+// without creating a Lua string per line. The input is read as in decode, and errors in a record are raised
+// as Lua errors, which include the byte offset of the error in the input.
+// @param input newline delimited JSON string, istream userdata, buffer userdata or sharedmemory userdata.
+// @int[opt] batchSize maximum number of records returned by each iteration. (default: 100)
+// @return iterator function.
+// @return userdata.
+// @function ndjsonReader
+int JSON::ndjsonReader(lua_State* L)
+{
+    lua_Integer batchSize = luaL_optinteger(L, 2, 100);
+    luaL_argcheck(L, batchSize > 0, 2, "must be positive");
+    // the input is left on the top of the stack.
+    lua_settop(L, 1);
+
+    return JsonEventsUserdata::iterate(L, 1, JsonEventsUserdata::BATCHES, static_cast<size_t>(batchSize));
+}
+
+/// encodes an array of tables as newline delimited JSON, written to an ostream.
+// Each table is encoded compactly on its own line. All records are encoded into one buffer, which is
+// written to the ostream with a single write.
+// @param ostream ostream userdata.
+// @tab records array of tables to encode.
+// @return true or nil. (error)
+// @return error message.
+// @function ndjsonWrite
+// @see ostream
+int JSON::ndjsonWrite(lua_State* L)
+{
+    int rv = 0;
+    OStream* os = checkPrivateUserdata<OStream>(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    try
+    {
+        JsonWriter writer(0);
+        JsonTableEncoder te(L, writer);
+        te.encodeLines(2);
+
+        std::ostream& out = os->ostream();
+        out.write(writer.data(), static_cast<std::streamsize>(writer.size()));
+
+        if (!out.fail())
+        {
+            lua_pushboolean(L, 1);
+            rv = 1;
+        }
+        else
+        {
+            lua_pushnil(L);
+            lua_pushstring(L, "write failed.");
+            rv = 2;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+
     return rv;
 }
 
@@ -10,11 +10,27 @@ LUAPOCO_API int luaopen_poco_json(lua_State* L);
 
 namespace LuaPoco
 {
+
+// sentinel values, pushed as lightuserdata.
+extern char jsonNull[];
+extern char jsonEmptyArray[];
+extern char jsonEmptyObject[];
+
 namespace JSON
 {
 
 int decode(lua_State* L);
+int decodeMany(lua_State* L);
+int events(lua_State* L);
+int elements(lua_State* L);
+int query(lua_State* L);
+int parseLazy(lua_State* L);
+int materialize(lua_State* L);
+int pairs(lua_State* L);
+int ndjsonReader(lua_State* L);
+int ndjsonWrite(lua_State* L);
 int encode(lua_State* L);
+int encodeTo(lua_State* L);
 int getNull(lua_State* L);
 int getEmptyObject(lua_State* L);
 int getEmptyArray(lua_State* L);
@@ -0,0 +1,132 @@
+#include "JsonBatch.h"
+#include "JsonReader.h"
+#include <Poco/Exception.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/ThreadPool.h>
+
+namespace LuaPoco
+{
+
+JsonBatchDecoder::JsonBatchDecoder(const std::vector<std::pair<const char*, size_t> >& documents) :
+    mNext(0),
+    mWorkers(0),
+    mStopping(false)
+{
+    mDocuments.resize(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        mDocuments[i].data = documents[i].first;
+        mDocuments[i].size = documents[i].second;
+        mDocuments[i].done = false;
+    }
+}
+
+JsonBatchDecoder::~JsonBatchDecoder()
+{
+    finish();
+}
+
+void JsonBatchDecoder::start(int workers)
+{
+    for (int i = 0; i < workers; ++i)
+    {
+        {
+            Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+            ++mWorkers;
+        }
+
+        try
+        {
+            Poco::ThreadPool::defaultPool().start(*this);
+        }
+        catch (...)
+        {
+            // the documents left are parsed by the workers already started and the waiting thread.
+            Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+            --mWorkers;
+            return;
+        }
+    }
+}
+
+bool JsonBatchDecoder::wait(size_t i, Poco::SharedPtr<JsonTape>& tape, std::string& error)
+{
+    for (;;)
+    {
+        {
+            Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+            Document& document = mDocuments[i];
+
+            if (document.done)
+            {
+                // the tape is released by the caller once its values are created.
+                tape = document.tape;
+                document.tape = NULL;
+                error = document.error;
+                return error.empty();
+            }
+
+            if (mNext == mDocuments.size())
+            {
+                mParsed.wait(mMutex);
+                continue;
+            }
+        }
+
+        parseNext();
+    }
+}
+
+void JsonBatchDecoder::finish()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    mStopping = true;
+    while (mWorkers > 0) { mParsed.wait(mMutex); }
+}
+
+void JsonBatchDecoder::run()
+{
+    while (parseNext()) {}
+
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    --mWorkers;
+    mParsed.broadcast();
+}
+
+bool JsonBatchDecoder::parseNext()
+{
+    size_t i = 0;
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+        if (mStopping || mNext == mDocuments.size()) { return false; }
+        i = mNext++;
+    }
+
+    Poco::SharedPtr<JsonTape> tape;
+    std::string error;
+
+    try
+    {
+        tape = new JsonTape();
+        JsonReader reader(mDocuments[i].data, mDocuments[i].size);
+        tape->parse(reader);
+    }
+    catch (const Poco::Exception& e)
+    {
+        error = e.displayText();
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    mDocuments[i].tape = tape;
+    mDocuments[i].error = error;
+    mDocuments[i].done = true;
+    mParsed.broadcast();
+
+    return true;
+}
+
+} // LuaPoco
@@ -0,0 +1,64 @@
+#ifndef LUA_POCO_JSON_BATCH_H
+#define LUA_POCO_JSON_BATCH_H
+
+#include "LuaPoco.h"
+#include "JsonTape.h"
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/SharedPtr.h>
+#include <string>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// parses a set of independent documents into tapes on threads of the default Poco::ThreadPool.
+// documents are claimed in order by the workers and by the thread waiting on them, such that the
+// waiting thread can create the Lua values of each document while later documents are still being parsed.
+class JsonBatchDecoder : public Poco::Runnable
+{
+public:
+    // the memory of each document must remain valid until finish() returns.
+    JsonBatchDecoder(const std::vector<std::pair<const char*, size_t> >& documents);
+    // finishes the workers, as they refer to the documents.
+    virtual ~JsonBatchDecoder();
+
+    // starts up to workers threads from the default pool, fewer if the pool has no more threads available.
+    void start(int workers);
+    // waits until document i is parsed, parsing other documents on the calling thread while there are any left.
+    // returns false with the error message of an invalid document.
+    bool wait(size_t i, Poco::SharedPtr<JsonTape>& tape, std::string& error);
+    // stops the workers after their current documents, and waits for them to return.
+    void finish();
+    // worker loop, executed on pool threads.
+    virtual void run();
+
+private:
+    JsonBatchDecoder(const JsonBatchDecoder&);
+    JsonBatchDecoder& operator=(const JsonBatchDecoder&);
+
+    struct Document
+    {
+        const char* data;
+        size_t size;
+        Poco::SharedPtr<JsonTape> tape;
+        std::string error;
+        bool done;
+    };
+
+    // parses the next unclaimed document, returns false when none are left.
+    bool parseNext();
+
+    std::vector<Document> mDocuments;
+    Poco::FastMutex mMutex;
+    // signalled when a document is parsed, or a worker returns.
+    Poco::Condition mParsed;
+    size_t mNext;
+    int mWorkers;
+    bool mStopping;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LUA_POCO_JSON_COMMON_H
+#define LUA_POCO_JSON_COMMON_H
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LUAPOCO_JSON_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace LuaPoco
+{
+
+#if defined(LUAPOCO_JSON_SSE2)
+inline int jsonFirstSetBit(int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, static_cast<unsigned long>(mask));
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+}
+#endif
+
+// returns the length of the prefix of s free of quotes, backslashes and control characters,
+// which is the part of a string that is the same in and out of JSON text.
+inline size_t jsonPlainPrefix(const char* s, size_t len)
+{
+    size_t i = 0;
+
+#if defined(LUAPOCO_JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        // bytes <= 0x1f are those left unchanged by an unsigned max with 0x1f.
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0) { return i + jsonFirstSetBit(mask); }
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x20 || c == '"' || c == '\\') { break; }
+    }
+
+    return i;
+}
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,181 @@
+#include "JsonDecoder.h"
+#include "JSON.h"
+#include "Userdata.h"
+#include "IStream.h"
+#include "Buffer.h"
+#include "SharedMemory.h"
+#include "LuaPocoUtils.h"
+#include <Poco/JSON/JSONException.h>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+bool getDecodeInput(lua_State* L, int index, DecodeInput& input, bool text)
+{
+    input.data = NULL;
+    input.size = 0;
+    input.stream = NULL;
+    input.region = false;
+
+    if (lua_isstring(L, index))
+    {
+        input.data = lua_tolstring(L, index, &input.size);
+        return true;
+    }
+
+    if (!lua_isuserdata(L, index)) { return false; }
+
+    Userdata* ud = getPrivateUserdata(L, index);
+    BufferUserdata* bud = dynamic_cast<BufferUserdata*>(ud);
+    SharedMemoryUserdata* smud = dynamic_cast<SharedMemoryUserdata*>(ud);
+    IStream* is = dynamic_cast<IStream*>(ud);
+
+    if (bud)
+    {
+        input.data = bud->mBuffer.begin();
+        input.size = bud->mCapacity;
+    }
+    else if (smud)
+    {
+        input.data = smud->mSharedMemory.begin();
+        input.size = smud->mSize;
+    }
+    else if (is)
+    {
+        input.stream = &is->istream();
+        return true;
+    }
+    else { return false; }
+
+    input.region = true;
+    if (!text) { return true; }
+
+    // zero bytes are invalid in JSON text, so the first one ends the document.
+    const void* zero = input.size > 0 ? std::memchr(input.data, '\0', input.size) : NULL;
+    if (zero) { input.size = static_cast<size_t>(static_cast<const char*>(zero) - input.data); }
+
+    return true;
+}
+
+JsonDecoder::JsonDecoder(lua_State* L, JsonReader& reader) :
+    mState(L),
+    mReader(reader)
+{
+}
+
+JsonDecoder::~JsonDecoder()
+{
+}
+
+bool JsonDecoder::decode()
+{
+    return decode(mReader.next());
+}
+
+bool JsonDecoder::decode(JsonReader::Event event)
+{
+    for (;; event = mReader.next())
+    {
+        switch (event)
+        {
+        case JsonReader::END:
+            return false;
+        case JsonReader::START_OBJECT:
+            startTable(false);
+            continue;
+        case JsonReader::START_ARRAY:
+            startTable(true);
+            continue;
+        case JsonReader::END_OBJECT:
+        case JsonReader::END_ARRAY:
+            if (mFrames.empty()) { return false; }
+            flush(mFrames.back());
+            mFrames.pop_back();
+            break;
+        case JsonReader::KEY:
+            lua_pushlstring(mState, mReader.string(), mReader.stringSize());
+            continue;
+        case JsonReader::STRING:
+            lua_pushlstring(mState, mReader.string(), mReader.stringSize());
+            break;
+        case JsonReader::INTEGER:
+            pushInteger(mState, mReader.integer());
+            break;
+        case JsonReader::NUMBER:
+            lua_pushnumber(mState, static_cast<lua_Number>(mReader.number()));
+            break;
+        case JsonReader::BOOLEAN:
+            lua_pushboolean(mState, static_cast<int>(mReader.boolean()));
+            break;
+        case JsonReader::NUL:
+            // use sentinel value jsonNull
+            lua_pushlightuserdata(mState, static_cast<void*>(jsonNull));
+            break;
+        }
+
+        // a value is complete.
+        if (mFrames.empty()) { return true; }
+
+        Frame& frame = mFrames.back();
+        if (lua_gettop(mState) - frame.first + 1 >= FLUSH_SLOTS) { flush(frame); }
+    }
+}
+
+void JsonDecoder::startTable(bool array)
+{
+    // room for the values waiting to be flushed, and the table and key of the next nested table.
+    if (!lua_checkstack(mState, FLUSH_SLOTS + 4))
+    {
+        throw Poco::JSON::JSONException("json nesting is too deep.");
+    }
+
+    Frame frame = { array, 0, lua_gettop(mState) + 1, 0 };
+    mFrames.push_back(frame);
+}
+
+// sets the waiting values in the table, creating it first if need be, leaving the table on the top of the stack.
+void JsonDecoder::flush(Frame& frame)
+{
+    int waiting = lua_gettop(mState) - frame.first + 1;
+
+    if (frame.table == 0)
+    {
+        if (frame.array) { lua_createtable(mState, waiting, 0); }
+        else { lua_createtable(mState, 0, waiting / 2); }
+
+        lua_insert(mState, frame.first);
+        frame.table = frame.first++;
+    }
+
+    if (frame.array)
+    {
+        for (int i = 0; i < waiting; ++i)
+        {
+            lua_pushvalue(mState, frame.first + i);
+            lua_rawseti(mState, frame.table, static_cast<int>(++frame.count));
+        }
+    }
+    else
+    {
+        // set in document order, such that the last of duplicate keys wins.
+        for (int i = 0; i < waiting; i += 2)
+        {
+            lua_pushvalue(mState, frame.first + i);
+            lua_pushvalue(mState, frame.first + i + 1);
+            lua_rawset(mState, frame.table);
+        }
+    }
+
+    lua_settop(mState, frame.table);
+}
+
+void decodeDocument(lua_State* L, JsonReader& reader)
+{
+    JsonDecoder jd(L, reader);
+    jd.decode();
+    // ensures nothing follows the document.
+    reader.next();
+}
+
+} // LuaPoco
@@ -0,0 +1,76 @@
+#ifndef LUA_POCO_JSON_DECODER_H
+#define LUA_POCO_JSON_DECODER_H
+
+#include "LuaPoco.h"
+#include "JsonReader.h"
+#include <istream>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// input of the json and binary decoding functions, either memory parsed in place or a stream.
+struct DecodeInput
+{
+    const char* data;
+    size_t size;
+    std::istream* stream;
+    // the memory of a buffer or sharedmemory, which may hold more than the value.
+    bool region;
+};
+
+// reads a string, buffer userdata, sharedmemory userdata or istream userdata at index into input.
+// strings are accepted as by luaL_checkstring, so numbers are read as their string form.
+// when text is true, the first zero byte of a buffer or sharedmemory ends the input.
+// returns false if the value at index is none of them.
+bool getDecodeInput(lua_State* L, int index, DecodeInput& input, bool text);
+
+// builds Lua values from the events of a JsonReader.
+// the values of an object or array are collected on the stack, such that the table can be created
+// with its final size. large tables are flushed to the table in blocks, which bounds the stack use.
+class JsonDecoder
+{
+public:
+    JsonDecoder(lua_State* L, JsonReader& reader);
+    ~JsonDecoder();
+
+    // reads one complete value onto the top of the stack.
+    // returns false if the reader has no value left, either at the end of the document,
+    // or at the end of an enclosing object or array opened before the call.
+    bool decode();
+    // as decode(), for a value whose first event has already been read from the reader.
+    bool decode(JsonReader::Event event);
+    // sets the state values are decoded onto, for a decoder reused across calls from different coroutines.
+    void setState(lua_State* L) { mState = L; }
+
+private:
+    JsonDecoder(const JsonDecoder&);
+    JsonDecoder& operator=(const JsonDecoder&);
+
+    enum { FLUSH_SLOTS = 64 };
+
+    struct Frame
+    {
+        bool array;
+        // stack index of the table, 0 until the table is created.
+        int table;
+        // stack index of the first value waiting to be set in the table.
+        int first;
+        // values set in the array so far.
+        size_t count;
+    };
+
+    void startTable(bool array);
+    void flush(Frame& frame);
+
+    lua_State* mState;
+    JsonReader& mReader;
+    std::vector<Frame> mFrames;
+};
+
+// decodes a complete document onto the top of the stack, throws if anything follows it.
+void decodeDocument(lua_State* L, JsonReader& reader);
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,255 @@
+#include "JsonEvents.h"
+#include "JSON.h"
+#include "LuaPocoUtils.h"
+#include <Poco/JSON/JSONException.h>
+
+namespace LuaPoco
+{
+
+const char* POCO_JSONEVENTS_METATABLE_NAME = "Poco.JSON.Events.metatable";
+
+JsonEventsUserdata::JsonEventsUserdata(const DecodeInput& input, Mode mode, size_t batchSize) :
+    mReader(input.stream ? new JsonReader(*input.stream) : new JsonReader(input.data, input.size)),
+    mDecoder(new JsonDecoder(NULL, *mReader)),
+    mBatchSize(batchSize),
+    mStarted(false),
+    mDone(false),
+    mInputReference(LUA_NOREF)
+{
+    mReader->setMultipleDocuments(mode == BATCHES);
+}
+
+JsonEventsUserdata::~JsonEventsUserdata()
+{
+}
+
+// register metatable for this class
+bool JsonEventsUserdata::registerJsonEvents(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_JSONEVENTS_METATABLE_NAME, methods);
+    return true;
+}
+
+int JsonEventsUserdata::iterate(lua_State* L, int index, Mode mode, size_t batchSize)
+{
+    DecodeInput input;
+
+    if (!getDecodeInput(L, index, input, true))
+    {
+        return luaL_argerror(L, index, "expected string, istream, buffer or sharedmemory");
+    }
+
+    if (mode == EVENTS) { lua_pushcfunction(L, eventIterator); }
+    else if (mode == ELEMENTS) { lua_pushcfunction(L, elementIterator); }
+    else { lua_pushcfunction(L, batchIterator); }
+
+    JsonEventsUserdata* jeud = NULL;
+    void* p = lua_newuserdata(L, sizeof *jeud);
+
+    try
+    {
+        jeud = new(p) JsonEventsUserdata(input, mode, batchSize);
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    lua_pushvalue(L, index);
+    jeud->mInputReference = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    setupPocoUserdata(L, jeud, POCO_JSONEVENTS_METATABLE_NAME);
+    lua_pushnil(L);
+
+    return 3;
+}
+
+int JsonEventsUserdata::metamethod__gc(lua_State* L)
+{
+    JsonEventsUserdata* jeud = checkPrivateUserdata<JsonEventsUserdata>(L, 1);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, jeud->mInputReference);
+    jeud->~JsonEventsUserdata();
+
+    return 0;
+}
+
+int JsonEventsUserdata::metamethod__tostring(lua_State* L)
+{
+    JsonEventsUserdata* jeud = checkPrivateUserdata<JsonEventsUserdata>(L, 1);
+    lua_pushfstring(L, "Poco.JSON.Events (%p)", static_cast<void*>(jeud));
+
+    return 1;
+}
+
+int JsonEventsUserdata::eventIterator(lua_State* L)
+{
+    int rv = 0;
+    bool failed = false;
+    JsonEventsUserdata* jeud = checkPrivateUserdata<JsonEventsUserdata>(L, 1);
+    if (jeud->mDone) { return 0; }
+
+    try
+    {
+        JsonReader& reader = *jeud->mReader;
+
+        switch (reader.next())
+        {
+        case JsonReader::END:
+            jeud->mDone = true;
+            break;
+        case JsonReader::START_OBJECT:
+            lua_pushstring(L, "startObject");
+            rv = 1;
+            break;
+        case JsonReader::END_OBJECT:
+            lua_pushstring(L, "endObject");
+            rv = 1;
+            break;
+        case JsonReader::START_ARRAY:
+            lua_pushstring(L, "startArray");
+            rv = 1;
+            break;
+        case JsonReader::END_ARRAY:
+            lua_pushstring(L, "endArray");
+            rv = 1;
+            break;
+        case JsonReader::KEY:
+            lua_pushstring(L, "key");
+            lua_pushlstring(L, reader.string(), reader.stringSize());
+            rv = 2;
+            break;
+        case JsonReader::STRING:
+            lua_pushstring(L, "string");
+            lua_pushlstring(L, reader.string(), reader.stringSize());
+            rv = 2;
+            break;
+        case JsonReader::INTEGER:
+            lua_pushstring(L, "number");
+            pushInteger(L, reader.integer());
+            rv = 2;
+            break;
+        case JsonReader::NUMBER:
+            lua_pushstring(L, "number");
+            lua_pushnumber(L, static_cast<lua_Number>(reader.number()));
+            rv = 2;
+            break;
+        case JsonReader::BOOLEAN:
+            lua_pushstring(L, "boolean");
+            lua_pushboolean(L, static_cast<int>(reader.boolean()));
+            rv = 2;
+            break;
+        case JsonReader::NUL:
+            lua_pushstring(L, "null");
+            lua_pushlightuserdata(L, static_cast<void*>(jsonNull));
+            rv = 2;
+            break;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        jeud->mDone = true;
+        pushException(L, e);
+        failed = true;
+    }
+
+    // an error ends a for loop silently if returned, so it is raised instead.
+    if (failed) { return lua_error(L); }
+
+    return rv;
+}
+
+int JsonEventsUserdata::elementIterator(lua_State* L)
+{
+    int rv = 0;
+    bool failed = false;
+    JsonEventsUserdata* jeud = checkPrivateUserdata<JsonEventsUserdata>(L, 1);
+    if (jeud->mDone) { return 0; }
+
+    try
+    {
+        JsonReader& reader = *jeud->mReader;
+
+        if (!jeud->mStarted)
+        {
+            jeud->mStarted = true;
+            if (reader.next() != JsonReader::START_ARRAY)
+            {
+                throw Poco::JSON::JSONException("expected a top-level array.");
+            }
+        }
+
+        JsonDecoder& jd = *jeud->mDecoder;
+        jd.setState(L);
+        if (jd.decode()) { rv = 1; }
+        else
+        {
+            // the array is closed, ensures nothing follows the document.
+            reader.next();
+            jeud->mDone = true;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        jeud->mDone = true;
+        pushException(L, e);
+        failed = true;
+    }
+
+    if (failed) { return lua_error(L); }
+
+    return rv;
+}
+
+int JsonEventsUserdata::batchIterator(lua_State* L)
+{
+    int rv = 0;
+    bool failed = false;
+    JsonEventsUserdata* jeud = checkPrivateUserdata<JsonEventsUserdata>(L, 1);
+    if (jeud->mDone) { return 0; }
+
+    // the batch table is presized up to a bound, as the final batch may be short.
+    const size_t presize = jeud->mBatchSize < 1024 ? jeud->mBatchSize : 1024;
+    lua_createtable(L, static_cast<int>(presize), 0);
+    int batch = lua_gettop(L);
+
+    try
+    {
+        JsonDecoder& jd = *jeud->mDecoder;
+        jd.setState(L);
+        size_t count = 0;
+
+        while (count < jeud->mBatchSize)
+        {
+            if (!jd.decode())
+            {
+                jeud->mDone = true;
+                break;
+            }
+
+            lua_rawseti(L, batch, static_cast<int>(++count));
+        }
+
+        // no empty batch is returned, which ends the iteration.
+        if (count > 0) { rv = 1; }
+    }
+    catch (const std::exception& e)
+    {
+        jeud->mDone = true;
+        pushException(L, e);
+        failed = true;
+    }
+
+    if (failed) { return lua_error(L); }
+
+    return rv;
+}
+
+} // LuaPoco
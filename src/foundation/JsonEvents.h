@@ -0,0 +1,60 @@
+#ifndef LUA_POCO_JSON_EVENTS_H
+#define LUA_POCO_JSON_EVENTS_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include "JsonDecoder.h"
+#include "JsonReader.h"
+#include <Poco/SharedPtr.h>
+
+namespace LuaPoco
+{
+
+extern const char* POCO_JSONEVENTS_METATABLE_NAME;
+
+// iteration state of json.events(), json.elements() and json.ndjsonReader(), which read input a piece at a time.
+class JsonEventsUserdata : public Userdata
+{
+public:
+    enum Mode
+    {
+        // parsing events of a document.
+        EVENTS,
+        // decoded elements of a top-level array.
+        ELEMENTS,
+        // arrays of up to batchSize decoded documents, from a sequence of documents.
+        BATCHES
+    };
+
+    JsonEventsUserdata(const DecodeInput& input, Mode mode, size_t batchSize);
+    virtual ~JsonEventsUserdata();
+    // register metatable for this class
+    static bool registerJsonEvents(lua_State* L);
+    // pushes an iterator function, its state userdata and nil, for a generic for loop over the input at index.
+    // the userdata holds a reference to the input to prevent it being collected during the iteration.
+    static int iterate(lua_State* L, int index, Mode mode, size_t batchSize = 0);
+
+private:
+    // metamethod infrastructure
+    static int metamethod__gc(lua_State* L);
+    static int metamethod__tostring(lua_State* L);
+
+    // iterator functions
+    static int eventIterator(lua_State* L);
+    static int elementIterator(lua_State* L);
+    static int batchIterator(lua_State* L);
+
+    Poco::SharedPtr<JsonReader> mReader;
+    // reused by elementIterator and batchIterator, such that its frames are only allocated once.
+    Poco::SharedPtr<JsonDecoder> mDecoder;
+    size_t mBatchSize;
+    // the top-level array has been opened by elementIterator.
+    bool mStarted;
+    // the document is complete, or an error was raised.
+    bool mDone;
+    int mInputReference;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,221 @@
+#include "JsonLazy.h"
+#include "LuaPocoUtils.h"
+
+namespace LuaPoco
+{
+
+const char* POCO_JSON_LAZY_METATABLE_NAME = "Poco.JSON.Lazy.metatable";
+
+namespace
+{
+
+// gets the array position of a numeric key between 1 and count.
+bool toPosition(lua_State* L, int index, Poco::UInt32 count, Poco::UInt32& position)
+{
+    if (lua_type(L, index) != LUA_TNUMBER) { return false; }
+
+    lua_Number n = lua_tonumber(L, index);
+    if (n < 1 || n > static_cast<lua_Number>(count) || n != static_cast<lua_Number>(static_cast<Poco::UInt32>(n)))
+    {
+        return false;
+    }
+
+    position = static_cast<Poco::UInt32>(n) - 1;
+    return true;
+}
+
+}
+
+JsonLazyUserdata::JsonLazyUserdata(const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node) :
+    mTape(tape),
+    mNode(node)
+{
+}
+
+JsonLazyUserdata::~JsonLazyUserdata()
+{
+}
+
+bool JsonLazyUserdata::copyToState(lua_State *L)
+{
+    registerJsonLazy(L);
+    return push(L, mTape, mNode);
+}
+
+bool JsonLazyUserdata::push(lua_State* L, const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node)
+{
+    JsonLazyUserdata* jlud = NULL;
+    void* p = lua_newuserdata(L, sizeof *jlud);
+
+    try
+    {
+        jlud = new(p) JsonLazyUserdata(tape, node);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, jlud, POCO_JSON_LAZY_METATABLE_NAME);
+    return true;
+}
+
+void JsonLazyUserdata::pushValue(lua_State* L, const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node)
+{
+    JsonTape::Type type = tape->type(node);
+
+    if (type != JsonTape::OBJECT && type != JsonTape::ARRAY) { tape->pushScalar(L, node); }
+    else if (!push(L, tape, node)) { luaL_error(L, "unable to create lazy json userdata."); }
+}
+
+// register metatable for this class
+bool JsonLazyUserdata::registerJsonLazy(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "__newindex", metamethod__newindex },
+        { "__len", metamethod__len },
+        { "__eq", metamethod__eq },
+        { "__pairs", pairs },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_JSON_LAZY_METATABLE_NAME, methods);
+    // fields are looked up in the tape rather than the metatable.
+    luaL_getmetatable(L, POCO_JSON_LAZY_METATABLE_NAME);
+    lua_pushcfunction(L, metamethod__index);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    return true;
+}
+
+int JsonLazyUserdata::pairs(lua_State* L)
+{
+    checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    lua_pushcfunction(L, next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+// arrays are visited in order, and object members in document order, skipping members
+// replaced by a later duplicate key.
+int JsonLazyUserdata::next(lua_State* L)
+{
+    JsonLazyUserdata* jlud = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    lua_settop(L, 2);
+
+    const JsonTape& tape = *jlud->mTape;
+    Poco::UInt32 count = tape.count(jlud->mNode);
+    Poco::UInt32 position = 0;
+
+    if (tape.type(jlud->mNode) == JsonTape::ARRAY)
+    {
+        if (!lua_isnil(L, 2))
+        {
+            if (!toPosition(L, 2, count, position)) { return luaL_error(L, "invalid key to 'next'"); }
+            ++position;
+        }
+
+        if (position < count)
+        {
+            pushInteger(L, static_cast<Poco::Int64>(position + 1));
+            pushValue(L, jlud->mTape, tape.child(jlud->mNode, position));
+            return 2;
+        }
+    }
+    else
+    {
+        if (!lua_isnil(L, 2))
+        {
+            size_t len = 0;
+            const char* key = lua_type(L, 2) == LUA_TSTRING ? lua_tolstring(L, 2, &len) : NULL;
+            if (!key || !tape.find(jlud->mNode, key, len, position)) { return luaL_error(L, "invalid key to 'next'"); }
+            ++position;
+        }
+
+        for (; position < count; ++position)
+        {
+            Poco::UInt32 keyNode = tape.child(jlud->mNode, position);
+            size_t len = 0;
+            const char* key = tape.string(keyNode, len);
+            Poco::UInt32 found = 0;
+
+            if (tape.find(jlud->mNode, key, len, found) && found == position)
+            {
+                lua_pushlstring(L, key, len);
+                pushValue(L, jlud->mTape, keyNode + 1);
+                return 2;
+            }
+        }
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+// metamethod infrastructure
+int JsonLazyUserdata::metamethod__tostring(lua_State* L)
+{
+    JsonLazyUserdata* jlud = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    lua_pushfstring(L, "Poco.JSON.Lazy (%p)", static_cast<void*>(jlud));
+    return 1;
+}
+
+// objects are indexed by string keys, and arrays by integer keys from 1.
+int JsonLazyUserdata::metamethod__index(lua_State* L)
+{
+    JsonLazyUserdata* jlud = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    const JsonTape& tape = *jlud->mTape;
+    Poco::UInt32 position = 0;
+
+    if (tape.type(jlud->mNode) == JsonTape::ARRAY)
+    {
+        if (toPosition(L, 2, tape.count(jlud->mNode), position))
+        {
+            pushValue(L, jlud->mTape, tape.child(jlud->mNode, position));
+            return 1;
+        }
+    }
+    else if (lua_type(L, 2) == LUA_TSTRING)
+    {
+        size_t len = 0;
+        const char* key = lua_tolstring(L, 2, &len);
+        if (tape.find(jlud->mNode, key, len, position))
+        {
+            pushValue(L, jlud->mTape, tape.child(jlud->mNode, position) + 1);
+            return 1;
+        }
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+int JsonLazyUserdata::metamethod__newindex(lua_State* L)
+{
+    return luaL_error(L, "attempt to modify a lazy json value.");
+}
+
+// the number of elements of an array, objects have no array part.
+int JsonLazyUserdata::metamethod__len(lua_State* L)
+{
+    JsonLazyUserdata* jlud = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    Poco::UInt32 count = jlud->mTape->type(jlud->mNode) == JsonTape::ARRAY ? jlud->mTape->count(jlud->mNode) : 0;
+    pushInteger(L, static_cast<Poco::Int64>(count));
+    return 1;
+}
+
+int JsonLazyUserdata::metamethod__eq(lua_State* L)
+{
+    JsonLazyUserdata* a = checkPrivateUserdata<JsonLazyUserdata>(L, 1);
+    JsonLazyUserdata* b = checkPrivateUserdata<JsonLazyUserdata>(L, 2);
+    lua_pushboolean(L, a->mTape.get() == b->mTape.get() && a->mNode == b->mNode);
+    return 1;
+}
+
+} // LuaPoco
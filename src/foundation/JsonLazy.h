@@ -0,0 +1,45 @@
+#ifndef LUA_POCO_JSON_LAZY_H
+#define LUA_POCO_JSON_LAZY_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include "JsonTape.h"
+#include <Poco/SharedPtr.h>
+
+namespace LuaPoco
+{
+
+extern const char* POCO_JSON_LAZY_METATABLE_NAME;
+
+// an object or array of a parsed document, whose values are only created when they are read.
+class JsonLazyUserdata : public Userdata
+{
+public:
+    JsonLazyUserdata(const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node);
+    virtual ~JsonLazyUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerJsonLazy(lua_State* L);
+    // pushes a new userdata for an object or array node of tape.
+    static bool push(lua_State* L, const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node);
+    // pushes the value of a node, a new userdata for an object or array, and a Lua value otherwise.
+    static void pushValue(lua_State* L, const Poco::SharedPtr<JsonTape>& tape, Poco::UInt32 node);
+    // module functions
+    static int pairs(lua_State* L);
+
+    Poco::SharedPtr<JsonTape> mTape;
+    Poco::UInt32 mNode;
+
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+    static int metamethod__index(lua_State* L);
+    static int metamethod__newindex(lua_State* L);
+    static int metamethod__len(lua_State* L);
+    static int metamethod__eq(lua_State* L);
+    static int next(lua_State* L);
+};
+
+} // LuaPoco
+
+#endif
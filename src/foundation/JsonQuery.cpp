@@ -0,0 +1,225 @@
+#include "JsonQuery.h"
+#include "JsonDecoder.h"
+#include <Poco/JSON/JSONException.h>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+// the array index a pointer token refers to, or -1 if it is not a valid index.
+Poco::Int64 arrayIndex(const std::string& token)
+{
+    if (token.empty() || token.size() > 18) { return -1; }
+    if (token.size() > 1 && token[0] == '0') { return -1; }
+
+    Poco::Int64 index = 0;
+    for (size_t i = 0; i < token.size(); ++i)
+    {
+        if (token[i] < '0' || token[i] > '9') { return -1; }
+        index = index * 10 + (token[i] - '0');
+    }
+
+    return index;
+}
+
+}
+
+JsonQuery::JsonQuery(lua_State* L, JsonReader& reader) :
+    mState(L),
+    mReader(reader),
+    mResultIndex(0),
+    mRemaining(0)
+{
+}
+
+JsonQuery::~JsonQuery()
+{
+}
+
+void JsonQuery::addPointer(const char* pointer, size_t len)
+{
+    Pointer p;
+    p.text.assign(pointer, len);
+    p.resolved = false;
+
+    // the empty pointer refers to the whole document.
+    if (len > 0)
+    {
+        if (pointer[0] != '/') { throw Poco::JSON::JSONException("invalid json pointer: " + p.text); }
+
+        std::string token;
+        for (size_t i = 1; i <= len; ++i)
+        {
+            if (i == len || pointer[i] == '/')
+            {
+                p.tokens.push_back(token);
+                p.indexes.push_back(arrayIndex(token));
+                token.clear();
+            }
+            else if (pointer[i] == '~')
+            {
+                // ~0 and ~1 are the escapes of '~' and '/'.
+                if (i + 1 < len && pointer[i + 1] == '0') { token.push_back('~'); }
+                else if (i + 1 < len && pointer[i + 1] == '1') { token.push_back('/'); }
+                else { throw Poco::JSON::JSONException("invalid json pointer: " + p.text); }
+                ++i;
+            }
+            else { token.push_back(pointer[i]); }
+        }
+    }
+
+    mPointers.push_back(p);
+    ++mRemaining;
+}
+
+void JsonQuery::run(int resultIndex)
+{
+    mResultIndex = resultIndex < 0 ? lua_gettop(mState) + 1 + resultIndex : resultIndex;
+    if (mRemaining == 0) { return; }
+
+    std::vector<size_t> active;
+    for (size_t i = 0; i < mPointers.size(); ++i) { active.push_back(i); }
+
+    handleValue(mReader.next(), 0, active);
+
+    // the rest of the document is not read once every pointer is resolved.
+    while (!mFrames.empty() && mRemaining > 0)
+    {
+        JsonReader::Event event = mReader.next();
+        if (event == JsonReader::END_OBJECT || event == JsonReader::END_ARRAY)
+        {
+            // pointers into this object or array which were not found are absent from the document.
+            const Frame& frame = mFrames.back();
+            for (size_t i = 0; i < frame.active.size(); ++i)
+            {
+                Pointer& p = mPointers[frame.active[i]];
+                if (!p.resolved)
+                {
+                    p.resolved = true;
+                    --mRemaining;
+                }
+            }
+
+            mFrames.pop_back();
+            continue;
+        }
+
+        Frame& frame = mFrames.back();
+        size_t depth = mFrames.size() - 1;
+        active.clear();
+
+        if (frame.array)
+        {
+            Poco::Int64 index = static_cast<Poco::Int64>(frame.index++);
+            for (size_t i = 0; i < frame.active.size(); ++i)
+            {
+                const Pointer& p = mPointers[frame.active[i]];
+                if (p.indexes[depth] == index) { active.push_back(frame.active[i]); }
+            }
+        }
+        else
+        {
+            const char* key = mReader.string();
+            size_t keySize = mReader.stringSize();
+            for (size_t i = 0; i < frame.active.size(); ++i)
+            {
+                const std::string& token = mPointers[frame.active[i]].tokens[depth];
+                if (token.size() == keySize && std::memcmp(token.data(), key, keySize) == 0)
+                {
+                    active.push_back(frame.active[i]);
+                }
+            }
+            event = mReader.next();
+        }
+
+        handleValue(event, depth + 1, active);
+    }
+}
+
+void JsonQuery::handleValue(JsonReader::Event event, size_t depth, const std::vector<size_t>& active)
+{
+    bool matched = false;
+    std::vector<size_t> descend;
+
+    for (size_t i = 0; i < active.size(); ++i)
+    {
+        const Pointer& p = mPointers[active[i]];
+        if (p.resolved) { continue; }
+
+        if (p.tokens.size() == depth) { matched = true; }
+        else { descend.push_back(active[i]); }
+    }
+
+    bool container = event == JsonReader::START_OBJECT || event == JsonReader::START_ARRAY;
+
+    if (matched)
+    {
+        // the value is decoded once, and the pointers below it are resolved from the decoded tables.
+        JsonDecoder jd(mState, mReader);
+        jd.decode(event);
+
+        for (size_t i = 0; i < active.size(); ++i)
+        {
+            Pointer& p = mPointers[active[i]];
+            if (!p.resolved) { setResult(p, depth); }
+        }
+
+        lua_pop(mState, 1);
+    }
+    else if (container && !descend.empty())
+    {
+        Frame frame = { event == JsonReader::START_ARRAY, 0, descend };
+        mFrames.push_back(frame);
+    }
+    else if (container) { skip(); }
+}
+
+void JsonQuery::setResult(Pointer& pointer, size_t depth)
+{
+    // the pointer is resolved whether or not the value exists, as no other part of the document can hold it.
+    pointer.resolved = true;
+    --mRemaining;
+
+    lua_pushvalue(mState, -1);
+
+    for (size_t i = depth; i < pointer.tokens.size(); ++i)
+    {
+        if (!lua_istable(mState, -1))
+        {
+            lua_pop(mState, 1);
+            return;
+        }
+
+        // decoded objects only have string keys, and decoded arrays only integer keys.
+        const std::string& token = pointer.tokens[i];
+        lua_pushlstring(mState, token.data(), token.size());
+        lua_rawget(mState, -2);
+        if (lua_isnil(mState, -1) && pointer.indexes[i] >= 0 && pointer.indexes[i] < 0x7fffffff)
+        {
+            lua_pop(mState, 1);
+            lua_rawgeti(mState, -1, static_cast<int>(pointer.indexes[i] + 1));
+        }
+        lua_remove(mState, -2);
+    }
+
+    if (lua_isnil(mState, -1))
+    {
+        lua_pop(mState, 1);
+        return;
+    }
+
+    lua_pushlstring(mState, pointer.text.data(), pointer.text.size());
+    lua_insert(mState, -2);
+    lua_rawset(mState, mResultIndex);
+}
+
+void JsonQuery::skip()
+{
+    size_t depth = mReader.depth();
+    while (mReader.depth() >= depth) { mReader.next(); }
+}
+
+} // LuaPoco
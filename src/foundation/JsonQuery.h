@@ -0,0 +1,65 @@
+#ifndef LUA_POCO_JSON_QUERY_H
+#define LUA_POCO_JSON_QUERY_H
+
+#include "LuaPoco.h"
+#include "JsonReader.h"
+#include <string>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// finds the values at a set of JSON pointers (RFC 6901) in a document.
+// only the values found are decoded, other parts of the document are skipped without creating Lua values.
+class JsonQuery
+{
+public:
+    JsonQuery(lua_State* L, JsonReader& reader);
+    ~JsonQuery();
+
+    // adds a pointer to find, throws for an invalid pointer.
+    void addPointer(const char* pointer, size_t len);
+    // reads the document until every pointer is found or the document ends, setting each value found
+    // in the table at resultIndex, keyed by its pointer.
+    void run(int resultIndex);
+
+private:
+    JsonQuery(const JsonQuery&);
+    JsonQuery& operator=(const JsonQuery&);
+
+    struct Pointer
+    {
+        std::string text;
+        std::vector<std::string> tokens;
+        // the array index of each token, or -1 for tokens which are not array indexes.
+        std::vector<Poco::Int64> indexes;
+        // the value was found, or shown to be absent.
+        bool resolved;
+    };
+
+    struct Frame
+    {
+        bool array;
+        size_t index;
+        // pointers whose tokens match the path to this object or array.
+        std::vector<size_t> active;
+    };
+
+    // handles the value starting with event at depth, given the pointers matching the path to it.
+    void handleValue(JsonReader::Event event, size_t depth, const std::vector<size_t>& active);
+    // sets the value on the top of the stack as the result of pointer, walking the rest of its tokens from depth.
+    void setResult(Pointer& pointer, size_t depth);
+    // reads past the rest of the object or array just started.
+    void skip();
+
+    lua_State* mState;
+    JsonReader& mReader;
+    std::vector<Pointer> mPointers;
+    std::vector<Frame> mFrames;
+    int mResultIndex;
+    size_t mRemaining;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,612 @@
+#include "JsonReader.h"
+#include "JsonCommon.h"
+#include <Poco/JSON/JSONException.h>
+#include <Poco/NumberFormatter.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+// powers of ten which are exactly representable as doubles.
+const double exactPowers[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const size_t STREAM_BUFFER_SIZE = 64 * 1024;
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    return -1;
+}
+
+}
+
+JsonReader::JsonReader(const char* data, size_t size) :
+    mBegin(data),
+    mPos(data),
+    mEnd(data + size),
+    mStream(NULL),
+    mDiscarded(0),
+    mState(VALUE),
+    mMultiple(false),
+    mEmpty(false),
+    mString(NULL),
+    mStringSize(0),
+    mIntegral(false),
+    mInteger(0),
+    mNumber(0),
+    mBoolean(false)
+{
+}
+
+JsonReader::JsonReader(std::istream& stream) :
+    mBegin(NULL),
+    mPos(NULL),
+    mEnd(NULL),
+    mStream(&stream),
+    mBuffer(STREAM_BUFFER_SIZE),
+    mDiscarded(0),
+    mState(VALUE),
+    mMultiple(false),
+    mEmpty(false),
+    mString(NULL),
+    mStringSize(0),
+    mIntegral(false),
+    mInteger(0),
+    mNumber(0),
+    mBoolean(false)
+{
+    mBegin = mPos = mEnd = &mBuffer[0];
+}
+
+JsonReader::~JsonReader()
+{
+}
+
+JsonReader::Event JsonReader::next()
+{
+    for (;;)
+    {
+        int c = peek();
+
+        switch (mState)
+        {
+        case AFTER_VALUE:
+            if (mStack.empty())
+            {
+                if (c == -1) { return END; }
+                if (mMultiple)
+                {
+                    mState = VALUE;
+                    continue;
+                }
+                fail("unexpected character after the document", mPos);
+            }
+            if (c == ',')
+            {
+                ++mPos;
+                mState = mStack.back() == 'o' ? KEY_OR_END : VALUE;
+                mEmpty = false;
+                continue;
+            }
+            if (mStack.back() == 'o')
+            {
+                if (c == '}')
+                {
+                    ++mPos;
+                    mStack.pop_back();
+                    return END_OBJECT;
+                }
+                fail(c == -1 ? "unexpected end of document" : "expected ',' or '}'", mPos);
+            }
+            if (c == ']')
+            {
+                ++mPos;
+                mStack.pop_back();
+                return END_ARRAY;
+            }
+            fail(c == -1 ? "unexpected end of document" : "expected ',' or ']'", mPos);
+            break;
+
+        case KEY_OR_END:
+            if (c == '"')
+            {
+                if (mStream) { bufferString(); }
+                readString();
+                mState = COLON;
+                return KEY;
+            }
+            if (c == '}' && mEmpty)
+            {
+                ++mPos;
+                mStack.pop_back();
+                mState = AFTER_VALUE;
+                return END_OBJECT;
+            }
+            fail(c == -1 ? "unexpected end of document" : "expected a string key", mPos);
+            break;
+
+        case COLON:
+            if (c != ':') { fail(c == -1 ? "unexpected end of document" : "expected ':'", mPos); }
+            ++mPos;
+            mState = VALUE;
+            mEmpty = false;
+            continue;
+
+        case VALUE:
+            mState = AFTER_VALUE;
+
+            switch (c)
+            {
+            case '{':
+                ++mPos;
+                mStack.push_back('o');
+                mState = KEY_OR_END;
+                mEmpty = true;
+                return START_OBJECT;
+            case '[':
+                ++mPos;
+                mStack.push_back('a');
+                mState = VALUE;
+                mEmpty = true;
+                return START_ARRAY;
+            case ']':
+                if (mEmpty && !mStack.empty() && mStack.back() == 'a')
+                {
+                    ++mPos;
+                    mStack.pop_back();
+                    return END_ARRAY;
+                }
+                fail("expected a value", mPos);
+                break;
+            case '"':
+                if (mStream) { bufferString(); }
+                readString();
+                return STRING;
+            case 't':
+                if (mStream) { bufferLiteral(); }
+                readLiteral("true", 4);
+                mBoolean = true;
+                return BOOLEAN;
+            case 'f':
+                if (mStream) { bufferLiteral(); }
+                readLiteral("false", 5);
+                mBoolean = false;
+                return BOOLEAN;
+            case 'n':
+                if (mStream) { bufferLiteral(); }
+                readLiteral("null", 4);
+                return NUL;
+            case -1:
+                // an empty sequence of documents.
+                if (mMultiple && mStack.empty()) { return END; }
+                fail("unexpected end of document", mPos);
+                break;
+            default:
+                if (c == '-' || isDigit(static_cast<char>(c)))
+                {
+                    if (mStream) { bufferNumber(); }
+                    readNumber();
+                    return mIntegral ? INTEGER : NUMBER;
+                }
+                fail("expected a value", mPos);
+                break;
+            }
+        }
+    }
+}
+
+void JsonReader::setMultipleDocuments(bool multiple)
+{
+    mMultiple = multiple;
+}
+
+const char* JsonReader::string() const
+{
+    return mString;
+}
+
+size_t JsonReader::stringSize() const
+{
+    return mStringSize;
+}
+
+Poco::Int64 JsonReader::integer() const
+{
+    return mInteger;
+}
+
+double JsonReader::number() const
+{
+    return mNumber;
+}
+
+bool JsonReader::boolean() const
+{
+    return mBoolean;
+}
+
+size_t JsonReader::depth() const
+{
+    return mStack.size();
+}
+
+Poco::UInt64 JsonReader::offset() const
+{
+    return mDiscarded + static_cast<Poco::UInt64>(mPos - mBegin);
+}
+
+int JsonReader::peek()
+{
+    if (mPos == mEnd && mStream) { refill(); }
+
+    while (mPos < mEnd && isSpace(*mPos))
+    {
+#if defined(LUAPOCO_JSON_SSE2)
+        // long runs of indentation are skipped 16 bytes at a time.
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i cr = _mm_set1_epi8('\r');
+
+        while (mEnd - mPos >= 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mPos));
+            __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+
+            int mask = ~_mm_movemask_epi8(ws) & 0xffff;
+            if (mask != 0)
+            {
+                mPos += jsonFirstSetBit(mask);
+                return static_cast<unsigned char>(*mPos);
+            }
+            mPos += 16;
+        }
+#endif
+        while (mPos < mEnd && isSpace(*mPos)) { ++mPos; }
+
+        if (mPos == mEnd && mStream) { refill(); }
+    }
+
+    return mPos < mEnd ? static_cast<unsigned char>(*mPos) : -1;
+}
+
+void JsonReader::bufferString()
+{
+    size_t scanned = 1;
+
+    for (;;)
+    {
+        const char* p = mPos + scanned;
+        const char* quote = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(mEnd - p)));
+
+        while (quote)
+        {
+            // the quote closes the string unless it is escaped by an odd number of backslashes.
+            const char* b = quote;
+            while (b > mPos + 1 && b[-1] == '\\') { --b; }
+            if ((quote - b) % 2 == 0) { return; }
+
+            quote = static_cast<const char*>(std::memchr(quote + 1, '"', static_cast<size_t>(mEnd - quote - 1)));
+        }
+
+        scanned = static_cast<size_t>(mEnd - mPos);
+        // readString reports the unterminated string.
+        if (!refill()) { return; }
+    }
+}
+
+void JsonReader::bufferNumber()
+{
+    size_t scanned = 0;
+
+    for (;;)
+    {
+        const char* p = mPos + scanned;
+        while (p < mEnd && (isDigit(*p) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) { ++p; }
+
+        if (p < mEnd) { return; }
+
+        scanned = static_cast<size_t>(mEnd - mPos);
+        if (!refill()) { return; }
+    }
+}
+
+void JsonReader::bufferLiteral()
+{
+    // the longest literal is false.
+    while (mEnd - mPos < 5 && refill()) {}
+}
+
+bool JsonReader::refill()
+{
+    size_t unread = static_cast<size_t>(mEnd - mPos);
+    size_t offset = static_cast<size_t>(mPos - mBegin);
+
+    // tokens longer than half the buffer double its size, so that they are rescanned a bounded number of times.
+    if (unread > mBuffer.size() / 2) { mBuffer.resize(mBuffer.size() * 2); }
+
+    char* buffer = &mBuffer[0];
+    if (unread > 0) { std::memmove(buffer, buffer + offset, unread); }
+    mDiscarded += offset;
+
+    mStream->read(buffer + unread, static_cast<std::streamsize>(mBuffer.size() - unread));
+    size_t count = static_cast<size_t>(mStream->gcount());
+    if (count == 0 && mStream->bad()) { throw Poco::JSON::JSONException("error reading the json stream."); }
+
+    mBegin = buffer;
+    mPos = buffer;
+    mEnd = buffer + unread + count;
+
+    return count > 0;
+}
+
+void JsonReader::readString()
+{
+    const char* quote = mPos;
+    const char* start = mPos + 1;
+    const char* p = start + jsonPlainPrefix(start, static_cast<size_t>(mEnd - start));
+
+    // strings without escapes are read in place.
+    if (p < mEnd && *p == '"')
+    {
+        mString = start;
+        mStringSize = static_cast<size_t>(p - start);
+        mPos = p + 1;
+        return;
+    }
+
+    mScratch.assign(start, p);
+
+    for (;;)
+    {
+        if (p >= mEnd) { fail("unterminated string", quote); }
+
+        char c = *p;
+        if (c == '"') { break; }
+        if (c != '\\') { fail("control character in string", p); }
+        if (mEnd - p < 2) { fail("unterminated string", quote); }
+
+        switch (p[1])
+        {
+        case '"': mScratch.push_back('"'); break;
+        case '\\': mScratch.push_back('\\'); break;
+        case '/': mScratch.push_back('/'); break;
+        case 'b': mScratch.push_back('\b'); break;
+        case 'f': mScratch.push_back('\f'); break;
+        case 'n': mScratch.push_back('\n'); break;
+        case 'r': mScratch.push_back('\r'); break;
+        case 't': mScratch.push_back('\t'); break;
+        case 'u':
+        {
+            if (mEnd - p < 6) { fail("unterminated string", quote); }
+            Poco::UInt32 codepoint = readHex4(p + 2);
+
+            if (codepoint >= 0xd800 && codepoint <= 0xdbff)
+            {
+                // a high surrogate must be followed by an escaped low surrogate.
+                Poco::UInt32 low = 0;
+                if (mEnd - p >= 12 && p[6] == '\\' && p[7] == 'u') { low = readHex4(p + 8); }
+                if (low < 0xdc00 || low > 0xdfff) { fail("invalid unicode surrogate pair", p); }
+
+                codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                p += 6;
+            }
+            else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) { fail("invalid unicode surrogate pair", p); }
+
+            appendUtf8(codepoint);
+            p += 4;
+            break;
+        }
+        default:
+            fail("invalid escape sequence", p);
+        }
+
+        p += 2;
+        size_t plain = jsonPlainPrefix(p, static_cast<size_t>(mEnd - p));
+        mScratch.append(p, plain);
+        p += plain;
+    }
+
+    mString = mScratch.data();
+    mStringSize = mScratch.size();
+    mPos = p + 1;
+}
+
+// sets mInteger for integers representable as Int64, otherwise mNumber.
+void JsonReader::readNumber()
+{
+    const char* start = mPos;
+    const char* p = mPos;
+    bool negative = false;
+
+    if (*p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+
+    if (p >= mEnd || !isDigit(*p)) { fail("invalid number", start); }
+
+    // up to 19 significant digits are accumulated, the digits dropped after them are noted by truncated.
+    Poco::UInt64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool integral = true;
+
+    if (*p == '0')
+    {
+        ++p;
+        if (p < mEnd && isDigit(*p)) { fail("leading zeros are not permitted", start); }
+    }
+    else
+    {
+        for (; p < mEnd && isDigit(*p); ++p)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<Poco::UInt64>(*p - '0');
+                ++digits;
+            }
+            else
+            {
+                ++exponent;
+                truncated = true;
+            }
+        }
+    }
+
+    if (p < mEnd && *p == '.')
+    {
+        integral = false;
+        ++p;
+        if (p >= mEnd || !isDigit(*p)) { fail("invalid number", start); }
+
+        for (; p < mEnd && isDigit(*p); ++p)
+        {
+            if (mantissa == 0 && *p == '0') { --exponent; }
+            else if (digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<Poco::UInt64>(*p - '0');
+                ++digits;
+                --exponent;
+            }
+            else { truncated = true; }
+        }
+    }
+
+    if (p < mEnd && (*p == 'e' || *p == 'E'))
+    {
+        integral = false;
+        ++p;
+        bool negativeExponent = false;
+        if (p < mEnd && (*p == '+' || *p == '-'))
+        {
+            negativeExponent = *p == '-';
+            ++p;
+        }
+        if (p >= mEnd || !isDigit(*p)) { fail("invalid number", start); }
+
+        int e = 0;
+        for (; p < mEnd && isDigit(*p); ++p)
+        {
+            if (e < 100000) { e = e * 10 + (*p - '0'); }
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    mPos = p;
+    mIntegral = true;
+
+    if (integral && !truncated)
+    {
+        const Poco::UInt64 limit = static_cast<Poco::UInt64>(1) << 63;
+        if (!negative && mantissa < limit)
+        {
+            mInteger = static_cast<Poco::Int64>(mantissa);
+            return;
+        }
+        if (negative && mantissa <= limit)
+        {
+            mInteger = static_cast<Poco::Int64>(0 - mantissa);
+            return;
+        }
+    }
+
+    mIntegral = false;
+
+    // both the mantissa and the power of ten are exact, so a single operation rounds correctly.
+    if (!truncated && mantissa <= (static_cast<Poco::UInt64>(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double d = static_cast<double>(mantissa);
+        d = exponent < 0 ? d / exactPowers[-exponent] : d * exactPowers[exponent];
+        mNumber = negative ? -d : d;
+        return;
+    }
+
+    std::string text(start, p);
+    mNumber = std::strtod(text.c_str(), NULL);
+}
+
+void JsonReader::readLiteral(const char* literal, size_t len)
+{
+    if (static_cast<size_t>(mEnd - mPos) < len || std::memcmp(mPos, literal, len) != 0)
+    {
+        fail("invalid literal", mPos);
+    }
+
+    mPos += len;
+}
+
+void JsonReader::appendUtf8(Poco::UInt32 codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        mScratch.push_back(static_cast<char>(codepoint));
+    }
+    else if (codepoint < 0x800)
+    {
+        mScratch.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+        mScratch.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    }
+    else if (codepoint < 0x10000)
+    {
+        mScratch.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+        mScratch.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+        mScratch.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    }
+    else
+    {
+        mScratch.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+        mScratch.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+        mScratch.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+        mScratch.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    }
+}
+
+Poco::UInt32 JsonReader::readHex4(const char* p)
+{
+    Poco::UInt32 value = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int digit = hexValue(p[i]);
+        if (digit < 0) { fail("invalid unicode escape", p - 2); }
+        value = (value << 4) | static_cast<Poco::UInt32>(digit);
+    }
+
+    return value;
+}
+
+void JsonReader::fail(const char* message, const char* at)
+{
+    std::string error(message);
+    error.append(" at byte ");
+    error.append(Poco::NumberFormatter::format(mDiscarded + static_cast<Poco::UInt64>(at - mBegin)));
+
+    throw Poco::JSON::JSONException(error);
+}
+
+} // LuaPoco
@@ -0,0 +1,116 @@
+#ifndef LUA_POCO_JSON_READER_H
+#define LUA_POCO_JSON_READER_H
+
+#include "LuaPoco.h"
+#include <Poco/Types.h>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// pull parser reading JSON text one event at a time, without recursion.
+// errors are thrown as Poco::JSON::JSONException, with the byte offset of the error in the message.
+class JsonReader
+{
+public:
+    enum Event
+    {
+        END,
+        START_OBJECT,
+        END_OBJECT,
+        START_ARRAY,
+        END_ARRAY,
+        KEY,
+        STRING,
+        INTEGER,
+        NUMBER,
+        BOOLEAN,
+        NUL
+    };
+
+    // reads the document in data, which must stay valid while the reader is in use.
+    JsonReader(const char* data, size_t size);
+    // reads the document from stream incrementally, buffering only the current token.
+    JsonReader(std::istream& stream);
+    ~JsonReader();
+
+    // reads the next event. END is returned once the document is complete,
+    // an error is thrown if anything but whitespace follows it.
+    Event next();
+    // allows a sequence of documents separated by whitespace, such as newline delimited JSON.
+    // END is then returned once the input is exhausted.
+    void setMultipleDocuments(bool multiple);
+
+    // the value of the last KEY or STRING event, valid until the next call to next().
+    const char* string() const;
+    size_t stringSize() const;
+    Poco::Int64 integer() const;
+    double number() const;
+    bool boolean() const;
+
+    // number of objects and arrays open after the last event.
+    size_t depth() const;
+    // byte offset of the current position in the document.
+    Poco::UInt64 offset() const;
+
+private:
+    JsonReader(const JsonReader&);
+    JsonReader& operator=(const JsonReader&);
+
+    enum State
+    {
+        VALUE,
+        KEY_OR_END,
+        COLON,
+        AFTER_VALUE
+    };
+
+    // skips whitespace, returns the next character or -1 at the end of the input.
+    int peek();
+    // when reading a stream, ensures the whole token starting at mPos is buffered.
+    void bufferString();
+    void bufferNumber();
+    void bufferLiteral();
+    // moves the unread input to the start of the buffer and reads more from the stream after it.
+    // returns false when the stream has no more input.
+    bool refill();
+    void readString();
+    void readNumber();
+    void readLiteral(const char* literal, size_t len);
+    void appendUtf8(Poco::UInt32 codepoint);
+    Poco::UInt32 readHex4(const char* p);
+    void fail(const char* message, const char* at);
+
+    const char* mBegin;
+    const char* mPos;
+    const char* mEnd;
+
+    std::istream* mStream;
+    // holds the unread part of the stream input.
+    std::vector<char> mBuffer;
+    // bytes of the stream input discarded from the buffer.
+    Poco::UInt64 mDiscarded;
+
+    State mState;
+    bool mMultiple;
+    // a container was just opened, so it may be closed without a value.
+    bool mEmpty;
+    // 'o' or 'a' for each open container.
+    std::vector<char> mStack;
+
+    const char* mString;
+    size_t mStringSize;
+    // holds unescaped strings, other strings are read in place.
+    std::string mScratch;
+    bool mIntegral;
+    Poco::Int64 mInteger;
+    double mNumber;
+    bool mBoolean;
+};
+
+} // LuaPoco
+
+#endif
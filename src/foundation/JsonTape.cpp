@@ -0,0 +1,329 @@
+#include "JsonTape.h"
+#include "JSON.h"
+#include "LuaPocoUtils.h"
+#include <Poco/JSON/JSONException.h>
+#include <cstring>
+#include <utility>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+const Poco::UInt64 MAX_INDEX = 0xffffffff;
+
+// FNV-1a.
+Poco::UInt64 hashKey(const char* key, size_t len)
+{
+    Poco::UInt64 h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// keep the load factor at or below one half.
+size_t slotCount(size_t members)
+{
+    size_t slots = 2;
+    while (slots < members * 2) { slots <<= 1; }
+    return slots;
+}
+
+}
+
+JsonTape::JsonTape()
+{
+}
+
+JsonTape::~JsonTape()
+{
+}
+
+void JsonTape::parse(JsonReader& reader)
+{
+    // children of the objects and arrays still open.
+    std::vector<Poco::UInt32> pending;
+    // each open object or array, with the position of its first child in pending.
+    std::vector<std::pair<Poco::UInt32, size_t> > open;
+
+    do
+    {
+        JsonReader::Event event = reader.next();
+
+        if (event == JsonReader::END_OBJECT || event == JsonReader::END_ARRAY)
+        {
+            closeContainer(open.back().first, pending, open.back().second);
+            open.pop_back();
+            continue;
+        }
+
+        // the children of an array are its elements, and the children of an object are its keys,
+        // each of which is followed by its value.
+        if (!open.empty() && (event == JsonReader::KEY || mNodes[open.back().first].type == ARRAY))
+        {
+            pending.push_back(static_cast<Poco::UInt32>(mNodes.size()));
+        }
+
+        switch (event)
+        {
+        case JsonReader::START_OBJECT:
+            open.push_back(std::make_pair(addNode(OBJECT, 0, 0), pending.size()));
+            break;
+        case JsonReader::START_ARRAY:
+            open.push_back(std::make_pair(addNode(ARRAY, 0, 0), pending.size()));
+            break;
+        case JsonReader::KEY:
+        case JsonReader::STRING:
+            addString(STRING, reader.string(), reader.stringSize());
+            break;
+        case JsonReader::INTEGER:
+            addNode(INTEGER, 0, static_cast<Poco::UInt64>(reader.integer()));
+            break;
+        case JsonReader::NUMBER:
+        {
+            double number = reader.number();
+            Poco::UInt64 bits = 0;
+            std::memcpy(&bits, &number, sizeof number);
+            addNode(NUMBER, 0, bits);
+            break;
+        }
+        case JsonReader::BOOLEAN:
+            addNode(BOOLEAN, 0, reader.boolean() ? 1 : 0);
+            break;
+        case JsonReader::NUL:
+            addNode(NUL, 0, 0);
+            break;
+        default:
+            throw Poco::JSON::JSONException("unexpected end of document");
+        }
+    }
+    while (!open.empty());
+
+    // ensures nothing follows the document.
+    reader.next();
+}
+
+JsonTape::Type JsonTape::type(Poco::UInt32 node) const
+{
+    return static_cast<Type>(mNodes[node].type);
+}
+
+Poco::UInt32 JsonTape::count(Poco::UInt32 node) const
+{
+    return mNodes[node].count;
+}
+
+Poco::UInt32 JsonTape::child(Poco::UInt32 node, Poco::UInt32 i) const
+{
+    return mChildren[static_cast<size_t>(mNodes[node].value) + i];
+}
+
+bool JsonTape::find(Poco::UInt32 node, const char* key, size_t len, Poco::UInt32& position) const
+{
+    const Node& n = mNodes[node];
+    if (n.type != OBJECT || n.count == 0) { return false; }
+
+    const Poco::UInt32* children = &mChildren[static_cast<size_t>(n.value)];
+
+    if (n.count <= LINEAR_MEMBERS)
+    {
+        for (Poco::UInt32 i = n.count; i-- > 0;)
+        {
+            if (keyEquals(children[i], key, len))
+            {
+                position = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Poco::UInt32* slots = children + n.count;
+    size_t mask = slotCount(n.count) - 1;
+    size_t slot = static_cast<size_t>(hashKey(key, len)) & mask;
+
+    for (; slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        if (keyEquals(children[slots[slot] - 1], key, len))
+        {
+            position = slots[slot] - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* JsonTape::string(Poco::UInt32 node, size_t& len) const
+{
+    len = mNodes[node].count;
+    return mStrings.data() + mNodes[node].value;
+}
+
+Poco::Int64 JsonTape::integer(Poco::UInt32 node) const
+{
+    return static_cast<Poco::Int64>(mNodes[node].value);
+}
+
+double JsonTape::number(Poco::UInt32 node) const
+{
+    double number = 0;
+    std::memcpy(&number, &mNodes[node].value, sizeof number);
+    return number;
+}
+
+bool JsonTape::boolean(Poco::UInt32 node) const
+{
+    return mNodes[node].value != 0;
+}
+
+void JsonTape::pushScalar(lua_State* L, Poco::UInt32 node) const
+{
+    size_t len = 0;
+    const char* str = NULL;
+
+    switch (type(node))
+    {
+    case STRING:
+        str = string(node, len);
+        lua_pushlstring(L, str, len);
+        break;
+    case INTEGER:
+        pushInteger(L, integer(node));
+        break;
+    case NUMBER:
+        lua_pushnumber(L, static_cast<lua_Number>(number(node)));
+        break;
+    case BOOLEAN:
+        lua_pushboolean(L, static_cast<int>(boolean(node)));
+        break;
+    case NUL:
+        // use sentinel value jsonNull
+        lua_pushlightuserdata(L, static_cast<void*>(jsonNull));
+        break;
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+void JsonTape::push(lua_State* L, Poco::UInt32 node) const
+{
+    Type t = type(node);
+    if (t != OBJECT && t != ARRAY)
+    {
+        pushScalar(L, node);
+        return;
+    }
+
+    // each table being filled, with the position of its next child.
+    std::vector<std::pair<Poco::UInt32, Poco::UInt32> > frames;
+    Poco::UInt32 value = node;
+
+    for (;;)
+    {
+        t = type(value);
+        if (t == OBJECT || t == ARRAY)
+        {
+            // room for the table and key of each level, and the key and value being set.
+            if (!lua_checkstack(L, 4)) { throw Poco::JSON::JSONException("json nesting is too deep."); }
+
+            // the number of children is known, so the table is created with its final size.
+            if (t == ARRAY) { lua_createtable(L, static_cast<int>(count(value)), 0); }
+            else { lua_createtable(L, 0, static_cast<int>(count(value))); }
+
+            frames.push_back(std::make_pair(value, 0));
+        }
+        else
+        {
+            pushScalar(L, value);
+            setChild(L, frames.back().first, frames.back().second);
+        }
+
+        // sets each table whose children are all set in its parent.
+        while (frames.back().second == count(frames.back().first))
+        {
+            frames.pop_back();
+            if (frames.empty()) { return; }
+            setChild(L, frames.back().first, frames.back().second);
+        }
+
+        std::pair<Poco::UInt32, Poco::UInt32>& frame = frames.back();
+        value = child(frame.first, frame.second++);
+        if (type(frame.first) == OBJECT)
+        {
+            // members are set in document order, such that the last of duplicate keys wins.
+            pushScalar(L, value);
+            ++value;
+        }
+    }
+}
+
+// sets the value on the top of the stack as the child at position of the table below it,
+// and for an object, below its key.
+void JsonTape::setChild(lua_State* L, Poco::UInt32 parent, Poco::UInt32 position) const
+{
+    if (type(parent) == ARRAY) { lua_rawseti(L, -2, static_cast<int>(position)); }
+    else { lua_rawset(L, -3); }
+}
+
+Poco::UInt32 JsonTape::addNode(Type type, Poco::UInt32 count, Poco::UInt64 value)
+{
+    if (mNodes.size() >= MAX_INDEX) { throw Poco::JSON::JSONException("json document is too large."); }
+
+    Node n = { static_cast<Poco::UInt32>(type), count, value };
+    mNodes.push_back(n);
+    return static_cast<Poco::UInt32>(mNodes.size() - 1);
+}
+
+Poco::UInt32 JsonTape::addString(Type type, const char* s, size_t len)
+{
+    if (len > MAX_INDEX) { throw Poco::JSON::JSONException("json string is too large."); }
+
+    Poco::UInt64 offset = mStrings.size();
+    mStrings.insert(mStrings.end(), s, s + len);
+    return addNode(type, static_cast<Poco::UInt32>(len), offset);
+}
+
+void JsonTape::closeContainer(Poco::UInt32 node, std::vector<Poco::UInt32>& pending, size_t first)
+{
+    size_t count = pending.size() - first;
+    size_t offset = mChildren.size();
+
+    mNodes[node].count = static_cast<Poco::UInt32>(count);
+    mNodes[node].value = offset;
+    mChildren.insert(mChildren.end(), pending.begin() + first, pending.end());
+    pending.resize(first);
+
+    if (mNodes[node].type != OBJECT || count <= LINEAR_MEMBERS) { return; }
+
+    size_t base = mChildren.size();
+    size_t mask = slotCount(count) - 1;
+    mChildren.resize(base + mask + 1, 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t len = 0;
+        const char* key = string(mChildren[offset + i], len);
+        size_t slot = static_cast<size_t>(hashKey(key, len)) & mask;
+
+        // a duplicate key replaces the slot of the earlier member.
+        while (mChildren[base + slot] != 0 && !keyEquals(mChildren[offset + mChildren[base + slot] - 1], key, len))
+        {
+            slot = (slot + 1) & mask;
+        }
+        mChildren[base + slot] = static_cast<Poco::UInt32>(i + 1);
+    }
+}
+
+bool JsonTape::keyEquals(Poco::UInt32 keyNode, const char* key, size_t len) const
+{
+    const Node& n = mNodes[keyNode];
+    return n.count == len && std::memcmp(mStrings.data() + n.value, key, len) == 0;
+}
+
+} // LuaPoco
@@ -0,0 +1,86 @@
+#ifndef LUA_POCO_JSON_TAPE_H
+#define LUA_POCO_JSON_TAPE_H
+
+#include "LuaPoco.h"
+#include "JsonReader.h"
+#include <Poco/Types.h>
+#include <vector>
+
+namespace LuaPoco
+{
+
+// compact immutable representation of a parsed JSON document.
+// values are stored as nodes in document order, with the members of an object stored as key, value pairs.
+// each object and array has an index of its children, so elements and members are found without a scan,
+// and the strings of the document are stored together in a single buffer.
+// nothing is modified once parse() returns, so any number of threads may read it without locking.
+class JsonTape
+{
+public:
+    enum Type
+    {
+        OBJECT,
+        ARRAY,
+        STRING,
+        INTEGER,
+        NUMBER,
+        BOOLEAN,
+        NUL
+    };
+
+    JsonTape();
+    ~JsonTape();
+
+    // parses a complete document, the root of which is node 0.
+    void parse(JsonReader& reader);
+
+    Type type(Poco::UInt32 node) const;
+    // number of elements of an array or members of an object.
+    Poco::UInt32 count(Poco::UInt32 node) const;
+    // the i-th element of an array, or the key of the i-th member of an object, whose value is the next node.
+    Poco::UInt32 child(Poco::UInt32 node, Poco::UInt32 i) const;
+    // finds the position of the member of an object with key, the last member wins for duplicate keys.
+    bool find(Poco::UInt32 node, const char* key, size_t len, Poco::UInt32& position) const;
+
+    const char* string(Poco::UInt32 node, size_t& len) const;
+    Poco::Int64 integer(Poco::UInt32 node) const;
+    double number(Poco::UInt32 node) const;
+    bool boolean(Poco::UInt32 node) const;
+
+    // pushes the Lua value of a string, number, boolean or null node.
+    void pushScalar(lua_State* L, Poco::UInt32 node) const;
+    // pushes the Lua value of any node, decoding objects and arrays fully into tables.
+    void push(lua_State* L, Poco::UInt32 node) const;
+
+private:
+    JsonTape(const JsonTape&);
+    JsonTape& operator=(const JsonTape&);
+
+    struct Node
+    {
+        Poco::UInt32 type;
+        // string length, or number of children.
+        Poco::UInt32 count;
+        // string offset in mStrings, offset of the children in mChildren, or the bits of a number or boolean.
+        Poco::UInt64 value;
+    };
+
+    Poco::UInt32 addNode(Type type, Poco::UInt32 count, Poco::UInt64 value);
+    Poco::UInt32 addString(Type type, const char* s, size_t len);
+    // appends the children of a closed object or array to mChildren, with a hash of the keys for large objects.
+    void closeContainer(Poco::UInt32 node, std::vector<Poco::UInt32>& pending, size_t first);
+    void setChild(lua_State* L, Poco::UInt32 parent, Poco::UInt32 position) const;
+    bool keyEquals(Poco::UInt32 keyNode, const char* key, size_t len) const;
+
+    std::vector<Node> mNodes;
+    enum { LINEAR_MEMBERS = 8 };
+
+    // children of each object and array, followed by an open addressing hash of keys for objects with
+    // more than LINEAR_MEMBERS members, where each slot holds a member position + 1, or 0 when empty.
+    std::vector<Poco::UInt32> mChildren;
+    std::vector<char> mStrings;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,671 @@
+#include "JsonWriter.h"
+#include "JsonCommon.h"
+#include <Poco/Exception.h>
+#include <Poco/JSON/JSONException.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace LuaPoco
+{
+
+namespace
+{
+
+const size_t INITIAL_CAPACITY = 4096;
+// size of the chunks written to a sink.
+const size_t SINK_CAPACITY = 64 * 1024;
+
+// escape sequence character for each byte, 'u' for bytes written as \u00XX, 0 for bytes copied as is.
+const char escapeTable[256] =
+{
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+const char hexDigits[] = "0123456789abcdef";
+
+const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// shortest round trip formatting of doubles, using the Grisu2 algorithm by Florian Loitsch.
+// the digits produced always read back as the same double, and are the shortest such digits for nearly all values.
+
+// a floating point value f * 2^e with a 64 bit significand.
+struct DiyFp
+{
+    DiyFp(Poco::UInt64 significand, int exponent) : f(significand), e(exponent) {}
+
+    static DiyFp sub(const DiyFp& x, const DiyFp& y)
+    {
+        return DiyFp(x.f - y.f, x.e);
+    }
+
+    // the upper 64 bits of the 128 bit product, rounded.
+    static DiyFp mul(const DiyFp& x, const DiyFp& y)
+    {
+        const Poco::UInt64 xLo = x.f & 0xffffffffu;
+        const Poco::UInt64 xHi = x.f >> 32;
+        const Poco::UInt64 yLo = y.f & 0xffffffffu;
+        const Poco::UInt64 yHi = y.f >> 32;
+
+        const Poco::UInt64 p0 = xLo * yLo;
+        const Poco::UInt64 p1 = xLo * yHi;
+        const Poco::UInt64 p2 = xHi * yLo;
+        const Poco::UInt64 p3 = xHi * yHi;
+
+        Poco::UInt64 q = (p0 >> 32) + (p1 & 0xffffffffu) + (p2 & 0xffffffffu);
+        q += Poco::UInt64(1) << 31;
+
+        return DiyFp(p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64);
+    }
+
+    static DiyFp normalize(DiyFp x)
+    {
+        while ((x.f >> 63) == 0)
+        {
+            x.f <<= 1;
+            --x.e;
+        }
+        return x;
+    }
+
+    static DiyFp normalizeTo(const DiyFp& x, int exponent)
+    {
+        return DiyFp(x.f << (x.e - exponent), exponent);
+    }
+
+    Poco::UInt64 f;
+    int e;
+};
+
+// 10^k as f * 2^e, for k from -300 to 340 in steps of 8.
+struct CachedPower
+{
+    Poco::UInt64 f;
+    int e;
+    int k;
+};
+
+const CachedPower cachedPowers[] =
+{
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL, -980, -276 },
+    { 0xD3515C2831559A83ULL, -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL, -927, -260 },
+    { 0xEA9C227723EE8BCBULL, -901, -252 },
+    { 0xAECC49914078536DULL, -874, -244 },
+    { 0x823C12795DB6CE57ULL, -847, -236 },
+    { 0xC21094364DFB5637ULL, -821, -228 },
+    { 0x9096EA6F3848984FULL, -794, -220 },
+    { 0xD77485CB25823AC7ULL, -768, -212 },
+    { 0xA086CFCD97BF97F4ULL, -741, -204 },
+    { 0xEF340A98172AACE5ULL, -715, -196 },
+    { 0xB23867FB2A35B28EULL, -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL, -661, -180 },
+    { 0xC5DD44271AD3CDBAULL, -635, -172 },
+    { 0x936B9FCEBB25C996ULL, -608, -164 },
+    { 0xDBAC6C247D62A584ULL, -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL, -555, -148 },
+    { 0xF3E2F893DEC3F126ULL, -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL, -502, -132 },
+    { 0x87625F056C7C4A8BULL, -475, -124 },
+    { 0xC9BCFF6034C13053ULL, -449, -116 },
+    { 0x964E858C91BA2655ULL, -422, -108 },
+    { 0xDFF9772470297EBDULL, -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL, -369, -92 },
+    { 0xF8A95FCF88747D94ULL, -343, -84 },
+    { 0xB94470938FA89BCFULL, -316, -76 },
+    { 0x8A08F0F8BF0F156BULL, -289, -68 },
+    { 0xCDB02555653131B6ULL, -263, -60 },
+    { 0x993FE2C6D07B7FACULL, -236, -52 },
+    { 0xE45C10C42A2B3B06ULL, -210, -44 },
+    { 0xAA242499697392D3ULL, -183, -36 },
+    { 0xFD87B5F28300CA0EULL, -157, -28 },
+    { 0xBCE5086492111AEBULL, -130, -20 },
+    { 0x8CBCCC096F5088CCULL, -103, -12 },
+    { 0xD1B71758E219652CULL, -77, -4 },
+    { 0x9C40000000000000ULL, -50, 4 },
+    { 0xE8D4A51000000000ULL, -24, 12 },
+    { 0xAD78EBC5AC620000ULL, 3, 20 },
+    { 0x813F3978F8940984ULL, 30, 28 },
+    { 0xC097CE7BC90715B3ULL, 56, 36 },
+    { 0x8F7E32CE7BEA5C70ULL, 83, 44 },
+    { 0xD5D238A4ABE98068ULL, 109, 52 },
+    { 0x9F4F2726179A2245ULL, 136, 60 },
+    { 0xED63A231D4C4FB27ULL, 162, 68 },
+    { 0xB0DE65388CC8ADA8ULL, 189, 76 },
+    { 0x83C7088E1AAB65DBULL, 216, 84 },
+    { 0xC45D1DF942711D9AULL, 242, 92 },
+    { 0x924D692CA61BE758ULL, 269, 100 },
+    { 0xDA01EE641A708DEAULL, 295, 108 },
+    { 0xA26DA3999AEF774AULL, 322, 116 },
+    { 0xF209787BB47D6B85ULL, 348, 124 },
+    { 0xB454E4A179DD1877ULL, 375, 132 },
+    { 0x865B86925B9BC5C2ULL, 402, 140 },
+    { 0xC83553C5C8965D3DULL, 428, 148 },
+    { 0x952AB45CFA97A0B3ULL, 455, 156 },
+    { 0xDE469FBD99A05FE3ULL, 481, 164 },
+    { 0xA59BC234DB398C25ULL, 508, 172 },
+    { 0xF6C69A72A3989F5CULL, 534, 180 },
+    { 0xB7DCBF5354E9BECEULL, 561, 188 },
+    { 0x88FCF317F22241E2ULL, 588, 196 },
+    { 0xCC20CE9BD35C78A5ULL, 614, 204 },
+    { 0x98165AF37B2153DFULL, 641, 212 },
+    { 0xE2A0B5DC971F303AULL, 667, 220 },
+    { 0xA8D9D1535CE3B396ULL, 694, 228 },
+    { 0xFB9B7CD9A4A7443CULL, 720, 236 },
+    { 0xBB764C4CA7A44410ULL, 747, 244 },
+    { 0x8BAB8EEFB6409C1AULL, 774, 252 },
+    { 0xD01FEF10A657842CULL, 800, 260 },
+    { 0x9B10A4E5E9913129ULL, 827, 268 },
+    { 0xE7109BFBA19C0C9DULL, 853, 276 },
+    { 0xAC2820D9623BF429ULL, 880, 284 },
+    { 0x80444B5E7AA7CF85ULL, 907, 292 },
+    { 0xBF21E44003ACDD2DULL, 933, 300 },
+    { 0x8E679C2F5E44FF8FULL, 960, 308 },
+    { 0xD433179D9C8CB841ULL, 986, 316 },
+    { 0x9E19DB92B4E31BA9ULL, 1013, 324 },
+    { 0xEB96BF6EBADF77D9ULL, 1039, 332 },
+    { 0xAF87023B9BF0EE6BULL, 1066, 340 }
+};
+
+// the normalized value v, and the boundaries m- and m+ halfway to its neighbouring doubles.
+void computeBoundaries(double value, DiyFp& minus, DiyFp& v, DiyFp& plus)
+{
+    const Poco::UInt64 hiddenBit = Poco::UInt64(1) << 52;
+    const int bias = 1075;
+
+    Poco::UInt64 bits = 0;
+    std::memcpy(&bits, &value, sizeof bits);
+    const Poco::UInt64 biasedExponent = bits >> 52;
+    const Poco::UInt64 fraction = bits & (hiddenBit - 1);
+
+    DiyFp x = biasedExponent == 0
+        ? DiyFp(fraction, 1 - bias)
+        : DiyFp(fraction + hiddenBit, static_cast<int>(biasedExponent) - bias);
+
+    // the lower boundary is closer when the value is a power of two, other than the smallest normal.
+    const bool lowerCloser = fraction == 0 && biasedExponent > 1;
+    DiyFp mPlus(2 * x.f + 1, x.e - 1);
+    DiyFp mMinus = lowerCloser ? DiyFp(4 * x.f - 1, x.e - 2) : DiyFp(2 * x.f - 1, x.e - 1);
+
+    plus = DiyFp::normalize(mPlus);
+    minus = DiyFp::normalizeTo(mMinus, plus.e);
+    v = DiyFp::normalize(x);
+}
+
+// gets the cached power c = 10^-k such that the binary exponent of c * 2^e is within [-60, -32].
+const CachedPower& cachedPowerFor(int e)
+{
+    const int alpha = -60;
+    const int f = alpha - e - 1;
+    const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+    const int index = (300 + k + 7) / 8;
+
+    return cachedPowers[index];
+}
+
+int largestPow10(Poco::UInt32 n, Poco::UInt32& pow10)
+{
+    if (n >= 1000000000) { pow10 = 1000000000; return 10; }
+    if (n >= 100000000) { pow10 = 100000000; return 9; }
+    if (n >= 10000000) { pow10 = 10000000; return 8; }
+    if (n >= 1000000) { pow10 = 1000000; return 7; }
+    if (n >= 100000) { pow10 = 100000; return 6; }
+    if (n >= 10000) { pow10 = 10000; return 5; }
+    if (n >= 1000) { pow10 = 1000; return 4; }
+    if (n >= 100) { pow10 = 100; return 3; }
+    if (n >= 10) { pow10 = 10; return 2; }
+    pow10 = 1;
+    return 1;
+}
+
+// moves the last digit towards w while the result stays within the boundaries.
+void roundWeed(char* digits, int length, Poco::UInt64 dist, Poco::UInt64 delta, Poco::UInt64 rest, Poco::UInt64 tenK)
+{
+    while (rest < dist && delta - rest >= tenK && (rest + tenK < dist || dist - rest > rest + tenK - dist))
+    {
+        --digits[length - 1];
+        rest += tenK;
+    }
+}
+
+// generates the shortest digits of a value within (minus, plus), close to w.
+void generateDigits(char* digits, int& length, int& exponent, const DiyFp& minus, const DiyFp& w, const DiyFp& plus)
+{
+    Poco::UInt64 delta = DiyFp::sub(plus, minus).f;
+    Poco::UInt64 dist = DiyFp::sub(plus, w).f;
+
+    const DiyFp one(Poco::UInt64(1) << -plus.e, plus.e);
+    Poco::UInt32 p1 = static_cast<Poco::UInt32>(plus.f >> -one.e);
+    Poco::UInt64 p2 = plus.f & (one.f - 1);
+
+    Poco::UInt32 pow10 = 0;
+    int n = largestPow10(p1, pow10);
+
+    while (n > 0)
+    {
+        const Poco::UInt32 d = p1 / pow10;
+        p1 %= pow10;
+        digits[length++] = static_cast<char>('0' + d);
+        --n;
+
+        const Poco::UInt64 rest = (static_cast<Poco::UInt64>(p1) << -one.e) + p2;
+        if (rest <= delta)
+        {
+            exponent += n;
+            roundWeed(digits, length, dist, delta, rest, static_cast<Poco::UInt64>(pow10) << -one.e);
+            return;
+        }
+
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for (;;)
+    {
+        p2 *= 10;
+        const Poco::UInt64 d = p2 >> -one.e;
+        p2 &= one.f - 1;
+        digits[length++] = static_cast<char>('0' + d);
+        ++m;
+
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) { break; }
+    }
+
+    exponent -= m;
+    roundWeed(digits, length, dist, delta, p2, one.f);
+}
+
+// formats a finite, positive double as JSON, returns the number of characters written to out.
+int formatDouble(double value, char* out)
+{
+    DiyFp minus(0, 0), v(0, 0), plus(0, 0);
+    computeBoundaries(value, minus, v, plus);
+
+    const CachedPower& cached = cachedPowerFor(plus.e);
+    const DiyFp c(cached.f, cached.e);
+    const DiyFp w = DiyFp::mul(v, c);
+    const DiyFp wMinus = DiyFp::mul(minus, c);
+    const DiyFp wPlus = DiyFp::mul(plus, c);
+
+    // the boundaries are narrowed by one unit to account for the error of the multiplication.
+    char digits[18];
+    int length = 0;
+    int exponent = -cached.k;
+    generateDigits(digits, length, exponent, DiyFp(wMinus.f + 1, wMinus.e), w, DiyFp(wPlus.f - 1, wPlus.e));
+
+    // position of the decimal point relative to the first digit.
+    const int point = length + exponent;
+    char* p = out;
+
+    if (length <= point && point <= 15)
+    {
+        std::memcpy(p, digits, length);
+        std::memset(p + length, '0', point - length);
+        p += point;
+    }
+    else if (0 < point && point < length && point <= 17)
+    {
+        std::memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        std::memcpy(p, digits + point, length - point);
+        p += length - point;
+    }
+    else if (-4 < point && point <= 0)
+    {
+        *p++ = '0';
+        *p++ = '.';
+        std::memset(p, '0', -point);
+        p += -point;
+        std::memcpy(p, digits, length);
+        p += length;
+    }
+    else
+    {
+        *p++ = digits[0];
+        if (length > 1)
+        {
+            *p++ = '.';
+            std::memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+
+        int e = point - 1;
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        if (e < 0) { e = -e; }
+        if (e >= 100) { *p++ = static_cast<char>('0' + e / 100); }
+        if (e >= 10) { *p++ = static_cast<char>('0' + (e / 10) % 10); }
+        *p++ = static_cast<char>('0' + e % 10);
+    }
+
+    return static_cast<int>(p - out);
+}
+
+// writes the decimal digits of u ending at end, returns the first digit written.
+char* formatUnsigned(Poco::UInt64 u, char* end)
+{
+    char* p = end;
+
+    while (u >= 100)
+    {
+        const char* pair = digitPairs + (u % 100) * 2;
+        u /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+
+    if (u >= 10)
+    {
+        const char* pair = digitPairs + u * 2;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else { *--p = static_cast<char>('0' + u); }
+
+    return p;
+}
+
+}
+
+JsonWriter::JsonWriter(unsigned indent) :
+    mSink(NULL),
+    mData(NULL),
+    mSize(0),
+    mCapacity(0),
+    mIndent(indent),
+    mDepth(0),
+    mFirst(true),
+    mAfterKey(false)
+{
+}
+
+JsonWriter::JsonWriter(unsigned indent, std::ostream& sink) :
+    mSink(&sink),
+    mData(NULL),
+    mSize(0),
+    mCapacity(0),
+    mIndent(indent),
+    mDepth(0),
+    mFirst(true),
+    mAfterKey(false)
+{
+}
+
+JsonWriter::~JsonWriter()
+{
+    std::free(mData);
+}
+
+void JsonWriter::startObject()
+{
+    separate();
+    reserve(1);
+    put('{');
+    ++mDepth;
+    mFirst = true;
+}
+
+void JsonWriter::endObject()
+{
+    --mDepth;
+    if (!mFirst) { newLine(); }
+    reserve(1);
+    put('}');
+    mFirst = false;
+}
+
+void JsonWriter::startArray()
+{
+    separate();
+    reserve(1);
+    put('[');
+    ++mDepth;
+    mFirst = true;
+}
+
+void JsonWriter::endArray()
+{
+    --mDepth;
+    if (!mFirst) { newLine(); }
+    reserve(1);
+    put(']');
+    mFirst = false;
+}
+
+void JsonWriter::key(const char* k, size_t len)
+{
+    separate();
+    writeString(k, len);
+
+    if (mIndent)
+    {
+        reserve(3);
+        put(' ');
+        put(':');
+        put(' ');
+    }
+    else
+    {
+        reserve(1);
+        put(':');
+    }
+
+    mAfterKey = true;
+}
+
+void JsonWriter::null()
+{
+    separate();
+    reserve(4);
+    std::memcpy(mData + mSize, "null", 4);
+    mSize += 4;
+}
+
+void JsonWriter::value(bool b)
+{
+    separate();
+    reserve(5);
+    if (b)
+    {
+        std::memcpy(mData + mSize, "true", 4);
+        mSize += 4;
+    }
+    else
+    {
+        std::memcpy(mData + mSize, "false", 5);
+        mSize += 5;
+    }
+}
+
+void JsonWriter::value(Poco::Int64 i)
+{
+    separate();
+
+    char digits[24];
+    char* end = digits + sizeof digits;
+    // negated as unsigned, such that the minimum Int64 does not overflow.
+    Poco::UInt64 u = i < 0 ? 0 - static_cast<Poco::UInt64>(i) : static_cast<Poco::UInt64>(i);
+    char* p = formatUnsigned(u, end);
+    if (i < 0) { *--p = '-'; }
+
+    size_t len = static_cast<size_t>(end - p);
+    reserve(len);
+    std::memcpy(mData + mSize, p, len);
+    mSize += len;
+}
+
+void JsonWriter::value(double d)
+{
+    if (d != d || d == HUGE_VAL || d == -HUGE_VAL)
+    {
+        throw Poco::JSON::JSONException("nan and infinity are invalid values for json.");
+    }
+
+    // integral values within the exactly representable range are formatted as integers.
+    if (d == std::floor(d) && d > -9007199254740992.0 && d < 9007199254740992.0)
+    {
+        // -0.0 is written as 0.
+        value(static_cast<Poco::Int64>(d));
+        return;
+    }
+
+    separate();
+
+    char buffer[32];
+    char* p = buffer;
+    if (d < 0)
+    {
+        *p++ = '-';
+        d = -d;
+    }
+
+    size_t len = static_cast<size_t>(p - buffer + formatDouble(d, p));
+    reserve(len);
+    std::memcpy(mData + mSize, buffer, len);
+    mSize += len;
+}
+
+void JsonWriter::value(const char* s, size_t len)
+{
+    separate();
+    writeString(s, len);
+}
+
+void JsonWriter::endLine()
+{
+    reserve(1);
+    put('\n');
+}
+
+void JsonWriter::flush()
+{
+    if (!mSink || mSize == 0) { return; }
+
+    mSink->write(mData, static_cast<std::streamsize>(mSize));
+    if (mSink->fail()) { throw Poco::IOException("json output write failed."); }
+
+    mSize = 0;
+}
+
+const char* JsonWriter::data() const
+{
+    return mData;
+}
+
+size_t JsonWriter::size() const
+{
+    return mSize;
+}
+
+void JsonWriter::separate()
+{
+    if (mAfterKey)
+    {
+        mAfterKey = false;
+        return;
+    }
+
+    if (mDepth == 0) { return; }
+
+    if (!mFirst)
+    {
+        reserve(1);
+        put(',');
+    }
+
+    mFirst = false;
+    newLine();
+}
+
+void JsonWriter::newLine()
+{
+    if (!mIndent) { return; }
+
+    size_t spaces = mDepth * mIndent;
+    reserve(spaces + 1);
+    put('\n');
+    std::memset(mData + mSize, ' ', spaces);
+    mSize += spaces;
+}
+
+void JsonWriter::writeString(const char* s, size_t len)
+{
+    // room for the quotes and the string without escapes, the common case.
+    reserve(len + 2);
+    put('"');
+
+    size_t pos = 0;
+    while (pos < len)
+    {
+        size_t clean = jsonPlainPrefix(s + pos, len - pos);
+        reserve(clean + 7);
+        std::memcpy(mData + mSize, s + pos, clean);
+        mSize += clean;
+        pos += clean;
+
+        if (pos == len) { break; }
+
+        unsigned char c = static_cast<unsigned char>(s[pos++]);
+        char escape = escapeTable[c];
+        put('\\');
+
+        if (escape == 'u')
+        {
+            put('u');
+            put('0');
+            put('0');
+            put(hexDigits[c >> 4]);
+            put(hexDigits[c & 0xf]);
+        }
+        else { put(escape); }
+    }
+
+    reserve(1);
+    put('"');
+}
+
+void JsonWriter::grow(size_t n)
+{
+    // the buffer is only grown beyond its initial size for a single value larger than it.
+    if (mSink)
+    {
+        flush();
+        if (mCapacity - mSize >= n) { return; }
+    }
+
+    size_t capacity = mCapacity ? mCapacity : (mSink ? SINK_CAPACITY : INITIAL_CAPACITY);
+    while (capacity - mSize < n)
+    {
+        if (capacity > static_cast<size_t>(-1) / 2) { throw Poco::OutOfMemoryException("json output is too large."); }
+        capacity *= 2;
+    }
+
+    char* data = static_cast<char*>(std::realloc(mData, capacity));
+    if (!data) { throw Poco::OutOfMemoryException("unable to allocate json output buffer."); }
+
+    mData = data;
+    mCapacity = capacity;
+}
+
+} // LuaPoco
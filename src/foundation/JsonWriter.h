@@ -0,0 +1,77 @@
+#ifndef LUA_POCO_JSON_WRITER_H
+#define LUA_POCO_JSON_WRITER_H
+
+#include "LuaPoco.h"
+#include <Poco/Types.h>
+#include <cstddef>
+#include <ostream>
+
+namespace LuaPoco
+{
+
+// formats JSON text into a growable byte buffer, or through a fixed size buffer into a stream.
+// an indent of 0 produces compact output, otherwise each value is placed on its own line.
+class JsonWriter
+{
+public:
+    JsonWriter(unsigned indent);
+    // writes the output to sink in chunks, whenever the buffer is full and on flush().
+    JsonWriter(unsigned indent, std::ostream& sink);
+    ~JsonWriter();
+
+    void startObject();
+    void endObject();
+    void startArray();
+    void endArray();
+    void key(const char* k, size_t len);
+    void null();
+    void value(bool b);
+    void value(Poco::Int64 i);
+    // throws for nan and infinity, which have no JSON representation.
+    void value(double d);
+    void value(const char* s, size_t len);
+    // ends a line of newline delimited output, following a complete document.
+    void endLine();
+
+    // writes the buffered output to the sink, throws if the write fails.
+    void flush();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    JsonWriter(const JsonWriter&);
+    JsonWriter& operator=(const JsonWriter&);
+
+    // writes the separator and indentation preceding a key or value.
+    void separate();
+    void newLine();
+    void writeString(const char* s, size_t len);
+
+    void reserve(size_t n)
+    {
+        if (mCapacity - mSize < n) { grow(n); }
+    }
+
+    void grow(size_t n);
+
+    void put(char c)
+    {
+        mData[mSize++] = c;
+    }
+
+    std::ostream* mSink;
+    char* mData;
+    size_t mSize;
+    size_t mCapacity;
+    unsigned mIndent;
+    size_t mDepth;
+    // no value has been written to the current object or array.
+    bool mFirst;
+    // a key has been written, and its value is next.
+    bool mAfterKey;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,256 @@
+/// Countdown latch for waiting on a number of events.
+// A latch is constructed with a count, which threads decrease with countDown(). Threads calling wait()
+// block until the count reaches zero, after which wait() returns immediately. A latch is not reset,
+// construct a new one for each use.
+//
+// Waiting threads are woken once, by the count down which reaches zero.
+//
+// Note: latch userdata are copyable/sharable between threads.
+// @module latch
+
+#include "Latch.h"
+#include <Poco/Clock.h>
+#include <Poco/Exception.h>
+#include <Poco/ScopedLock.h>
+
+int luaopen_poco_latch(lua_State* L)
+{
+    LuaPoco::LatchUserdata::registerLatch(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::LatchUserdata::Latch);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_LATCH_METATABLE_NAME = "Poco.Latch.metatable";
+
+Latch::Latch(Poco::Int64 count) :
+    mCount(count)
+{
+}
+
+Latch::~Latch()
+{
+}
+
+Poco::Int64 Latch::countDown(Poco::Int64 n)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    if (mCount == 0) { return 0; }
+
+    mCount = n < mCount ? mCount - n : 0;
+    if (mCount == 0) { mCondition.broadcast(); }
+
+    return mCount;
+}
+
+void Latch::wait()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    while (mCount > 0) { mCondition.wait(mMutex); }
+}
+
+bool Latch::tryWait(long ms)
+{
+    Poco::Clock start;
+    Poco::Clock::ClockDiff timeout = static_cast<Poco::Clock::ClockDiff>(ms) * 1000;
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+
+    while (mCount > 0)
+    {
+        // the remaining time is recomputed, as a wakeup does not imply the count reached zero.
+        Poco::Clock::ClockDiff remaining = timeout - start.elapsed();
+        if (remaining <= 0) { return false; }
+
+        long remainingMs = static_cast<long>((remaining + 999) / 1000);
+        mCondition.tryWait(mMutex, remainingMs);
+    }
+
+    return true;
+}
+
+Poco::Int64 Latch::count()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mMutex);
+    return mCount;
+}
+
+LatchUserdata::LatchUserdata(Poco::Int64 count) :
+    mLatch(new LuaPoco::Latch(count))
+{
+}
+
+// construct new Ud from existing SharedPtr (only useful for copyToState)
+LatchUserdata::LatchUserdata(const Poco::SharedPtr<LuaPoco::Latch>& latch) :
+    mLatch(latch)
+{
+}
+
+LatchUserdata::~LatchUserdata()
+{
+}
+
+bool LatchUserdata::copyToState(lua_State *L)
+{
+    registerLatch(L);
+    LatchUserdata* lud = NULL;
+    void* p = lua_newuserdata(L, sizeof *lud);
+
+    try
+    {
+        lud = new(p) LatchUserdata(mLatch);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, lud, POCO_LATCH_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool LatchUserdata::registerLatch(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "countDown", countDown },
+        { "wait", wait },
+        { "tryWait", tryWait },
+        { "count", count },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_LATCH_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new latch userdata.
+// @int count number of count downs required to release waiting threads.
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+int LatchUserdata::Latch(lua_State* L)
+{
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    lua_Integer count = luaL_checkinteger(L, firstArg);
+    if (count < 0)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "count must not be negative.");
+        return 2;
+    }
+
+    LatchUserdata* lud = NULL;
+    void* p = lua_newuserdata(L, sizeof *lud);
+
+    try
+    {
+        lud = new(p) LatchUserdata(static_cast<Poco::Int64>(count));
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    setupPocoUserdata(L, lud, POCO_LATCH_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type latch
+
+// metamethod infrastructure
+int LatchUserdata::metamethod__tostring(lua_State* L)
+{
+    LatchUserdata* lud = checkPrivateUserdata<LatchUserdata>(L, 1);
+
+    lua_pushfstring(L, "Poco.Latch (%p)", static_cast<void*>(lud));
+    return 1;
+}
+
+// userdata methods
+
+/// Decreases the count, releasing waiting threads when it reaches zero.
+// @int[opt] n amount to decrease the count by. (default: 1)
+// @return the remaining count.
+// @function countDown
+int LatchUserdata::countDown(lua_State* L)
+{
+    LatchUserdata* lud = checkPrivateUserdata<LatchUserdata>(L, 1);
+    lua_Integer n = lua_isnoneornil(L, 2) ? 1 : luaL_checkinteger(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "must not be negative");
+
+    Poco::Int64 remaining = 0;
+
+    try
+    {
+        remaining = lud->mLatch->countDown(static_cast<Poco::Int64>(n));
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    lua_pushinteger(L, static_cast<lua_Integer>(remaining));
+    return 1;
+}
+
+/// Waits for the count to reach zero.
+// @function wait
+int LatchUserdata::wait(lua_State* L)
+{
+    LatchUserdata* lud = checkPrivateUserdata<LatchUserdata>(L, 1);
+
+    try
+    {
+        lud->mLatch->wait();
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    return 0;
+}
+
+/// Waits for the count to reach zero, for up to a number of milliseconds.
+// @int ms milliseconds to wait, 0 checks the count without waiting.
+// @return boolean indicating if the count reached zero.
+// @function tryWait
+int LatchUserdata::tryWait(lua_State* L)
+{
+    LatchUserdata* lud = checkPrivateUserdata<LatchUserdata>(L, 1);
+    long ms = static_cast<long>(luaL_checkinteger(L, 2));
+    bool result = false;
+
+    try
+    {
+        result = lud->mLatch->tryWait(ms);
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    lua_pushboolean(L, result);
+    return 1;
+}
+
+/// Gets the remaining count.
+// @return count.
+// @function count
+int LatchUserdata::count(lua_State* L)
+{
+    LatchUserdata* lud = checkPrivateUserdata<LatchUserdata>(L, 1);
+    lua_pushinteger(L, static_cast<lua_Integer>(lud->mLatch->count()));
+    return 1;
+}
+
+} // LuaPoco
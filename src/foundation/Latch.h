@@ -0,0 +1,68 @@
+#ifndef LUA_POCO_LATCH_H
+#define LUA_POCO_LATCH_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_latch(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_LATCH_METATABLE_NAME;
+
+// single use countdown latch, waiters are woken once, by the count down reaching zero.
+class Latch
+{
+public:
+    Latch(Poco::Int64 count);
+    ~Latch();
+
+    // returns the remaining count, which does not go below zero.
+    Poco::Int64 countDown(Poco::Int64 n);
+    void wait();
+    // returns false if the count did not reach zero within ms milliseconds.
+    bool tryWait(long ms);
+    Poco::Int64 count();
+
+private:
+    Poco::FastMutex mMutex;
+    Poco::Condition mCondition;
+    Poco::Int64 mCount;
+};
+
+class LatchUserdata : public Userdata
+{
+public:
+    LatchUserdata(Poco::Int64 count);
+    LatchUserdata(const Poco::SharedPtr<Latch>& latch);
+    virtual ~LatchUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerLatch(lua_State* L);
+    // constructor function
+    static int Latch(lua_State* L);
+
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+
+    // userdata methods
+    static int countDown(lua_State* L);
+    static int wait(lua_State* L);
+    static int tryWait(lua_State* L);
+    static int count(lua_State* L);
+
+    Poco::SharedPtr<LuaPoco::Latch> mLatch;
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,328 @@
+/// MessagePack encoding and decoding
+// Encoding Lua values to MessagePack strings, and decoding MessagePack to Lua values.
+//
+// Tables are encoded as by json.encode: tables with a value at [1] are arrays, and other tables are maps.
+// Unlike JSON, integers and floats are kept distinct, strings may hold any bytes, and maps may have number
+// and boolean keys. The json null, emptyArray and emptyObject sentinels encode nil, empty arrays and empty maps,
+// and nil is decoded as the null sentinel. Floats are written as 32 bit floats when that holds the value exactly.
+// @module msgpack
+
+#include "MsgPack.h"
+#include "JSON.h"
+#include <Poco/Exception.h>
+#include <cfloat>
+#include <cstring>
+
+int luaopen_poco_msgpack(lua_State* L)
+{
+    struct LuaPoco::CFunctions methods[] =
+    {
+        { "encode", LuaPoco::MsgPack::encode },
+        { "encodeTo", LuaPoco::MsgPack::encodeTo },
+        { "decode", LuaPoco::MsgPack::decode },
+        { "null", LuaPoco::JSON::getNull },
+        { "emptyObject", LuaPoco::JSON::getEmptyObject },
+        { "emptyArray", LuaPoco::JSON::getEmptyArray },
+        { NULL, NULL}
+    };
+
+    lua_createtable(L, 0, 6);
+    setCFunctions(L, methods);
+
+    return 1;
+}
+
+namespace LuaPoco
+{
+
+template <>
+struct TableEncoderTraits<MsgPackWriter> : public BinaryEncoderTraits<MsgPackWriter>
+{
+    static const char* name()
+    {
+        return "msgpack";
+    }
+};
+
+MsgPackWriter::MsgPackWriter()
+{
+}
+
+MsgPackWriter::MsgPackWriter(std::ostream& sink) :
+    mOutput(sink)
+{
+}
+
+MsgPackWriter::~MsgPackWriter()
+{
+}
+
+void MsgPackWriter::startObject(size_t count)
+{
+    header(count, 0x80, 16, 0, 0xde, 0xdf);
+}
+
+void MsgPackWriter::startArray(size_t count)
+{
+    header(count, 0x90, 16, 0, 0xdc, 0xdd);
+}
+
+void MsgPackWriter::key(const char* k, size_t len)
+{
+    value(k, len);
+}
+
+void MsgPackWriter::null()
+{
+    mOutput.put(0xc0);
+}
+
+void MsgPackWriter::value(bool b)
+{
+    mOutput.put(b ? 0xc3 : 0xc2);
+}
+
+void MsgPackWriter::value(Poco::Int64 i)
+{
+    Poco::UInt64 u = static_cast<Poco::UInt64>(i);
+
+    if (i >= 0)
+    {
+        if (i < 0x80) { mOutput.put(static_cast<Poco::UInt8>(i)); }
+        else if (i <= 0xff) { mOutput.put(0xcc, u, 1); }
+        else if (i <= 0xffff) { mOutput.put(0xcd, u, 2); }
+        else if (i <= 0xffffffffLL) { mOutput.put(0xce, u, 4); }
+        else { mOutput.put(0xcf, u, 8); }
+    }
+    else
+    {
+        // negative fixint.
+        if (i >= -32) { mOutput.put(static_cast<Poco::UInt8>(u)); }
+        else if (i >= -128) { mOutput.put(0xd0, u, 1); }
+        else if (i >= -32768) { mOutput.put(0xd1, u, 2); }
+        else if (i >= -2147483647LL - 1) { mOutput.put(0xd2, u, 4); }
+        else { mOutput.put(0xd3, u, 8); }
+    }
+}
+
+void MsgPackWriter::value(double d)
+{
+    if (d >= -FLT_MAX && d <= FLT_MAX && static_cast<double>(static_cast<float>(d)) == d)
+    {
+        float f = static_cast<float>(d);
+        Poco::UInt32 bits = 0;
+        std::memcpy(&bits, &f, sizeof f);
+        mOutput.put(0xca, bits, 4);
+    }
+    else
+    {
+        Poco::UInt64 bits = 0;
+        std::memcpy(&bits, &d, sizeof d);
+        mOutput.put(0xcb, bits, 8);
+    }
+}
+
+void MsgPackWriter::value(const char* s, size_t len)
+{
+    header(len, 0xa0, 32, 0xd9, 0xda, 0xdb);
+    mOutput.write(s, len);
+}
+
+void MsgPackWriter::flush()
+{
+    mOutput.flush();
+}
+
+const char* MsgPackWriter::data() const
+{
+    return mOutput.data();
+}
+
+size_t MsgPackWriter::size() const
+{
+    return mOutput.size();
+}
+
+// type8 is 0 for maps and arrays, which have no 8 bit length form.
+void MsgPackWriter::header(size_t n, Poco::UInt8 fixType, size_t fixLimit, Poco::UInt8 type8, Poco::UInt8 type16, Poco::UInt8 type32)
+{
+    if (n < fixLimit) { mOutput.put(static_cast<Poco::UInt8>(fixType | n)); }
+    else if (type8 && n <= 0xff) { mOutput.put(type8, n, 1); }
+    else if (n <= 0xffff) { mOutput.put(type16, n, 2); }
+    else if (static_cast<Poco::UInt64>(n) <= 0xffffffffULL) { mOutput.put(type32, n, 4); }
+    else { throw Poco::DataFormatException("msgpack maps, arrays and strings are limited to 2^32 - 1 entries."); }
+}
+
+MsgPackReader::MsgPackReader(BinaryInput& input) :
+    BinaryReader(input)
+{
+}
+
+MsgPackReader::~MsgPackReader()
+{
+}
+
+void MsgPackReader::next(BinaryItem& item)
+{
+    size_t start = mInput.offset();
+    Poco::UInt8 b = mInput.readByte();
+
+    item.type = BinaryItem::INTEGER;
+
+    // positive fixint, fixmap, fixarray, fixstr and negative fixint.
+    if (b <= 0x7f) { item.integer = b; }
+    else if (b <= 0x8f) { readContainer(item, BinaryItem::MAP, b & 0x0f); }
+    else if (b <= 0x9f) { readContainer(item, BinaryItem::ARRAY, b & 0x0f); }
+    else if (b <= 0xbf) { readString(item, b & 0x1f); }
+    else if (b >= 0xe0) { item.integer = static_cast<Poco::Int8>(b); }
+    else
+    {
+        switch (b)
+        {
+        case 0xc0:
+            item.type = BinaryItem::NUL;
+            break;
+        case 0xc2:
+        case 0xc3:
+            item.type = BinaryItem::BOOLEAN;
+            item.boolean = b == 0xc3;
+            break;
+        // bin and str.
+        case 0xc4:
+        case 0xd9:
+            readString(item, static_cast<size_t>(mInput.readValue(1)));
+            break;
+        case 0xc5:
+        case 0xda:
+            readString(item, static_cast<size_t>(mInput.readValue(2)));
+            break;
+        case 0xc6:
+        case 0xdb:
+            readString(item, static_cast<size_t>(mInput.readValue(4)));
+            break;
+        case 0xca:
+        {
+            Poco::UInt32 bits = static_cast<Poco::UInt32>(mInput.readValue(4));
+            float f = 0;
+            std::memcpy(&f, &bits, sizeof f);
+            item.type = BinaryItem::NUMBER;
+            item.number = f;
+            break;
+        }
+        case 0xcb:
+        {
+            Poco::UInt64 bits = mInput.readValue(8);
+            item.type = BinaryItem::NUMBER;
+            std::memcpy(&item.number, &bits, sizeof item.number);
+            break;
+        }
+        case 0xcc:
+            item.integer = static_cast<Poco::Int64>(mInput.readValue(1));
+            break;
+        case 0xcd:
+            item.integer = static_cast<Poco::Int64>(mInput.readValue(2));
+            break;
+        case 0xce:
+            item.integer = static_cast<Poco::Int64>(mInput.readValue(4));
+            break;
+        case 0xcf:
+        {
+            // integers beyond the range of Int64 are read as floats.
+            Poco::UInt64 u = mInput.readValue(8);
+            if (u > 0x7fffffffffffffffULL)
+            {
+                item.type = BinaryItem::NUMBER;
+                item.number = static_cast<double>(u);
+            }
+            else { item.integer = static_cast<Poco::Int64>(u); }
+            break;
+        }
+        case 0xd0:
+            item.integer = static_cast<Poco::Int8>(mInput.readValue(1));
+            break;
+        case 0xd1:
+            item.integer = static_cast<Poco::Int16>(mInput.readValue(2));
+            break;
+        case 0xd2:
+            item.integer = static_cast<Poco::Int32>(mInput.readValue(4));
+            break;
+        case 0xd3:
+            item.integer = static_cast<Poco::Int64>(mInput.readValue(8));
+            break;
+        case 0xdc:
+            readContainer(item, BinaryItem::ARRAY, static_cast<size_t>(mInput.readValue(2)));
+            break;
+        case 0xdd:
+            readContainer(item, BinaryItem::ARRAY, static_cast<size_t>(mInput.readValue(4)));
+            break;
+        case 0xde:
+            readContainer(item, BinaryItem::MAP, static_cast<size_t>(mInput.readValue(2)));
+            break;
+        case 0xdf:
+            readContainer(item, BinaryItem::MAP, static_cast<size_t>(mInput.readValue(4)));
+            break;
+        case 0xc1:
+            mInput.fail("invalid msgpack type", start);
+            break;
+        default:
+            mInput.fail("msgpack extension types are not supported", start);
+            break;
+        }
+    }
+}
+
+void MsgPackReader::readString(BinaryItem& item, size_t len)
+{
+    item.type = BinaryItem::STRING;
+    item.count = len;
+    item.string = mInput.read(len);
+}
+
+void MsgPackReader::readContainer(BinaryItem& item, BinaryItem::Type type, size_t count)
+{
+    item.type = type;
+    item.count = count;
+}
+
+/// encodes a value as a MessagePack string.
+// @param value table, string, number, boolean, or json sentinel value to encode.
+// @return value as string or nil. (error)
+// @return error message.
+// @function encode
+int MsgPack::encode(lua_State* L)
+{
+    return encodeBinary<MsgPackWriter>(L);
+}
+
+/// encodes a value as MessagePack, written to an ostream.
+// The output is written in chunks as it is encoded, such that memory use does not grow with the size of the
+// value. On error, the part of the value encoded before the error may have been written.
+// @param ostream ostream userdata, such as a fileostream, pipeostream, teeostream or deflatingostream.
+// @param value table, string, number, boolean, or json sentinel value to encode.
+// @return true or nil. (error)
+// @return error message.
+// @function encodeTo
+// @see ostream
+int MsgPack::encodeTo(lua_State* L)
+{
+    return encodeBinaryTo<MsgPackWriter>(L);
+}
+
+/// decodes a MessagePack value.
+// The value can be read from a string, from an istream, or from the memory of a buffer or sharedmemory.
+// A string or istream must hold nothing but the value, while anything following the value in the memory of a
+// buffer or sharedmemory is ignored. An istream is read in chunks as the value is decoded.
+// Errors include the byte offset in the input at which the value is invalid.
+// @param input string, istream userdata, buffer userdata or sharedmemory userdata.
+// @return value or nil. (error)
+// @return error message.
+// @function decode
+// @see istream
+// @see buffer
+// @see sharedmemory
+int MsgPack::decode(lua_State* L)
+{
+    return decodeBinary<MsgPackReader>(L);
+}
+
+} // LuaPoco
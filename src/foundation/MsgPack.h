@@ -0,0 +1,76 @@
+#ifndef LUA_POCO_MSGPACK_H
+#define LUA_POCO_MSGPACK_H
+
+#include "LuaPoco.h"
+#include "BinaryCodec.h"
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_msgpack(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+// writes MessagePack, using the smallest encoding of each value.
+class MsgPackWriter
+{
+public:
+    MsgPackWriter();
+    // writes the output to sink in chunks, whenever the buffer is full and on flush().
+    MsgPackWriter(std::ostream& sink);
+    ~MsgPackWriter();
+
+    void startObject(size_t count);
+    void endObject() {}
+    void startArray(size_t count);
+    void endArray() {}
+    void key(const char* k, size_t len);
+    void null();
+    void value(bool b);
+    void value(Poco::Int64 i);
+    // written as a 32 bit float when it holds the value exactly.
+    void value(double d);
+    void value(const char* s, size_t len);
+
+    // writes the buffered output to the sink, throws if the write fails.
+    void flush();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    MsgPackWriter(const MsgPackWriter&);
+    MsgPackWriter& operator=(const MsgPackWriter&);
+
+    // writes the header of a map, array or string of n members, elements or bytes.
+    void header(size_t n, Poco::UInt8 fixType, size_t fixLimit, Poco::UInt8 type8, Poco::UInt8 type16, Poco::UInt8 type32);
+
+    BinaryOutput mOutput;
+};
+
+// reads MessagePack data items. bin values are read as strings, extension types are not supported.
+class MsgPackReader : public BinaryReader
+{
+public:
+    MsgPackReader(BinaryInput& input);
+    virtual ~MsgPackReader();
+
+    virtual void next(BinaryItem& item);
+
+private:
+    void readString(BinaryItem& item, size_t len);
+    void readContainer(BinaryItem& item, BinaryItem::Type type, size_t count);
+};
+
+namespace MsgPack
+{
+
+int encode(lua_State* L);
+int encodeTo(lua_State* L);
+int decode(lua_State* L);
+
+}
+} // LuaPoco
+
+#endif
@@ -1,6 +1,8 @@
 /// Synchronization mechanism used to control access to a shared resource.
 // Note: Mutexes are recursive, that is, the same mutex can be locked multiple times by the same thread (but, of course, not by other threads).  Also note that recursive mutexes are heavier and slower than the fastmutex module.
 // Note: mutex userdata are copyable/sharable between threads.
+//
+// A mutex can optionally be profiled to find contended locks, see new and stats.
 // @module mutex
 
 #include "Mutex.h"
@@ -17,14 +19,16 @@ namespace LuaPoco
 
 const char* POCO_MUTEX_METATABLE_NAME = "Poco.Mutex.metatable";
 
-MutexUserdata::MutexUserdata() :
-    mMutex(new Poco::Mutex())
+MutexUserdata::MutexUserdata(const Poco::SharedPtr<LockProfile>& profile) :
+    mMutex(new Poco::Mutex()),
+    mProfile(profile)
 {
 }
 
 // construct new Ud from existing SharedPtr (only useful for 
-MutexUserdata::MutexUserdata(const Poco::SharedPtr<Poco::Mutex>& fm) :
-    mMutex(fm)
+MutexUserdata::MutexUserdata(const Poco::SharedPtr<Poco::Mutex>& fm, const Poco::SharedPtr<LockProfile>& profile) :
+    mMutex(fm),
+    mProfile(profile)
 {
 }
 
@@ -40,7 +44,7 @@ bool MutexUserdata::copyToState(lua_State *L)
     
     try
     {
-        mud = new(p) MutexUserdata(mMutex);
+        mud = new(p) MutexUserdata(mMutex, mProfile);
     }
     catch (const std::exception& e)
     {
@@ -62,6 +66,7 @@ bool MutexUserdata::registerMutex(lua_State* L)
         { "lock", lock },
         { "tryLock", tryLock },
         { "unlock", unlock },
+        { "stats", stats },
         { NULL, NULL}
     };
 
@@ -70,17 +75,22 @@ bool MutexUserdata::registerMutex(lua_State* L)
 }
 
 /// create a new mutex userdata.
+// @param[opt] profile true to count acquisitions, contention, wait and hold times, or a name to add them
+// to the counts of all mutexes, fastmutexes, and semaphores profiled with the same name.
 // @return userdata or nil. (error)
 // @return error message.
 // @function new
 int MutexUserdata::Mutex(lua_State* L)
 {
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    Poco::SharedPtr<LockProfile> profile = readLockProfile(L, firstArg, true);
+
     MutexUserdata* mud = NULL;
     void* p = lua_newuserdata(L, sizeof *mud);
     
     try
     {
-        mud = new(p) MutexUserdata();
+        mud = new(p) MutexUserdata(profile);
     }
     catch (const std::exception& e)
     {
@@ -114,7 +124,8 @@ int MutexUserdata::lock(lua_State* L)
     
     try
     {
-        mud->mMutex->lock();
+        if (mud->mProfile.isNull()) { mud->mMutex->lock(); }
+        else { mud->mProfile->lock(*mud->mMutex); }
     }
     catch (const std::exception& e)
     {
@@ -143,7 +154,9 @@ int MutexUserdata::tryLock(lua_State* L)
     try
     {
         bool result = false;
-        if (top > 1)
+        if (!mud->mProfile.isNull())
+            result = mud->mProfile->tryLock(*mud->mMutex, top > 1 ? ms : 0);
+        else if (top > 1)
             result = mud->mMutex->tryLock(ms);
         else
             result = mud->mMutex->tryLock();
@@ -168,7 +181,8 @@ int MutexUserdata::unlock(lua_State* L)
     
     try
     {
-        mud->mMutex->unlock();
+        if (mud->mProfile.isNull()) { mud->mMutex->unlock(); }
+        else { mud->mProfile->unlock(*mud->mMutex); }
         lua_pushboolean(L, 1);
         rv = 1;
     }
@@ -180,4 +194,18 @@ int MutexUserdata::unlock(lua_State* L)
     return rv;
 }
 
+/// Gets the profiling counts of the mutex, or of all locks sharing its profile name.
+// Times are in microseconds. The counts are shared by all copies of the mutex, and recursive acquisitions
+// are timed as held from the outermost lock to the matching unlock.
+// Note: waiting on a condition with the mutex is counted as holding it.
+// @return table with the fields: name, acquisitions, contended (acquisitions which had to wait), failed
+// (tryLock calls which did not acquire the mutex), waitTime, maxWait, holdTime and maxHold.
+// Or nil and an error message if the mutex was not constructed with profiling.
+// @function stats
+int MutexUserdata::stats(lua_State* L)
+{
+    MutexUserdata* mud = checkPrivateUserdata<MutexUserdata>(L, 1);
+    return pushLockStats(L, mud->mProfile);
+}
+
 } // LuaPoco
@@ -3,6 +3,7 @@
 
 #include "LuaPoco.h"
 #include "Userdata.h"
+#include "LockProfile.h"
 #include <Poco/Mutex.h>
 #include <Poco/SharedPtr.h>
 
@@ -19,8 +20,8 @@ extern const char* POCO_MUTEX_METATABLE_NAME;
 class MutexUserdata : public Userdata
 {
 public:
-    MutexUserdata();
-    MutexUserdata(const Poco::SharedPtr<Poco::Mutex>& mtx);
+    MutexUserdata(const Poco::SharedPtr<LockProfile>& profile);
+    MutexUserdata(const Poco::SharedPtr<Poco::Mutex>& mtx, const Poco::SharedPtr<LockProfile>& profile);
     virtual ~MutexUserdata();
     virtual bool copyToState(lua_State *L);
     // register metatable for this class
@@ -29,6 +30,8 @@ public:
     static int Mutex(lua_State* L);
     
     Poco::SharedPtr<Poco::Mutex> mMutex;
+    // null unless profiling was requested at construction.
+    Poco::SharedPtr<LockProfile> mProfile;
 private:
     // metamethod infrastructure
     static int metamethod__tostring(lua_State* L);
@@ -37,6 +40,7 @@ private:
     static int lock(lua_State* L);
     static int tryLock(lua_State* L);
     static int unlock(lua_State* L);
+    static int stats(lua_State* L);
 };
 
 } // LuaPoco
@@ -0,0 +1,290 @@
+/// Reader/writer lock used to control access to a shared resource.
+// Any number of threads may hold the lock for reading at once, while a thread holding the lock for writing
+// excludes all other threads. This suits data which is read often and rarely modified.
+//
+// Depending on the platform, a steady stream of readers can keep a writer waiting indefinitely. A writer
+// preferring rwlock prevents this by holding back new readers while a writer is waiting, at the cost of an
+// extra mutex operation per lock.
+//
+// Note: the lock is not recursive, a thread must not lock it again before unlocking it.
+// Note: rwlock userdata are copyable/sharable between threads.
+// @module rwlock
+
+#include "RWLock.h"
+#include <Poco/Exception.h>
+#include <Poco/ScopedLock.h>
+
+int luaopen_poco_rwlock(lua_State* L)
+{
+    LuaPoco::RWLockUserdata::registerRWLock(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::RWLockUserdata::RWLock);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_RWLOCK_METATABLE_NAME = "Poco.RWLock.metatable";
+
+SharedRWLock::SharedRWLock(bool preferWriter) :
+    mPreferWriter(preferWriter)
+{
+}
+
+SharedRWLock::~SharedRWLock()
+{
+}
+
+void SharedRWLock::readLock()
+{
+    if (mPreferWriter)
+    {
+        // blocks while a writer is waiting for the lock.
+        Poco::ScopedLock<Poco::FastMutex> turnstile(mTurnstile);
+    }
+
+    mLock.readLock();
+}
+
+bool SharedRWLock::tryReadLock()
+{
+    if (mPreferWriter)
+    {
+        if (!mTurnstile.tryLock()) { return false; }
+        mTurnstile.unlock();
+    }
+
+    return mLock.tryReadLock();
+}
+
+void SharedRWLock::writeLock()
+{
+    if (mPreferWriter)
+    {
+        Poco::ScopedLock<Poco::FastMutex> turnstile(mTurnstile);
+        mLock.writeLock();
+    }
+    else { mLock.writeLock(); }
+}
+
+bool SharedRWLock::tryWriteLock()
+{
+    if (mPreferWriter)
+    {
+        if (!mTurnstile.tryLock()) { return false; }
+        bool result = false;
+
+        try
+        {
+            result = mLock.tryWriteLock();
+        }
+        catch (...)
+        {
+            mTurnstile.unlock();
+            throw;
+        }
+
+        mTurnstile.unlock();
+        return result;
+    }
+
+    return mLock.tryWriteLock();
+}
+
+void SharedRWLock::unlock()
+{
+    mLock.unlock();
+}
+
+RWLockUserdata::RWLockUserdata(bool preferWriter) :
+    mRWLock(new SharedRWLock(preferWriter))
+{
+}
+
+// construct new Ud from existing SharedPtr (only useful for copyToState)
+RWLockUserdata::RWLockUserdata(const Poco::SharedPtr<SharedRWLock>& rwl) :
+    mRWLock(rwl)
+{
+}
+
+RWLockUserdata::~RWLockUserdata()
+{
+}
+
+bool RWLockUserdata::copyToState(lua_State *L)
+{
+    registerRWLock(L);
+    RWLockUserdata* rwlud = NULL;
+    void* p = lua_newuserdata(L, sizeof *rwlud);
+
+    try
+    {
+        rwlud = new(p) RWLockUserdata(mRWLock);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, rwlud, POCO_RWLOCK_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool RWLockUserdata::registerRWLock(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "readLock", readLock },
+        { "tryReadLock", tryReadLock },
+        { "writeLock", writeLock },
+        { "tryWriteLock", tryWriteLock },
+        { "unlock", unlock },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_RWLOCK_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new rwlock userdata.
+// @bool[opt] preferWriter when true, readers arriving while a writer is waiting wait for the writer. (default: false)
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+int RWLockUserdata::RWLock(lua_State* L)
+{
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    bool preferWriter = lua_toboolean(L, firstArg) != 0;
+
+    RWLockUserdata* rwlud = NULL;
+    void* p = lua_newuserdata(L, sizeof *rwlud);
+
+    try
+    {
+        rwlud = new(p) RWLockUserdata(preferWriter);
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    setupPocoUserdata(L, rwlud, POCO_RWLOCK_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type rwlock
+
+// metamethod infrastructure
+int RWLockUserdata::metamethod__tostring(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+    lua_pushfstring(L, "Poco.RWLock (%p)", static_cast<void*>(rwlud));
+    return 1;
+}
+
+// userdata methods
+
+/// Acquires the lock for reading. Blocks while the lock is held for writing.
+// @function readLock
+int RWLockUserdata::readLock(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+
+    try
+    {
+        rwlud->mRWLock->readLock();
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    return 0;
+}
+
+/// Attempts to acquire the lock for reading without blocking.
+// @return boolean indicating if the lock was acquired.
+// @function tryReadLock
+int RWLockUserdata::tryReadLock(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+    bool result = false;
+
+    try
+    {
+        result = rwlud->mRWLock->tryReadLock();
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    lua_pushboolean(L, result);
+    return 1;
+}
+
+/// Acquires the lock for writing. Blocks while the lock is held for reading or writing.
+// @function writeLock
+int RWLockUserdata::writeLock(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+
+    try
+    {
+        rwlud->mRWLock->writeLock();
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    return 0;
+}
+
+/// Attempts to acquire the lock for writing without blocking.
+// @return boolean indicating if the lock was acquired.
+// @function tryWriteLock
+int RWLockUserdata::tryWriteLock(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+    bool result = false;
+
+    try
+    {
+        result = rwlud->mRWLock->tryWriteLock();
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    lua_pushboolean(L, result);
+    return 1;
+}
+
+/// Releases the lock, whether held for reading or writing.
+// @function unlock
+int RWLockUserdata::unlock(lua_State* L)
+{
+    RWLockUserdata* rwlud = checkPrivateUserdata<RWLockUserdata>(L, 1);
+
+    try
+    {
+        rwlud->mRWLock->unlock();
+    }
+    catch (const std::exception& e)
+    {
+        pushException(L, e);
+        lua_error(L);
+    }
+
+    return 0;
+}
+
+} // LuaPoco
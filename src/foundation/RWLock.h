@@ -0,0 +1,68 @@
+#ifndef LUA_POCO_RWLOCK_H
+#define LUA_POCO_RWLOCK_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/RWLock.h>
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_rwlock(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_RWLOCK_METATABLE_NAME;
+
+// Poco::RWLock, optionally preferring writers.
+// a writer preferring lock passes all lock attempts through a turnstile mutex, which a writer holds while
+// waiting for the lock, such that readers arriving after a waiting writer queue behind it.
+class SharedRWLock
+{
+public:
+    SharedRWLock(bool preferWriter);
+    ~SharedRWLock();
+
+    void readLock();
+    bool tryReadLock();
+    void writeLock();
+    bool tryWriteLock();
+    void unlock();
+
+private:
+    Poco::RWLock mLock;
+    Poco::FastMutex mTurnstile;
+    bool mPreferWriter;
+};
+
+class RWLockUserdata : public Userdata
+{
+public:
+    RWLockUserdata(bool preferWriter);
+    RWLockUserdata(const Poco::SharedPtr<SharedRWLock>& rwl);
+    virtual ~RWLockUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerRWLock(lua_State* L);
+    // constructor function
+    static int RWLock(lua_State* L);
+
+    Poco::SharedPtr<SharedRWLock> mRWLock;
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+
+    // userdata methods
+    static int readLock(lua_State* L);
+    static int tryReadLock(lua_State* L);
+    static int writeLock(lua_State* L);
+    static int tryWriteLock(lua_State* L);
+    static int unlock(lua_State* L);
+};
+
+} // LuaPoco
+
+#endif
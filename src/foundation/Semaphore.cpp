@@ -7,10 +7,13 @@
 // The calling thread may continue when the value becomes positive again. 
 //
 // Note: semaphore userdata are sharable between threads.
+//
+// A semaphore can optionally be profiled to find contended waits, see new and stats.
 // @module semaphore
 
 #include "Semaphore.h"
 #include <Poco/Exception.h>
+#include <Poco/Clock.h>
 
 int luaopen_poco_semaphore(lua_State* L)
 {
@@ -23,19 +26,22 @@ namespace LuaPoco
 
 const char* POCO_SEMAPHORE_METATABLE_NAME = "Poco.Semaphore.metatable";
 
-SemaphoreUserdata::SemaphoreUserdata(int n) :
-    mSemaphore(new Poco::Semaphore(n))
+SemaphoreUserdata::SemaphoreUserdata(int n, const Poco::SharedPtr<LockProfile>& profile) :
+    mSemaphore(new Poco::Semaphore(n)),
+    mProfile(profile)
 {
 }
 
-SemaphoreUserdata::SemaphoreUserdata(int n, int max) :
-    mSemaphore(new Poco::Semaphore(n, max))
+SemaphoreUserdata::SemaphoreUserdata(int n, int max, const Poco::SharedPtr<LockProfile>& profile) :
+    mSemaphore(new Poco::Semaphore(n, max)),
+    mProfile(profile)
 {
 }
 
 // construct new Ud from existing SharedPtr (only useful for 
-SemaphoreUserdata::SemaphoreUserdata(const Poco::SharedPtr<Poco::Semaphore>& sem) :
-    mSemaphore(sem)
+SemaphoreUserdata::SemaphoreUserdata(const Poco::SharedPtr<Poco::Semaphore>& sem, const Poco::SharedPtr<LockProfile>& profile) :
+    mSemaphore(sem),
+    mProfile(profile)
 {
 }
 
@@ -51,7 +57,7 @@ bool SemaphoreUserdata::copyToState(lua_State *L)
     
     try
     {
-        sud = new(p) SemaphoreUserdata(mSemaphore);
+        sud = new(p) SemaphoreUserdata(mSemaphore, mProfile);
     }
     catch (const std::exception& e)
     {
@@ -73,6 +79,7 @@ bool SemaphoreUserdata::registerSemaphore(lua_State* L)
         { "set", set },
         { "tryWait", tryWait },
         { "wait", wait },
+        { "stats", stats },
         { NULL, NULL}
     };
     
@@ -83,25 +90,28 @@ bool SemaphoreUserdata::registerSemaphore(lua_State* L)
 /// constructs a new semaphore userdata.
 // @int n current value of the semaphore.
 // @int[opt] max optional maximum value of the semaphore.
+// @param[opt] profile true to count waits, contended waits, and wait times, or a name to add them
+// to the counts of all mutexes, fastmutexes, and semaphores profiled with the same name.
 // @return userdata or nil. (error)
 // @return error message.
 // @function new
 int SemaphoreUserdata::Semaphore(lua_State* L)
 {
     int firstArg = lua_istable(L, 1) ? 2 : 1;
-    int top = lua_gettop(L);
     int max = 0;
     int n = luaL_checkinteger(L, firstArg);
-    if (top > firstArg)
+    bool hasMax = lua_type(L, firstArg + 1) == LUA_TNUMBER;
+    if (hasMax)
         max = luaL_checkinteger(L, firstArg + 1);
+    Poco::SharedPtr<LockProfile> profile = readLockProfile(L, hasMax ? firstArg + 2 : firstArg + 1, false);
     
     SemaphoreUserdata* sud = NULL;
     void* p = lua_newuserdata(L, sizeof *sud);
     
     try
     {
-        if (top > firstArg) { sud = new(p) SemaphoreUserdata(n, max); }
-        else { sud = new(p) SemaphoreUserdata(n); }
+        if (hasMax) { sud = new(p) SemaphoreUserdata(n, max, profile); }
+        else { sud = new(p) SemaphoreUserdata(n, profile); }
     }
     catch (const std::exception& e)
     {
@@ -159,7 +169,20 @@ int SemaphoreUserdata::tryWait(lua_State* L)
     
     try
     {
-        bool result = sud->mSemaphore->tryWait(ms);
+        bool result = false;
+        if (sud->mProfile.isNull()) { result = sud->mSemaphore->tryWait(ms); }
+        else if (sud->mSemaphore->tryWait(0))
+        {
+            sud->mProfile->acquired(false, 0);
+            result = true;
+        }
+        else
+        {
+            Poco::Clock start;
+            result = ms > 0 && sud->mSemaphore->tryWait(ms);
+            if (result) { sud->mProfile->acquired(true, start.elapsed()); }
+            else { sud->mProfile->failed(); }
+        }
         lua_pushboolean(L, result);
         rv = 1;
     }
@@ -181,7 +204,14 @@ int SemaphoreUserdata::wait(lua_State* L)
     
     try
     {
-        sud->mSemaphore->wait();
+        if (sud->mProfile.isNull()) { sud->mSemaphore->wait(); }
+        else if (sud->mSemaphore->tryWait(0)) { sud->mProfile->acquired(false, 0); }
+        else
+        {
+            Poco::Clock start;
+            sud->mSemaphore->wait();
+            sud->mProfile->acquired(true, start.elapsed());
+        }
     }
     catch (const std::exception& e)
     {
@@ -192,4 +222,16 @@ int SemaphoreUserdata::wait(lua_State* L)
     return rv;
 }
 
+/// Gets the profiling counts of the semaphore, or of all locks sharing its profile name.
+// Times are in microseconds. The counts are shared by all copies of the semaphore.
+// @return table with the fields: name, acquisitions (successful waits), contended (waits which blocked),
+// failed (tryWait calls which timed out), waitTime and maxWait.
+// Or nil and an error message if the semaphore was not constructed with profiling.
+// @function stats
+int SemaphoreUserdata::stats(lua_State* L)
+{
+    SemaphoreUserdata* sud = checkPrivateUserdata<SemaphoreUserdata>(L, 1);
+    return pushLockStats(L, sud->mProfile);
+}
+
 } // LuaPoco
@@ -3,6 +3,7 @@
 
 #include "LuaPoco.h"
 #include "Userdata.h"
+#include "LockProfile.h"
 #include <Poco/Semaphore.h>
 #include <Poco/SharedPtr.h>
 
@@ -19,9 +20,9 @@ extern const char* POCO_SEMAPHORE_METATABLE_NAME;
 class SemaphoreUserdata : public Userdata
 {
 public:
-    SemaphoreUserdata(int n);
-    SemaphoreUserdata(int n, int max);
-    SemaphoreUserdata(const Poco::SharedPtr<Poco::Semaphore>& sem);
+    SemaphoreUserdata(int n, const Poco::SharedPtr<LockProfile>& profile);
+    SemaphoreUserdata(int n, int max, const Poco::SharedPtr<LockProfile>& profile);
+    SemaphoreUserdata(const Poco::SharedPtr<Poco::Semaphore>& sem, const Poco::SharedPtr<LockProfile>& profile);
     virtual ~SemaphoreUserdata();
     virtual bool copyToState(lua_State *L);
     // register metatable for this class
@@ -37,8 +38,11 @@ private:
     static int set(lua_State* L);
     static int tryWait(lua_State* L);
     static int wait(lua_State* L);
+    static int stats(lua_State* L);
     
     Poco::SharedPtr<Poco::Semaphore> mSemaphore;
+    // null unless profiling was requested at construction.
+    Poco::SharedPtr<LockProfile> mProfile;
 };
 
 } // LuaPoco
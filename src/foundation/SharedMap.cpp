@@ -0,0 +1,513 @@
+/// Concurrent hash map shared between threads.
+// A sharedmap holds booleans, numbers, and strings as both keys and values. The map is split into a number of
+// shards, each guarded by its own lock, so threads updating different keys rarely wait on each other.
+// Keys follow Lua's rules, such that 1 and 1.0 are the same key.
+//
+// Note: sharedmap userdata are copyable/sharable between threads, all copies refer to the same map.
+// @module sharedmap
+
+#include "SharedMap.h"
+#include "LuaPocoUtils.h"
+#include <Poco/Exception.h>
+#include <Poco/ScopedLock.h>
+#include <functional>
+
+int luaopen_poco_sharedmap(lua_State* L)
+{
+    LuaPoco::SharedMapUserdata::registerSharedMap(L);
+    return LuaPoco::loadConstructor(L, LuaPoco::SharedMapUserdata::SharedMap);
+}
+
+namespace LuaPoco
+{
+
+const char* POCO_SHAREDMAP_METATABLE_NAME = "Poco.SharedMap.metatable";
+
+namespace
+{
+
+const size_t DEFAULT_SHARDS = 16;
+const size_t MAX_SHARDS = 4096;
+
+Poco::UInt64 mix(Poco::UInt64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool toInteger(double n, Poco::Int64& integer)
+{
+    if (n >= -9223372036854775808.0 && n < 9223372036854775808.0 && n == static_cast<double>(static_cast<Poco::Int64>(n)))
+    {
+        integer = static_cast<Poco::Int64>(n);
+        return true;
+    }
+
+    return false;
+}
+
+// raises an error for values which cannot be held by the map, such that readValue cannot fail.
+void checkValue(lua_State* L, int index, bool isKey)
+{
+    int type = lua_type(L, index);
+    if (type == LUA_TBOOLEAN || type == LUA_TSTRING) { return; }
+    if (type == LUA_TNIL && !isKey) { return; }
+    if (type == LUA_TNUMBER)
+    {
+        lua_Number n = lua_tonumber(L, index);
+        if (isKey && n != n) { luaL_argerror(L, index, "key is NaN"); }
+        return;
+    }
+
+    lua_pushfstring(L, "unsupported %s type: %s", isKey ? "key" : "value", luaL_typename(L, index));
+    luaL_argerror(L, index, lua_tostring(L, -1));
+}
+
+// keys with an integral value are read as integers, such that 1 and 1.0 are the same key.
+void readValue(lua_State* L, int index, SharedMap::Value& value, bool isKey)
+{
+    switch (lua_type(L, index))
+    {
+    case LUA_TBOOLEAN:
+        value.type = SharedMap::Value::BOOLEAN;
+        value.boolean = lua_toboolean(L, index) != 0;
+        break;
+    case LUA_TNUMBER:
+#if LUA_VERSION_NUM > 502
+        if (lua_isinteger(L, index))
+        {
+            value.type = SharedMap::Value::INTEGER;
+            value.integer = static_cast<Poco::Int64>(lua_tointeger(L, index));
+            break;
+        }
+#endif
+        value.number = static_cast<double>(lua_tonumber(L, index));
+        if (isKey && toInteger(value.number, value.integer)) { value.type = SharedMap::Value::INTEGER; }
+        else { value.type = SharedMap::Value::NUMBER; }
+        break;
+    case LUA_TSTRING:
+    {
+        size_t len = 0;
+        const char* str = lua_tolstring(L, index, &len);
+        value.type = SharedMap::Value::STRING;
+        value.string.assign(str, len);
+        break;
+    }
+    default:
+        value.type = SharedMap::Value::NIL;
+        break;
+    }
+}
+
+void pushValue(lua_State* L, const SharedMap::Value& value)
+{
+    switch (value.type)
+    {
+    case SharedMap::Value::BOOLEAN:
+        lua_pushboolean(L, value.boolean);
+        break;
+    case SharedMap::Value::INTEGER:
+        pushInteger(L, value.integer);
+        break;
+    case SharedMap::Value::NUMBER:
+        lua_pushnumber(L, static_cast<lua_Number>(value.number));
+        break;
+    case SharedMap::Value::STRING:
+        lua_pushlstring(L, value.string.data(), value.string.size());
+        break;
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+}
+
+SharedMap::Value::Value() :
+    type(NIL),
+    integer(0)
+{
+}
+
+// integers and numbers compare by value, as they do in Lua.
+bool SharedMap::Value::operator==(const Value& other) const
+{
+    if (type == INTEGER && other.type == NUMBER) { return other == *this; }
+    if (type == NUMBER && other.type == INTEGER)
+    {
+        Poco::Int64 i = 0;
+        return toInteger(number, i) && i == other.integer;
+    }
+    if (type != other.type) { return false; }
+
+    switch (type)
+    {
+    case BOOLEAN: return boolean == other.boolean;
+    case INTEGER: return integer == other.integer;
+    case NUMBER: return number == other.number;
+    case STRING: return string == other.string;
+    default: return true;
+    }
+}
+
+// only used for keys, where integral numbers have been read as integers.
+size_t SharedMap::ValueHash::operator()(const Value& value) const
+{
+    switch (value.type)
+    {
+    case Value::BOOLEAN: return value.boolean ? 1 : 2;
+    case Value::INTEGER: return static_cast<size_t>(mix(static_cast<Poco::UInt64>(value.integer)));
+    case Value::NUMBER: return std::hash<double>()(value.number);
+    case Value::STRING: return std::hash<std::string>()(value.string);
+    default: return 0;
+    }
+}
+
+SharedMap::SharedMap(size_t shards) :
+    mShards(NULL),
+    mShardCount(1)
+{
+    while (mShardCount < shards && mShardCount < MAX_SHARDS) { mShardCount <<= 1; }
+    mShards = new Shard[mShardCount];
+}
+
+SharedMap::~SharedMap()
+{
+    delete[] mShards;
+}
+
+// the shard is chosen from the high bits of the mixed hash, the map buckets use the hash itself.
+SharedMap::Shard& SharedMap::shardFor(const Value& key)
+{
+    Poco::UInt64 h = mix(static_cast<Poco::UInt64>(ValueHash()(key)) ^ 0x9e3779b97f4a7c15ULL);
+    return mShards[static_cast<size_t>(h >> 32) & (mShardCount - 1)];
+}
+
+bool SharedMap::get(const Value& key, Value& value)
+{
+    Shard& shard = shardFor(key);
+    Poco::ScopedLock<Poco::FastMutex> lock(shard.mutex);
+
+    Map::const_iterator i = shard.map.find(key);
+    if (i == shard.map.end()) { return false; }
+
+    value = i->second;
+    return true;
+}
+
+void SharedMap::set(const Value& key, const Value& value)
+{
+    Shard& shard = shardFor(key);
+    Poco::ScopedLock<Poco::FastMutex> lock(shard.mutex);
+
+    if (value.type == Value::NIL) { shard.map.erase(key); }
+    else { shard.map[key] = value; }
+}
+
+bool SharedMap::compareAndSet(const Value& key, const Value& expected, const Value& desired)
+{
+    Shard& shard = shardFor(key);
+    Poco::ScopedLock<Poco::FastMutex> lock(shard.mutex);
+
+    Map::iterator i = shard.map.find(key);
+    if (i == shard.map.end())
+    {
+        if (expected.type != Value::NIL) { return false; }
+        if (desired.type != Value::NIL) { shard.map[key] = desired; }
+        return true;
+    }
+
+    if (!(i->second == expected)) { return false; }
+
+    if (desired.type == Value::NIL) { shard.map.erase(i); }
+    else { i->second = desired; }
+    return true;
+}
+
+bool SharedMap::incr(const Value& key, const Value& delta, Value& result)
+{
+    Shard& shard = shardFor(key);
+    Poco::ScopedLock<Poco::FastMutex> lock(shard.mutex);
+
+    Value& current = shard.map[key];
+    if (current.type == Value::NIL)
+    {
+        current.type = Value::INTEGER;
+        current.integer = 0;
+    }
+    else if (current.type != Value::INTEGER && current.type != Value::NUMBER) { return false; }
+
+    if (current.type == Value::INTEGER && delta.type == Value::INTEGER)
+    {
+        // wraps around on overflow, as Lua integers do.
+        current.integer = static_cast<Poco::Int64>(static_cast<Poco::UInt64>(current.integer) + static_cast<Poco::UInt64>(delta.integer));
+    }
+    else
+    {
+        double a = current.type == Value::INTEGER ? static_cast<double>(current.integer) : current.number;
+        double b = delta.type == Value::INTEGER ? static_cast<double>(delta.integer) : delta.number;
+        current.type = Value::NUMBER;
+        current.number = a + b;
+    }
+
+    result = current;
+    return true;
+}
+
+bool SharedMap::remove(const Value& key)
+{
+    Shard& shard = shardFor(key);
+    Poco::ScopedLock<Poco::FastMutex> lock(shard.mutex);
+    return shard.map.erase(key) > 0;
+}
+
+size_t SharedMap::size()
+{
+    size_t total = 0;
+    for (size_t i = 0; i < mShardCount; ++i)
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mShards[i].mutex);
+        total += mShards[i].map.size();
+    }
+
+    return total;
+}
+
+SharedMapUserdata::SharedMapUserdata(size_t shards) :
+    mMap(new LuaPoco::SharedMap(shards))
+{
+}
+
+// construct new Ud from existing SharedPtr (only useful for copyToState)
+SharedMapUserdata::SharedMapUserdata(const Poco::SharedPtr<LuaPoco::SharedMap>& map) :
+    mMap(map)
+{
+}
+
+SharedMapUserdata::~SharedMapUserdata()
+{
+}
+
+bool SharedMapUserdata::copyToState(lua_State *L)
+{
+    registerSharedMap(L);
+    SharedMapUserdata* smud = NULL;
+    void* p = lua_newuserdata(L, sizeof *smud);
+
+    try
+    {
+        smud = new(p) SharedMapUserdata(mMap);
+    }
+    catch (const std::exception& e)
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    setupPocoUserdata(L, smud, POCO_SHAREDMAP_METATABLE_NAME);
+    return true;
+}
+
+// register metatable for this class
+bool SharedMapUserdata::registerSharedMap(lua_State* L)
+{
+    struct CFunctions methods[] =
+    {
+        { "__gc", metamethod__gc },
+        { "__tostring", metamethod__tostring },
+        { "__len", metamethod__len },
+        { "get", get },
+        { "set", set },
+        { "compareAndSet", compareAndSet },
+        { "incr", incr },
+        { "delete", remove },
+        { "size", size },
+        { NULL, NULL}
+    };
+
+    setupUserdataMetatable(L, POCO_SHAREDMAP_METATABLE_NAME, methods);
+    return true;
+}
+
+/// Constructs a new sharedmap userdata.
+// @int[opt] shards number of independently locked shards, rounded up to a power of 2. (default: 16)
+// @return userdata or nil. (error)
+// @return error message.
+// @function new
+int SharedMapUserdata::SharedMap(lua_State* L)
+{
+    int firstArg = lua_istable(L, 1) ? 2 : 1;
+
+    lua_Integer shards = DEFAULT_SHARDS;
+    if (!lua_isnoneornil(L, firstArg)) { shards = luaL_checkinteger(L, firstArg); }
+    if (shards < 1 || shards > static_cast<lua_Integer>(MAX_SHARDS))
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "invalid shards: %d, expected 1 to %d", static_cast<int>(shards), static_cast<int>(MAX_SHARDS));
+        return 2;
+    }
+
+    SharedMapUserdata* smud = NULL;
+    void* p = lua_newuserdata(L, sizeof *smud);
+
+    try
+    {
+        smud = new(p) SharedMapUserdata(static_cast<size_t>(shards));
+    }
+    catch (const std::exception& e)
+    {
+        return pushException(L, e);
+    }
+
+    setupPocoUserdata(L, smud, POCO_SHAREDMAP_METATABLE_NAME);
+    return 1;
+}
+
+///
+// @type sharedmap
+
+// metamethod infrastructure
+int SharedMapUserdata::metamethod__tostring(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+
+    lua_pushfstring(L, "Poco.SharedMap (%p)", static_cast<void*>(smud));
+    return 1;
+}
+
+int SharedMapUserdata::metamethod__len(lua_State* L)
+{
+    return size(L);
+}
+
+// userdata methods
+
+/// Gets the value of a key.
+// @param key boolean, number, or string.
+// @return value or nil when the key is not present.
+// @function get
+int SharedMapUserdata::get(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    checkValue(L, 2, true);
+
+    SharedMap::Value key;
+    SharedMap::Value value;
+    readValue(L, 2, key, true);
+    smud->mMap->get(key, value);
+
+    pushValue(L, value);
+    return 1;
+}
+
+/// Sets the value of a key.
+// @param key boolean, number, or string.
+// @param value boolean, number, string, or nil to remove the key.
+// @return true
+// @function set
+int SharedMapUserdata::set(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    checkValue(L, 2, true);
+    checkValue(L, 3, false);
+
+    SharedMap::Value key;
+    SharedMap::Value value;
+    readValue(L, 2, key, true);
+    readValue(L, 3, value, false);
+    smud->mMap->set(key, value);
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/// Sets the value of a key only if its current value equals the expected value, as a single atomic step.
+// @param key boolean, number, or string.
+// @param expected value the key must currently hold, or nil if the key must not be present.
+// @param desired value to set, or nil to remove the key.
+// @return boolean indicating if the value was set.
+// @function compareAndSet
+int SharedMapUserdata::compareAndSet(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    checkValue(L, 2, true);
+    checkValue(L, 3, false);
+    checkValue(L, 4, false);
+
+    SharedMap::Value key;
+    SharedMap::Value expected;
+    SharedMap::Value desired;
+    readValue(L, 2, key, true);
+    readValue(L, 3, expected, false);
+    readValue(L, 4, desired, false);
+
+    lua_pushboolean(L, smud->mMap->compareAndSet(key, expected, desired));
+    return 1;
+}
+
+/// Adds to the numeric value of a key as a single atomic step, a key that is not present counts as 0.
+// @param key boolean, number, or string.
+// @number[opt] delta amount to add. (default: 1)
+// @return new value or nil. (error)
+// @return error message.
+// @function incr
+int SharedMapUserdata::incr(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    checkValue(L, 2, true);
+    if (!lua_isnoneornil(L, 3)) { luaL_checktype(L, 3, LUA_TNUMBER); }
+
+    SharedMap::Value key;
+    SharedMap::Value delta;
+    SharedMap::Value result;
+    readValue(L, 2, key, true);
+    if (lua_isnoneornil(L, 3))
+    {
+        delta.type = SharedMap::Value::INTEGER;
+        delta.integer = 1;
+    }
+    else { readValue(L, 3, delta, false); }
+
+    if (!smud->mMap->incr(key, delta, result))
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "value is not a number");
+        return 2;
+    }
+
+    pushValue(L, result);
+    return 1;
+}
+
+/// Removes a key.
+// @param key boolean, number, or string.
+// @return boolean indicating if the key was present.
+// @function delete
+int SharedMapUserdata::remove(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    checkValue(L, 2, true);
+
+    SharedMap::Value key;
+    readValue(L, 2, key, true);
+
+    lua_pushboolean(L, smud->mMap->remove(key));
+    return 1;
+}
+
+/// Gets the number of keys in the map.
+// The shards are counted one at a time, so the result may be stale while other threads are updating the map.
+// @return number of keys.
+// @function size
+int SharedMapUserdata::size(lua_State* L)
+{
+    SharedMapUserdata* smud = checkPrivateUserdata<SharedMapUserdata>(L, 1);
+    pushInteger(L, static_cast<Poco::Int64>(smud->mMap->size()));
+    return 1;
+}
+
+} // LuaPoco
@@ -0,0 +1,109 @@
+#ifndef LUA_POCO_SHAREDMAP_H
+#define LUA_POCO_SHAREDMAP_H
+
+#include "LuaPoco.h"
+#include "Userdata.h"
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Types.h>
+#include <string>
+#include <unordered_map>
+
+extern "C"
+{
+LUAPOCO_API int luaopen_poco_sharedmap(lua_State* L);
+}
+
+namespace LuaPoco
+{
+
+extern const char* POCO_SHAREDMAP_METATABLE_NAME;
+
+// hash map split into shards, each guarded by its own mutex, such that threads working on
+// different keys rarely contend for the same lock.
+class SharedMap
+{
+public:
+    struct Value
+    {
+        enum Type { NIL, BOOLEAN, INTEGER, NUMBER, STRING };
+        Value();
+        bool operator==(const Value& other) const;
+
+        Type type;
+        union
+        {
+            bool boolean;
+            Poco::Int64 integer;
+            double number;
+        };
+        std::string string;
+    };
+
+    struct ValueHash
+    {
+        size_t operator()(const Value& value) const;
+    };
+
+    // shards is rounded up to a power of 2.
+    SharedMap(size_t shards);
+    ~SharedMap();
+
+    // returns false when key is not present.
+    bool get(const Value& key, Value& value);
+    // a NIL value removes the key.
+    void set(const Value& key, const Value& value);
+    // sets key to desired only when its current value equals expected, NIL meaning not present.
+    bool compareAndSet(const Value& key, const Value& expected, const Value& desired);
+    // adds delta to the value of key, treating a missing key as 0.
+    // returns false when the current value is not a number.
+    bool incr(const Value& key, const Value& delta, Value& result);
+    // returns false when key is not present.
+    bool remove(const Value& key);
+    size_t size();
+
+private:
+    typedef std::unordered_map<Value, Value, ValueHash> Map;
+
+    struct Shard
+    {
+        Poco::FastMutex mutex;
+        Map map;
+    };
+
+    Shard& shardFor(const Value& key);
+
+    Shard* mShards;
+    size_t mShardCount;
+};
+
+class SharedMapUserdata : public Userdata
+{
+public:
+    SharedMapUserdata(size_t shards);
+    SharedMapUserdata(const Poco::SharedPtr<SharedMap>& map);
+    virtual ~SharedMapUserdata();
+    virtual bool copyToState(lua_State *L);
+    // register metatable for this class
+    static bool registerSharedMap(lua_State* L);
+    // constructor function
+    static int SharedMap(lua_State* L);
+
+    Poco::SharedPtr<LuaPoco::SharedMap> mMap;
+private:
+    // metamethod infrastructure
+    static int metamethod__tostring(lua_State* L);
+    static int metamethod__len(lua_State* L);
+
+    // userdata methods
+    static int get(lua_State* L);
+    static int set(lua_State* L);
+    static int compareAndSet(lua_State* L);
+    static int incr(lua_State* L);
+    static int remove(lua_State* L);
+    static int size(lua_State* L);
+};
+
+} // LuaPoco
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef LUA_POCO_TABLE_ENCODER_H
+#define LUA_POCO_TABLE_ENCODER_H
+
+#include "LuaPoco.h"
+#include "JSON.h"
+#include <Poco/Types.h>
+#include <string>
+#include <vector>
+
+namespace LuaPoco
+{
+
+struct TableInfo
+{
+    enum TableType { object, array} tableType;
+    size_t currentArrayIndex;
+    int tableStackIndex;
+};
+
+// adapts a writer to TableEncoder, specialized for each writer with the members:
+//   static const bool COUNTED, objects and arrays are started with their number of members and elements.
+//   static const char* name(), the name of the format in error messages.
+//   static void fail(const std::string& message), throws the exception of the format.
+//   static void startObject(Writer& w, size_t count) and startArray(Writer& w, size_t count).
+//   static void number(Writer& w, lua_State* L, int index), writes the number at index as a value.
+//   static void numberKey(Writer& w, lua_State* L, int index), writes the number at index as a key.
+//   static void otherKey(Writer& w, lua_State* L, int index), writes a key that is neither a string nor a number,
+//   or fails for key types the format does not support.
+template <class Writer>
+struct TableEncoderTraits;
+
+// encodes Lua values with a writer, walking nested tables iteratively on the Lua stack,
+// such that the nesting depth is only bounded by the size of the Lua stack.
+// the json null, emptyArray and emptyObject sentinels are encoded as null, [] and {} in every format.
+template <class Writer>
+class TableEncoder
+{
+public:
+    typedef TableEncoderTraits<Writer> Traits;
+
+    TableEncoder(lua_State* L, Writer& writer) : mState(L), mWriter(writer) {}
+    ~TableEncoder() {}
+
+    // encodes the value on the top of the stack, replacing it with the output string.
+    bool encode()
+    {
+        encodeValue();
+
+        lua_pushlstring(mState, mWriter.data(), mWriter.size());
+        // return all pending tables were processed
+        return mTableQueue.empty();
+    }
+
+    // encodes each table of the array at index as a line of newline delimited output.
+    void encodeLines(int index)
+    {
+        for (int i = 1; ; ++i)
+        {
+            lua_rawgeti(mState, index, i);
+            if (lua_isnil(mState, -1))
+            {
+                lua_pop(mState, 1);
+                break;
+            }
+            if (!lua_istable(mState, -1)) { Traits::fail("records must be tables."); }
+
+            encodeValue();
+            mWriter.endLine();
+        }
+    }
+
+    // writes the value on the top of the stack to the sink of the writer, the value is popped.
+    void encodeToSink()
+    {
+        encodeValue();
+        mWriter.flush();
+    }
+
+private:
+    TableEncoder(const TableEncoder&);
+    TableEncoder& operator=(const TableEncoder&);
+
+    // writes the value on the top of the stack, which is popped.
+    void encodeValue()
+    {
+        handleValue();
+
+        while (mTableQueue.size() > 0)
+        {
+            TableInfo& ti = mTableQueue.back();
+            if (ti.tableType == TableInfo::TableType::array)
+            {
+                lua_rawgeti(mState, ti.tableStackIndex, ++ti.currentArrayIndex);
+                if (!lua_isnil(mState, -1)) { handleValue(); }
+                else
+                {
+                    // pop nil, array
+                    lua_pop(mState, 2);
+                    mTableQueue.pop_back();
+                    mWriter.endArray();
+                }
+            }
+            else
+            {
+                // handleTable() leaves nil on the stack to for the nested table iteration.
+                if (lua_next(mState, ti.tableStackIndex))
+                {
+                    int keyType = lua_type(mState, -2);
+                    if (keyType == LUA_TSTRING)
+                    {
+                        size_t len = 0;
+                        const char* key = lua_tolstring(mState, -2, &len);
+                        mWriter.key(key, len);
+                        handleValue();
+                    }
+                    else if (keyType == LUA_TNUMBER)
+                    {
+                        Traits::numberKey(mWriter, mState, -2);
+                        handleValue();
+                    }
+                    else
+                    {
+                        Traits::otherKey(mWriter, mState, -2);
+                        handleValue();
+                    }
+                }
+                else
+                {
+                    // done with object, pop it.
+                    lua_pop(mState, 1);
+                    mTableQueue.pop_back();
+                    mWriter.endObject();
+                }
+            }
+        }
+    }
+
+    // arrays are defined as tables that operate as sequences from 1 to n with [n + 1] == nil to terminate.
+    // objects are defined as not having an array part, and only string keys being present.
+    bool isArray(int index)
+    {
+        lua_rawgeti(mState, index, 1);
+        bool result = !lua_isnil(mState, -1);
+        lua_pop(mState, 1);
+        return result;
+    }
+
+    // the number of elements visited by the array walk, up to the first nil.
+    size_t arrayLength(int index)
+    {
+        size_t length = 0;
+        for (;; ++length)
+        {
+            lua_rawgeti(mState, index, static_cast<int>(length + 1));
+            bool end = lua_isnil(mState, -1);
+            lua_pop(mState, 1);
+            if (end) { return length; }
+        }
+    }
+
+    size_t objectSize(int index)
+    {
+        size_t size = 0;
+        lua_pushnil(mState);
+        while (lua_next(mState, index))
+        {
+            lua_pop(mState, 1);
+            ++size;
+        }
+        return size;
+    }
+
+    void handleTable()
+    {
+        // room for the iteration key and value, and the next nested table.
+        if (!lua_checkstack(mState, 4))
+        {
+            Traits::fail("table nesting is too deep.");
+        }
+
+        // store table information in mQueue.
+        TableInfo ti =
+        {
+            isArray(-1) ? TableInfo::TableType::array : TableInfo::TableType::object,
+            0,
+            lua_gettop(mState)
+        };
+        mTableQueue.push_back(ti);
+
+        // leave key on the top of the stack so the loop can process it with calls to lua_next.
+        // inform printer of the start of a new object/array.
+        if (ti.tableType == TableInfo::TableType::object)
+        {
+            Traits::startObject(mWriter, Traits::COUNTED ? objectSize(ti.tableStackIndex) : 0);
+            lua_pushnil(mState);
+        }
+        else { Traits::startArray(mWriter, Traits::COUNTED ? arrayLength(ti.tableStackIndex) : 0); }
+    }
+
+    void handleValue()
+    {
+        int type = lua_type(mState, -1);
+
+        switch (type)
+        {
+        case LUA_TNIL:
+            Traits::fail(std::string("nil is an invalid value, use ") + Traits::name() + ".null");
+            break;
+        case LUA_TNUMBER:
+            Traits::number(mWriter, mState, -1);
+            break;
+        case LUA_TBOOLEAN:
+        {
+            bool b = static_cast<bool>(lua_toboolean(mState, -1));
+            mWriter.value(b);
+            break;
+        }
+        case LUA_TSTRING:
+        {
+            size_t len = 0;
+            const char* str = lua_tolstring(mState, -1, &len);
+            mWriter.value(str, len);
+            break;
+        }
+        case LUA_TTABLE:
+            handleTable();
+            // the table value must stay on the top of the stack in order to be iterated by
+            // encode loop.  when the end of the table is encountered, it is popped.
+            // returning here avoids the pop that is needed for all other values.
+            return;
+            break;
+        case LUA_TFUNCTION:
+            Traits::fail(std::string("function type invalid for ") + Traits::name() + ".");
+            break;
+        case LUA_TUSERDATA:
+            Traits::fail(std::string("userdata type invalid for ") + Traits::name() + ".");
+            break;
+        case LUA_TTHREAD:
+            Traits::fail(std::string("thread type invalid for ") + Traits::name() + ".");
+            break;
+        case LUA_TLIGHTUSERDATA:
+        {
+            const char *lud = static_cast<const char*>(lua_touserdata(mState, -1));
+
+            if (lud == jsonNull) { mWriter.null(); }
+            else if (lud == jsonEmptyArray) { Traits::startArray(mWriter, 0); mWriter.endArray(); }
+            else if (lud == jsonEmptyObject) { Traits::startObject(mWriter, 0); mWriter.endObject(); }
+            else { Traits::fail(std::string("unknown ") + Traits::name() + " lightuserdata value."); }
+            break;
+        }
+        default:
+            Traits::fail(std::string("unknown value for ") + Traits::name() + " conversion.");
+            break;
+        }
+
+        // all values except for table needs to be popped.
+        // the table case returns early to avoid this pop.
+        lua_pop(mState, 1);
+    }
+
+    lua_State* mState;
+    Writer& mWriter;
+    std::vector<TableInfo> mTableQueue;
+};
+
+} // LuaPoco
+
+#endif
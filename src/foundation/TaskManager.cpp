@@ -28,20 +28,47 @@
 // @field stackSize The stack size for the native OS thread.
 // @field minNotificationPool Number of Notifications to keep warm in an object pool.
 // @field maxNotificationPool Maximum number of Notifications permitted concurrently in flight.
+// Tasks posting custom notifications block while this many are in flight.
+// @field notificationTimeout Time in milliseconds a task may block waiting for a Notification before
+// postNotification returns an error, default is -1 which waits until one is available or the task is cancelled.
+// @field cancelHook Opt-in number of Lua VM instructions between checks that stop a task's Lua code with an error
+// once it is cancelled or exceeds taskTimeLimit/taskCpuLimit, default is 0 (disabled).
+// @field taskTimeLimit Wall clock budget in milliseconds for each task when cancelHook is enabled, default is 0 (unlimited).
+// @field taskCpuLimit CPU time budget in milliseconds for each task when cancelHook is enabled, default is 0 (unlimited).
+// @field progressInterval Minimum time in milliseconds between progress notifications queued for a task.
+// Progress notifications are always coalesced per task while one is still waiting in the queue, default is 0.
+// When updates are dropped by the interval, the latest value is queued once the interval has passed.
+// @field timerResolution Tick length in milliseconds of the timer wheel used by scheduleAfter and scheduleEvery, default is 10.
+// @field cpuSet cpu index or array of cpu indices the worker threads are restricted to, default is unrestricted.
+// @field numaNode NUMA node whose CPUs are used as the cpuSet when cpuSet is not supplied, see thread.numaNodeCpus().
+// @field pinWorkers boolean, when true each worker thread is pinned to a single CPU of the cpuSet in turn, default is false.
 
 /// @table TaskNotification
 // @field task light userdata value for the task.
 // @field type "started", "cancelled", "finished", "failed", "progress", or "custom".
 // @field code number value specifing the error code of a failed task.
 // @field message string value specifying the error message of a failed task.
+// @field name string value of the task name.
 // @field progress number value specifying the progress as a percentage from 0.0 to 100.0.
+// @field enqueued number value of the time the task was started or queued, in microseconds since the epoch.
+// Set on "finished" and "failed" notifications, as are the following fields.
+// @field started number value of the time the task began running, in microseconds since the epoch.
+// @field ended number value of the time the task stopped running, in microseconds since the epoch.
+// @field queueTime number value of microseconds between enqueued and started.
+// @field runTime number value of microseconds between started and ended.
+// @field memory number value of the peak size of the task's Lua heap in bytes, counted on every allocation.
+// @field cpuTime number value of the CPU time used by the task's thread in microseconds,
+// absent on platforms where per thread CPU time is not available.
 
 #include "TaskManager.h"
 #include <Poco/Exception.h>
 #include <Poco/TaskNotification.h>
 #include <Poco/Observer.h>
 #include <Poco/ScopedLock.h>
+#include <Poco/NumberFormatter.h>
 #include <cstring>
+#include <cstdlib>
+#include <cstdio>
 
 int luaopen_poco_taskmanager(lua_State* L)
 {
@@ -61,6 +88,14 @@ const char* POCO_TASK_MANAGER_CONTAINER_LUD_KEY_NAME = "Poco.TaskManagerContaine
 const char* POCO_TASK_LUD_KEY_NAME = "Poco.Task.lightuserdata";
 const int NOTIFICATION_BORROW_TIMEOUT_MS = 1000;
 
+// matches the panic function installed by luaL_newstate, for states created with a custom allocator.
+static int panic(lua_State* L)
+{
+    const char* msg = lua_tostring(L, -1);
+    std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg ? msg : "error object is not a string");
+    return 0;
+}
+
 static bool getLightUserdataFromTable(lua_State* L, int tableIndex,
     const char* expected, const char* userdataName)
 {
@@ -86,30 +121,33 @@ static bool getLightUserdataFromTable(lua_State* L, int tableIndex,
     return result;
 }
 
-static bool findTaskInTaskList(lua_State* L, int udIndex,
-    Poco::AutoPtr<Poco::Task>& task, Poco::TaskManager& manager)
+TaskManagerSettings::TaskManagerSettings() :
+    minThreads(1),
+    maxThreads(16),
+    idleTime(60),
+    stackSize(0),
+    minNotificationPool(8),
+    maxNotificationPool(16),
+    progressInterval(0),
+    notificationTimeout(-1),
+    cancelHook(0),
+    taskTimeLimit(0),
+    taskCpuLimit(0),
+    timerResolution(10),
+    pinWorkers(false)
 {
-    bool result = false;
-    Poco::Task* ludTask = static_cast<Poco::Task*>(lua_touserdata(L, udIndex));
-
-    Poco::TaskManager::TaskList tl = manager.taskList();
-    for (Poco::TaskManager::TaskList::iterator i = tl.begin(); i != tl.end(); ++i)
-    {
-        if (ludTask == i->get())
-        {
-            task = *i;
-            result = true;
-            break;
-        }
-    }
-
-    return result;
 }
 
+TaskMetrics::TaskMetrics() :
+    peakMemory(0),
+    cpuTime(-1)
+{
+}
 
 Task::Task(const char* taskName) :
     Poco::Task(taskName),
-    mState(NULL)
+    mState(NULL),
+    mAllocated(0)
 {
 }
 
@@ -126,7 +164,8 @@ bool Task::prepTask(
     int firstParamIndex,
     int lastParamIndex)
 {
-    LuaStateHolder holder(luaL_newstate());
+    LuaStateHolder holder(lua_newstate(allocate, this));
+    if (holder.state) { lua_atpanic(holder.state, panic); }
     // initialize the state and load poco metatables.
     luaL_openlibs(holder.state);
     setupPrivateUserdata(holder.state);
@@ -168,23 +207,18 @@ bool Task::prepTask(
     luaL_getmetatable(holder.state, POCO_TASK_PROTECTED_METATABLE_NAME);
     lua_setmetatable(holder.state, -2);
 
-    // check if there are args present, given:
-    // 1 = instance table, 2 = task name, 3 = function, 4 = start of args
-    // if taskManagerLudIndex (which is at -1) is equal to 4, it means there are no args
-    if (taskManagerLudIndex > 4)
+    // there are no args when lastParamIndex is below firstParamIndex.
+    for (int i = firstParamIndex; i <= lastParamIndex; ++i)
     {
-        for (int i = firstParamIndex; i <= lastParamIndex; ++i)
-        {
-            lua_pushvalue(L, i);
-            transferred = transferValue(holder.state, L);
-            lua_pop(L, 1);
+        lua_pushvalue(L, i);
+        transferred = transferValue(holder.state, L);
+        lua_pop(L, 1);
 
-            if (!transferred)
-            {
-                lua_pushnil(L);
-                lua_pushfstring(L, "non-copyable value at parameter %d\n", i);
-                return false;
-            }
+        if (!transferred)
+        {
+            lua_pushnil(L);
+            lua_pushfstring(L, "non-copyable value at parameter %d\n", i);
+            return false;
         }
     }
 
@@ -200,17 +234,86 @@ void Task::runTask()
     // 2. taskmanager object
     // 3. protected task self object
     // 4. remainder of arguments
+    Poco::Int64 cpuStart = 0;
+    bool haveCpuTime = threadCpuTime(cpuStart);
+    mMetrics.started.update();
+
+    installHook(mState);
     int result = lua_pcall(mState, lua_gettop(mState) - 1, 0, 0);
 
+    mMetrics.ended.update();
+    Poco::Int64 cpuEnd = 0;
+    if (haveCpuTime && threadCpuTime(cpuEnd)) { mMetrics.cpuTime = cpuEnd - cpuStart; }
+
     // Poco::Task catches exceptions thrown by tasks and posts a TaskFailedNotification.
     // runTask will replicate that behavior here, instead of throwing and having Poco::Task catch.
-    if (result != 0)
+    // a task stopped by the hook due to cancellation has already posted its cancelled notification.
+    if (result != 0 && stopReason() != ExecutionHook::CANCELLED)
     {
         const char* errmsg = lua_tostring(mState, -1);
         postNotification(new Poco::TaskFailedNotification(this, Poco::Exception(errmsg, result)));
     }
 }
 
+bool Task::isCancelRequested()
+{
+    return isCancelled();
+}
+
+void Task::setEnqueued()
+{
+    mMetrics.enqueued.update();
+}
+
+const TaskMetrics& Task::metrics() const
+{
+    return mMetrics;
+}
+
+void Task::pushMetrics(lua_State* L, int tableIndex) const
+{
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.enqueued.epochMicroseconds()));
+    lua_setfield(L, tableIndex, "enqueued");
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.started.epochMicroseconds()));
+    lua_setfield(L, tableIndex, "started");
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.ended.epochMicroseconds()));
+    lua_setfield(L, tableIndex, "ended");
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.started - mMetrics.enqueued));
+    lua_setfield(L, tableIndex, "queueTime");
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.ended - mMetrics.started));
+    lua_setfield(L, tableIndex, "runTime");
+    lua_pushnumber(L, static_cast<lua_Number>(mMetrics.peakMemory));
+    lua_setfield(L, tableIndex, "memory");
+
+    if (mMetrics.cpuTime >= 0)
+    {
+        lua_pushnumber(L, static_cast<lua_Number>(mMetrics.cpuTime));
+        lua_setfield(L, tableIndex, "cpuTime");
+    }
+}
+
+// the state is only used by one thread at a time, preparing, running or destroying the task.
+void* Task::allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    Task* task = static_cast<Task*>(ud);
+    // osize holds the type of the object being created when ptr is NULL.
+    if (ptr == NULL) { osize = 0; }
+
+    if (nsize == 0)
+    {
+        std::free(ptr);
+        task->mAllocated -= osize;
+        return NULL;
+    }
+
+    void* p = std::realloc(ptr, nsize);
+    if (p == NULL) { return NULL; }
+
+    task->mAllocated = task->mAllocated - osize + nsize;
+    if (task->mAllocated > task->mMetrics.peakMemory) { task->mMetrics.peakMemory = task->mAllocated; }
+    return p;
+}
+
 int Task::lud_isCancelled(lua_State* L)
 {
     int rv = 1;
@@ -412,8 +515,15 @@ int Task::lud_postNotification(lua_State* L)
         lua_pop(L, 1);
 
         Poco::AutoPtr<Notification> notification;
-        do { notification = tmc->mPool.borrowObject(NOTIFICATION_BORROW_TIMEOUT_MS); } while (notification.isNull());
-        
+        if (!tmc->borrowNotification(task, notification))
+        {
+            lua_pushnil(L);
+            // an unbounded wait only gives up when the task is cancelled.
+            if (task->isCancelled()) { lua_pushstring(L, "task was cancelled while waiting for a notification."); }
+            else { lua_pushstring(L, "timed out waiting for a notification, maxNotificationPool are in flight."); }
+            return 2;
+        }
+
         for (int i = 2; i <= top; ++i)
         {
             // transferValue requires value be at the top of the stack.
@@ -440,16 +550,108 @@ int Task::lud_postNotification(lua_State* L)
     return rv;
 }
 
+ProgressTimer::ProgressTimer(TaskManagerContainer& container, Poco::Task* task) :
+    mContainer(container),
+    mTask(task)
+{
+}
+
+ProgressTimer::~ProgressTimer()
+{
+}
+
+// runs on the TimerWheel thread, the task is only looked up in the live task index.
+bool ProgressTimer::fire()
+{
+    mContainer.flushProgress(mTask);
+    return false;
+}
+
 // TaskManagerContainer implementation
-TaskManagerContainer::TaskManagerContainer(
-    int minThreads,
-    int maxThreads,
-    int idleTimeout,
-    int stackSize,
-    int minPool,
-    int maxPool) :
-    mPool(static_cast<size_t>(minPool), static_cast<size_t>(maxPool)),
-    mThreadPool(minThreads, maxThreads, idleTimeout, stackSize),
+ScheduledTask::ScheduledTask(TaskManagerContainer& container) :
+    mContainer(container),
+    mState(NULL)
+{
+}
+
+ScheduledTask::~ScheduledTask()
+{
+    if (mState) { lua_close(mState); }
+}
+
+bool ScheduledTask::prepTemplate(lua_State* L, int functionIndex, int lastParamIndex)
+{
+    LuaStateHolder holder(luaL_newstate());
+    setupPrivateUserdata(holder.state);
+
+    for (int i = functionIndex; i <= lastParamIndex; ++i)
+    {
+        lua_pushvalue(L, i);
+        bool transferred = transferValue(holder.state, L);
+        lua_pop(L, 1);
+
+        if (!transferred)
+        {
+            lua_pushnil(L);
+            if (i == functionIndex) { lua_pushfstring(L, "non-copyable function at parameter %d\n", i); }
+            else { lua_pushfstring(L, "non-copyable value at parameter %d\n", i); }
+            return false;
+        }
+    }
+
+    mState = holder.extract();
+    return true;
+}
+
+// runs on the TimerWheel thread.
+bool ScheduledTask::fire()
+{
+    if (mContainer.mDestruct > 0) { return false; }
+
+    std::string taskName("timer:");
+    taskName += Poco::NumberFormatter::format(id());
+    Poco::AutoPtr<Task> newTask(new Task(taskName.c_str()), true);
+    bool started = false;
+    int top = lua_gettop(mState);
+
+    try
+    {
+        // the template state is laid out as: function, parameters..., TaskManagerContainer*
+        lua_pushlightuserdata(mState, static_cast<void*>(&mContainer));
+        if (newTask->prepTask(mState, top + 1, 1, 2, top))
+        {
+            mContainer.startTask(newTask);
+            started = true;
+        }
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    lua_settop(mState, top);
+    if (!started) { mContainer.scheduledTaskFailed(); }
+
+    return true;
+}
+
+TaskManagerContainer::TaskManagerContainer(const TaskManagerSettings& settings) :
+    mPool(static_cast<size_t>(settings.minNotificationPool), static_cast<size_t>(settings.maxNotificationPool)),
+    mProgressInterval(static_cast<Poco::Clock::ClockDiff>(settings.progressInterval) * 1000),
+    mProgressSuppressed(0),
+    mCancelHook(settings.cancelHook),
+    mTaskTimeLimit(settings.taskTimeLimit),
+    mTaskCpuLimit(settings.taskCpuLimit),
+    mNotificationTimeout(settings.notificationTimeout),
+    mNotificationWaits(0),
+    mNotificationTimeouts(0),
+    mNotificationWaitTime(0),
+    mNotificationWaitMax(0),
+    mTimersFailed(0),
+    mTimerWheel(settings.timerResolution),
+    mCpuSet(settings.cpuSet),
+    mPinWorkers(settings.pinWorkers),
+    mNextWorkerCpu(0),
+    mThreadPool(settings.minThreads, settings.maxThreads, settings.idleTime, settings.stackSize),
     mQueueEnabled(1),
     mTaskManager(mThreadPool),
     mDestruct(0)
@@ -478,6 +680,10 @@ TaskManagerContainer::TaskManagerContainer(
 TaskManagerContainer::~TaskManagerContainer()
 {
     ++mDestruct;
+    // no more tasks are started by timers once the wheel is stopped.
+    // when the last reference is released by a timer on the wheel thread, stop() does not join that thread,
+    // which returns without touching the wheel again.
+    mTimerWheel.stop();
     mTaskManager.cancelAll();
     mTaskManager.joinAll();
 
@@ -502,6 +708,232 @@ TaskManagerContainer::~TaskManagerContainer()
     mTaskManager.removeObserver(taskCustomObserver);
 }
 
+void TaskManagerContainer::startTask(Poco::AutoPtr<Task>& task)
+{
+    Poco::Task* baseTaskPtr = task;
+    task->configureHook(mCancelHook, mTaskTimeLimit, mTaskCpuLimit);
+    task->setEnqueued();
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+        mTaskIndex[baseTaskPtr].task = Poco::AutoPtr<Poco::Task>(baseTaskPtr, true);
+    }
+
+    try
+    {
+        mTaskManager.start(task);
+    }
+    catch (...)
+    {
+        // the task never made it onto the TaskManager, so no finished notification will remove it.
+        removeTask(baseTaskPtr);
+        throw;
+    }
+}
+
+bool TaskManagerContainer::findTask(void* taskLud, Poco::AutoPtr<Poco::Task>& task)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+    TaskIndex::iterator i = mTaskIndex.find(static_cast<Poco::Task*>(taskLud));
+    if (i == mTaskIndex.end()) { return false; }
+
+    task = i->second.task;
+    return true;
+}
+
+bool TaskManagerContainer::borrowNotification(Poco::Task* task, Poco::AutoPtr<Notification>& notification)
+{
+    // a timeout of 0 returns immediately when the pool is exhausted.
+    notification = mPool.borrowObject(0);
+    if (!notification.isNull()) { return true; }
+
+    Poco::Clock waitStart;
+    if (mNotificationTimeout > 0) { notification = mPool.borrowObject(mNotificationTimeout); }
+    else if (mNotificationTimeout < 0)
+    {
+        // wait in slices such that a cancelled task (ie: the TaskManager is destructing) can give up.
+        while (notification.isNull() && !task->isCancelled())
+        {
+            notification = mPool.borrowObject(NOTIFICATION_BORROW_TIMEOUT_MS);
+        }
+    }
+    Poco::Clock::ClockDiff waited = waitStart.elapsed();
+
+    Poco::ScopedLock<Poco::FastMutex> lock(mStatsMutex);
+    ++mNotificationWaits;
+    mNotificationWaitTime += waited;
+    if (waited > mNotificationWaitMax) { mNotificationWaitMax = waited; }
+    if (notification.isNull()) { ++mNotificationTimeouts; }
+
+    return !notification.isNull();
+}
+
+Poco::UInt64 TaskManagerContainer::scheduleTask(ScheduledTask* st, long delay, long interval)
+{
+    return mTimerWheel.schedule(st, delay, interval);
+}
+
+bool TaskManagerContainer::cancelTimer(Poco::UInt64 id)
+{
+    return mTimerWheel.cancel(id);
+}
+
+void TaskManagerContainer::scheduledTaskFailed()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mStatsMutex);
+    ++mTimersFailed;
+}
+
+TaskManagerContainer::Histogram::Histogram() :
+    count(0),
+    sum(0),
+    min(0),
+    max(0)
+{
+    std::memset(buckets, 0, sizeof buckets);
+}
+
+void TaskManagerContainer::Histogram::record(Poco::Int64 value)
+{
+    if (value < 0) { value = 0; }
+
+    if (count == 0 || value < min) { min = value; }
+    if (count == 0 || value > max) { max = value; }
+    ++count;
+    sum += value;
+
+    int bucket = 0;
+    while (bucket < 63 && (value >> (bucket + 1)) != 0) { ++bucket; }
+    ++buckets[bucket];
+}
+
+// pushes { count, sum, min, max, buckets = { ... } }, the buckets array ends at the highest non-empty bucket.
+void TaskManagerContainer::Histogram::push(lua_State* L) const
+{
+    lua_createtable(L, 0, 5);
+    lua_pushnumber(L, static_cast<lua_Number>(count));
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, static_cast<lua_Number>(sum));
+    lua_setfield(L, -2, "sum");
+    lua_pushnumber(L, static_cast<lua_Number>(min));
+    lua_setfield(L, -2, "min");
+    lua_pushnumber(L, static_cast<lua_Number>(max));
+    lua_setfield(L, -2, "max");
+
+    int used = 64;
+    while (used > 0 && buckets[used - 1] == 0) { --used; }
+
+    lua_createtable(L, used, 0);
+    for (int i = 0; i < used; ++i)
+    {
+        lua_pushnumber(L, static_cast<lua_Number>(buckets[i]));
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "buckets");
+}
+
+void TaskManagerContainer::pushStats(lua_State* L)
+{
+    Poco::UInt64 progressSuppressed = 0;
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+        progressSuppressed = mProgressSuppressed;
+    }
+
+    TimerWheel::Stats timerStats = mTimerWheel.stats();
+
+    lua_createtable(L, 0, 13);
+    lua_pushnumber(L, static_cast<lua_Number>(progressSuppressed));
+    lua_setfield(L, -2, "progressSuppressed");
+    lua_pushnumber(L, static_cast<lua_Number>(timerStats.active));
+    lua_setfield(L, -2, "timers");
+    lua_pushnumber(L, static_cast<lua_Number>(timerStats.fired));
+    lua_setfield(L, -2, "timersFired");
+    lua_pushnumber(L, static_cast<lua_Number>(timerStats.skipped));
+    lua_setfield(L, -2, "timersSkipped");
+
+    Poco::ScopedLock<Poco::FastMutex> lock(mStatsMutex);
+    lua_pushnumber(L, static_cast<lua_Number>(mNotificationWaits));
+    lua_setfield(L, -2, "notificationWaits");
+    lua_pushnumber(L, static_cast<lua_Number>(mNotificationTimeouts));
+    lua_setfield(L, -2, "notificationTimeouts");
+    lua_pushnumber(L, static_cast<lua_Number>(mNotificationWaitTime));
+    lua_setfield(L, -2, "notificationWaitTime");
+    lua_pushnumber(L, static_cast<lua_Number>(mNotificationWaitMax));
+    lua_setfield(L, -2, "notificationWaitMax");
+    lua_pushnumber(L, static_cast<lua_Number>(mTimersFailed));
+    lua_setfield(L, -2, "timersFailed");
+
+    mQueueTime.push(L);
+    lua_setfield(L, -2, "queueTime");
+    mRunTime.push(L);
+    lua_setfield(L, -2, "runTime");
+    mCpuTime.push(L);
+    lua_setfield(L, -2, "cpuTime");
+    mPeakMemory.push(L);
+    lua_setfield(L, -2, "memory");
+}
+
+void TaskManagerContainer::removeTask(Poco::Task* task)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+    TaskIndex::iterator i = mTaskIndex.find(task);
+    if (i == mTaskIndex.end()) { return; }
+
+    // the finished notification reports the final progress.
+    if (i->second.progressTimer) { mTimerWheel.cancel(i->second.progressTimer); }
+    mTaskIndex.erase(i);
+}
+
+void TaskManagerContainer::flushProgress(Poco::Task* task)
+{
+    Poco::AutoPtr<Poco::TaskProgressNotification> tpn;
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+        TaskIndex::iterator i = mTaskIndex.find(task);
+        if (i == mTaskIndex.end()) { return; }
+
+        TaskEntry& entry = i->second;
+        bool pending = entry.progressPending;
+        entry.progressTimer = 0;
+        entry.progressPending = false;
+        // a queued notification already reports the latest value when it is dequeued.
+        if (!pending || entry.progressQueued || !mQueueEnabled) { return; }
+
+        entry.progressQueued = true;
+        entry.lastProgress.update();
+        tpn = new Poco::TaskProgressNotification(entry.task, entry.task->progress());
+    }
+
+    mQueue.enqueueNotification(tpn);
+}
+
+void TaskManagerContainer::placeWorker()
+{
+    if (mCpuSet.empty()) { return; }
+
+    bool& placed = mWorkerPlaced.get();
+    if (placed) { return; }
+    placed = true;
+
+    if (mPinWorkers)
+    {
+        int worker = mNextWorkerCpu++;
+        CpuSet cpu(1, mCpuSet[static_cast<size_t>(worker) % mCpuSet.size()]);
+        setCurrentThreadAffinity(cpu);
+    }
+    else { setCurrentThreadAffinity(mCpuSet); }
+}
+
+void TaskManagerContainer::progressDequeued(Poco::Task* task)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+    TaskIndex::iterator i = mTaskIndex.find(task);
+    if (i != mTaskIndex.end()) { i->second.progressQueued = false; }
+}
+
 void TaskManagerContainer::enableTaskQueue()
 {
     mQueueEnabled = 1;
@@ -571,6 +1003,8 @@ int TaskManagerContainer::waitDequeueNotification(lua_State* L, long millisecond
         // all other notification types are Poco::TaskNotification subclasses.
         // set the Poco::Task* generically for all Poco::TaskNotification subclasses.
         Poco::TaskNotification* taskNotification = dynamic_cast<Poco::TaskNotification*>(n.get());
+        // the queued flag is cleared before the progress is read, such that a later update queues another.
+        if (dynamic_cast<Poco::TaskProgressNotification*>(n.get())) { progressDequeued(taskNotification->task()); }
         if (taskNotification != NULL)
         {
             lua_pushlightuserdata(L, static_cast<void*>(taskNotification->task()));
@@ -578,6 +1012,10 @@ int TaskManagerContainer::waitDequeueNotification(lua_State* L, long millisecond
             const std::string& taskName = taskNotification->task()->name();
             lua_pushlstring(L, taskName.c_str(), taskName.size());
             lua_setfield(L, top, "name");
+            // progress notifications are coalesced, so report the task's latest value rather than
+            // the value captured when the notification was posted.
+            lua_pushnumber(L, static_cast<lua_Number>(taskNotification->task()->progress()));
+            lua_setfield(L, top, "progress");
         }
         
         Poco::AutoPtr<Poco::TaskStartedNotification> startedNotification(n.cast<Poco::TaskStartedNotification>());
@@ -603,6 +1041,8 @@ int TaskManagerContainer::waitDequeueNotification(lua_State* L, long millisecond
         {
             lua_pushstring(L, "finished");
             lua_setfield(L, top, "type");
+            Task* task = dynamic_cast<Task*>(finishedNotification->task());
+            if (task) { task->pushMetrics(L, top); }
             lua_pushboolean(L, 1);
             return 1;
         }
@@ -612,6 +1052,8 @@ int TaskManagerContainer::waitDequeueNotification(lua_State* L, long millisecond
         {
             lua_pushstring(L, "failed");
             lua_setfield(L, top, "type");
+            Task* task = dynamic_cast<Task*>(failedNotification->task());
+            if (task) { task->pushMetrics(L, top); }
 
             const Poco::Exception& e = failedNotification->reason();
             lua_pushinteger(L, e.code());
@@ -629,9 +1071,6 @@ int TaskManagerContainer::waitDequeueNotification(lua_State* L, long millisecond
         {
             lua_pushstring(L, "progress");
             lua_setfield(L, top, "type");
-
-            lua_pushnumber(L, static_cast<lua_Number>(progressNotification->progress()));
-            lua_setfield(L, top, "progress");
             
             lua_pushboolean(L, 1);
             return 1;
@@ -726,7 +1165,7 @@ int TaskManagerContainer::lud_start(lua_State* L)
             // TaskManagerContainer*, lua_Function, start Param, endParam
             if (newTask->prepTask(L, lua_gettop(L), 3, 4, lastParamIndex))
             {
-                tmc->mTaskManager.start(newTask);
+                tmc->startTask(newTask);
                 Poco::Task* baseTaskPtr = newTask;
                 lua_pushlightuserdata(L, static_cast<void*>(baseTaskPtr));
                 rv = 1;
@@ -791,9 +1230,11 @@ int TaskManagerContainer::lud_dequeueNotification(lua_State* L)
 
 // Poco::Observer calls Poco::Notification::duplicate() prior to calling the callback
 // As such, it is safe to permit the AutoPtr here to assume "ownership" of the notification.
+// observers run on the task's thread, which places a worker as it runs its first task.
 void TaskManagerContainer::onTaskStarted(Poco::TaskStartedNotification* sn)
 {
     Poco::AutoPtr<Poco::TaskStartedNotification> tsn(sn);
+    placeWorker();
     if (mQueueEnabled) { mQueue.enqueueNotification(tsn); }
 }
 
@@ -806,6 +1247,20 @@ void TaskManagerContainer::onTaskCancelled(Poco::TaskCancelledNotification* cn)
 void TaskManagerContainer::onTaskFinished(Poco::TaskFinishedNotification* fn)
 {
     Poco::AutoPtr<Poco::TaskFinishedNotification> tfn(fn);
+    // the TaskManager drops the task from its list right after this notification, do the same.
+    removeTask(tfn->task());
+
+    // observers run on the task's thread once runTask() has returned, so the metrics are complete.
+    Task* task = dynamic_cast<Task*>(tfn->task());
+    if (task)
+    {
+        const TaskMetrics& tm = task->metrics();
+        Poco::ScopedLock<Poco::FastMutex> lock(mStatsMutex);
+        mQueueTime.record(tm.started - tm.enqueued);
+        mRunTime.record(tm.ended - tm.started);
+        if (tm.cpuTime >= 0) { mCpuTime.record(tm.cpuTime); }
+        mPeakMemory.record(static_cast<Poco::Int64>(tm.peakMemory));
+    }
     if (mQueueEnabled) { mQueue.enqueueNotification(tfn); }
 }
 
@@ -815,41 +1270,70 @@ void TaskManagerContainer::onTaskFailed(Poco::TaskFailedNotification* fn)
     if (mQueueEnabled) { mQueue.enqueueNotification(tfn); }
 }
 
+// progress notifications are coalesced per task: while one is still waiting in the queue, or when
+// the last one was queued less than mProgressInterval ago, further updates are dropped.
+// the dequeuing side always reports the task's latest progress value, and updates dropped by the interval
+// are followed by a ProgressTimer notification once the interval has passed.
 void TaskManagerContainer::onTaskProgress(Poco::TaskProgressNotification* pn)
 {
     Poco::AutoPtr<Poco::TaskProgressNotification> tpn(pn);
-    if (mQueueEnabled) { mQueue.enqueueNotification(tpn); }
+    if (!mQueueEnabled) { return; }
+
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mTaskIndexMutex);
+        TaskIndex::iterator i = mTaskIndex.find(tpn->task());
+        if (i != mTaskIndex.end())
+        {
+            TaskEntry& entry = i->second;
+            if (entry.progressQueued)
+            {
+                ++mProgressSuppressed;
+                return;
+            }
+
+            Poco::Clock::ClockDiff elapsed = entry.lastProgress.elapsed();
+            if (elapsed < mProgressInterval)
+            {
+                ++mProgressSuppressed;
+                entry.progressPending = true;
+                if (entry.progressTimer == 0)
+                {
+                    long delay = static_cast<long>((mProgressInterval - elapsed + 999) / 1000);
+                    try
+                    {
+                        entry.progressTimer = mTimerWheel.schedule(new ProgressTimer(*this, tpn->task()), delay, 0);
+                    }
+                    catch (const std::exception&)
+                    {
+                        // the wheel is stopped once the TaskManager is destructing.
+                    }
+                }
+                return;
+            }
+
+            entry.progressQueued = true;
+            entry.lastProgress.update();
+        }
+    }
+
+    mQueue.enqueueNotification(tpn);
 }
 
 void TaskManagerContainer::onTaskCustom(Notification* n)
 {
     Poco::AutoPtr<Notification> cn(n);
     
-    if (mQueueEnabled)
-    {
-        // obtain a Notification from the ObjectPool and copy this one to it.  this allows:
-        // 1. this notification to be returned to the pool after this function is done.
-        // 2. NotificationQueue can safely modify the copied lua_State as needed, and also return
-        //  it to the pool when done.
-        Poco::AutoPtr<Notification> cnDupe;
-        do { cnDupe = mPool.borrowObject(NOTIFICATION_BORROW_TIMEOUT_MS); } while (cnDupe.isNull());
-        transferNotification(cnDupe->state, cn);
-        mQueue.enqueueNotification(cnDupe);
-    }
-    
-    mPool.returnObject(cn);
+    // the posting task has released the notification's lua_State by the time the observer is called,
+    // so the notification itself is queued rather than copied into a second pooled notification.
+    // waitDequeueNotification() returns it to the pool once it has been transferred.
+    if (mQueueEnabled) { mQueue.enqueueNotification(cn); }
+    else { mPool.returnObject(cn); }
 }
 
 
 // TaskManagerUserdata implementation
-TaskManagerUserdata::TaskManagerUserdata(
-    int minThreads,
-    int maxThreads,
-    int idleTimeout,
-    int stackSize,
-    int minPool,
-    int maxPool)
-    : mContainer(new TaskManagerContainer(minThreads, maxThreads, idleTimeout, stackSize, minPool, maxPool))
+TaskManagerUserdata::TaskManagerUserdata(const TaskManagerSettings& settings)
+    : mContainer(new TaskManagerContainer(settings))
 {
 }
 
@@ -939,6 +1423,10 @@ bool TaskManagerUserdata::registerTaskManager(lua_State* L)
         { "enableTaskQueue", enableTaskQueue },
         { "disableTaskQueue", disableTaskQueue },
         { "dequeueNotification", dequeueNotification },
+        { "stats", stats },
+        { "scheduleAfter", scheduleAfter },
+        { "scheduleEvery", scheduleEvery },
+        { "cancelTimer", cancelTimer },
 
         { "isTaskCancelled", isTaskCancelled },
         { "taskCancel", taskCancel },
@@ -969,33 +1457,72 @@ bool TaskManagerUserdata::registerTaskManager(lua_State* L)
 // @see TaskManagerSettings
 int TaskManagerUserdata::TaskManager(lua_State* L)
 {
-    // defaults
-    int minThreads = 1;
-    int maxThreads = 16;
-    int idleTime = 60;
-    int stackSize = 0;
-    int minNotificationPool = 8;
-    int maxNotificationPool = 16;
+    TaskManagerSettings settings;
 
-    int firstArg = lua_istable(L, 1) ? 2 : 1;
+    int firstArg = constructorFirstArg(L, TaskManager);
     int top = lua_gettop(L);
 
-    if (top > firstArg)
+    if (top >= firstArg)
     {
-        luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_checktype(L, firstArg, LUA_TTABLE);
         
         lua_getfield(L, firstArg, "minThreads");
-        if (!lua_isnil(L, -1)) { minThreads = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.minThreads = static_cast<int>(lua_tointeger(L, -1)); }
         lua_getfield(L, firstArg, "maxThreads");
-        if (!lua_isnil(L, -1)) { maxThreads = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.maxThreads = static_cast<int>(lua_tointeger(L, -1)); }
         lua_getfield(L, firstArg, "idleTime");
-        if (!lua_isnil(L, -1)) { idleTime = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.idleTime = static_cast<int>(lua_tointeger(L, -1)); }
         lua_getfield(L, firstArg, "stackSize");
-        if (!lua_isnil(L, -1)) { stackSize = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.stackSize = static_cast<int>(lua_tointeger(L, -1)); }
         lua_getfield(L, firstArg, "minNotificationPool");
-        if (!lua_isnil(L, -1)) { minNotificationPool = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.minNotificationPool = static_cast<int>(lua_tointeger(L, -1)); }
         lua_getfield(L, firstArg, "maxNotificationPool");
-        if (!lua_isnil(L, -1)) { maxNotificationPool = static_cast<int>(lua_tointeger(L, -1)); }
+        if (!lua_isnil(L, -1)) { settings.maxNotificationPool = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "progressInterval");
+        if (!lua_isnil(L, -1)) { settings.progressInterval = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "notificationTimeout");
+        if (!lua_isnil(L, -1)) { settings.notificationTimeout = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "cancelHook");
+        if (!lua_isnil(L, -1)) { settings.cancelHook = static_cast<int>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "taskTimeLimit");
+        if (!lua_isnil(L, -1)) { settings.taskTimeLimit = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "taskCpuLimit");
+        if (!lua_isnil(L, -1)) { settings.taskCpuLimit = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "timerResolution");
+        if (!lua_isnil(L, -1)) { settings.timerResolution = static_cast<long>(lua_tointeger(L, -1)); }
+        lua_getfield(L, firstArg, "pinWorkers");
+        if (!lua_isnil(L, -1)) { settings.pinWorkers = lua_toboolean(L, -1) != 0; }
+        lua_getfield(L, firstArg, "cpuSet");
+        if (!lua_isnil(L, -1) && !readCpuSet(L, -1, settings.cpuSet))
+        {
+            return luaL_argerror(L, firstArg, "cpuSet expected a cpu index or an array of cpu indices");
+        }
+        lua_getfield(L, firstArg, "numaNode");
+        if (!lua_isnil(L, -1) && settings.cpuSet.empty())
+        {
+            int node = static_cast<int>(lua_tointeger(L, -1));
+            if (!numaNodeCpus(node, settings.cpuSet))
+            {
+                lua_pushnil(L);
+                lua_pushfstring(L, "unable to get the cpus of NUMA node %d.", node);
+                return 2;
+            }
+        }
+    }
+
+    if (!settings.cpuSet.empty() && !cpuAffinitySupported())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "cpu affinity is not supported on this platform.");
+        return 2;
+    }
+
+    int unavailable = unavailableCpu(settings.cpuSet);
+    if (unavailable >= 0)
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cpu %d is not available to this process.", unavailable);
+        return 2;
     }
 
     TaskManagerUserdata* tmud = NULL;
@@ -1003,12 +1530,7 @@ int TaskManagerUserdata::TaskManager(lua_State* L)
     
     try
     {
-        tmud = new(p) TaskManagerUserdata(minThreads
-                                        , maxThreads
-                                        , idleTime
-                                        , stackSize
-                                        , minNotificationPool
-                                        , maxNotificationPool);
+        tmud = new(p) TaskManagerUserdata(settings);
     }
     catch (const std::exception& e)
     {
@@ -1119,7 +1641,7 @@ int TaskManagerUserdata::start(lua_State* L)
         lua_pushlightuserdata(L, static_cast<void*>(tmud->mContainer.get()));
         if (newTask->prepTask(L, lua_gettop(L), 3, 4, lastParamIndex))
         {
-            tmud->mContainer->mTaskManager.start(newTask);
+            tmud->mContainer->startTask(newTask);
             Poco::Task* baseTaskPtr = newTask;
             lua_pushlightuserdata(L, static_cast<void*>(baseTaskPtr));
             rv = 1;
@@ -1177,6 +1699,200 @@ int TaskManagerUserdata::dequeueNotification(lua_State* L)
     return tmud->mContainer->waitDequeueNotification(L, static_cast<long>(waitMs));
 }
 
+/// Gets counters describing the notification and timer traffic of the TaskManager.
+// The returned table contains the following fields:
+//
+//      progressSuppressed: progress notifications dropped due to coalescing or the progressInterval setting.
+//
+//      notificationWaits: times a task blocked because maxNotificationPool notifications were in flight.
+//
+//      notificationTimeouts: waits that ended without a notification, see notificationTimeout.
+//
+//      notificationWaitTime: total time in microseconds tasks spent blocked waiting for a notification.
+//
+//      notificationWaitMax: longest single wait in microseconds.
+//
+//      queueTime, runTime, cpuTime, memory: histograms of the matching TaskNotification fields of finished tasks.
+//      Each is a table with count, sum, min, max fields, and a buckets array where buckets[n] counts
+//      samples in the range [2^(n-1), 2^n), with 0 counted in buckets[1].
+//
+//      timers: timers pending from scheduleAfter and scheduleEvery.
+//
+//      timersFired: times a timer has fired, timersFailed: firings that could not start a task.
+//
+//      timersSkipped: scheduleEvery intervals skipped because the timer wheel fell behind.
+// @return table
+// @function stats
+int TaskManagerUserdata::stats(lua_State* L)
+{
+    TaskManagerUserdata* tmud = checkPrivateUserdata<TaskManagerUserdata>(L, 1);
+    tmud->mContainer->pushStats(L);
+
+    return 1;
+}
+
+/// Starts a function as a new task once a delay has passed.
+// The function and parameters are copied when scheduled, and copied again to the task when the timer fires.
+// Timers are serviced by a single timer wheel thread per taskmanager, with a tick length of the timerResolution setting,
+// and tasks started by a timer are named "timer:" followed by the timer id.
+// @int milliseconds delay before the task is started.
+// @param func function to run as the task, which receives the same parameters as one supplied to start.
+// @param[opt] ... additional parameters to pass to the function.
+// @return timer id or nil. (error)
+// @return error message.
+// @function scheduleAfter
+// @see TaskManagerSettings
+int TaskManagerUserdata::scheduleAfter(lua_State* L)
+{
+    return schedule(L, false);
+}
+
+/// Starts a function as a new task on a fixed interval.
+// Like scheduleAfter, with the first task started after one interval. Intervals that pass while the timer
+// wheel is behind are skipped rather than started late, and a new task is started even if the previous
+// one is still running.
+// @int milliseconds interval between starting tasks.
+// @param func function to run as the task, which receives the same parameters as one supplied to start.
+// @param[opt] ... additional parameters to pass to the function.
+// @return timer id or nil. (error)
+// @return error message.
+// @function scheduleEvery
+int TaskManagerUserdata::scheduleEvery(lua_State* L)
+{
+    return schedule(L, true);
+}
+
+// returns the first parameter from firstIndex to lastIndex that is a taskmanager sharing container,
+// or a table holding one as a key or value of any table reachable from it, 0 when there is none.
+int TaskManagerUserdata::findContainer(lua_State* L, int firstIndex, int lastIndex, TaskManagerContainer* container)
+{
+    int found = 0;
+    luaL_checkstack(L, 6, "parameters are nested too deeply");
+    // tables already walked, and the values left to check.
+    lua_newtable(L);
+    int visited = lua_gettop(L);
+    lua_newtable(L);
+    int pending = visited + 1;
+
+    for (int i = firstIndex; i <= lastIndex && found == 0; ++i)
+    {
+        int count = 0;
+        lua_pushvalue(L, i);
+        lua_rawseti(L, pending, ++count);
+
+        while (count > 0 && found == 0)
+        {
+            lua_rawgeti(L, pending, count);
+            lua_pushnil(L);
+            lua_rawseti(L, pending, count--);
+
+            if (lua_type(L, -1) == LUA_TUSERDATA)
+            {
+                TaskManagerUserdata* tmud = dynamic_cast<TaskManagerUserdata*>(getPrivateUserdata(L, -1));
+                if (tmud && tmud->mContainer.get() == container) { found = i; }
+            }
+            else if (lua_istable(L, -1))
+            {
+                lua_pushvalue(L, -1);
+                lua_rawget(L, visited);
+                bool seen = !lua_isnil(L, -1);
+                lua_pop(L, 1);
+
+                if (!seen)
+                {
+                    lua_pushvalue(L, -1);
+                    lua_pushboolean(L, 1);
+                    lua_rawset(L, visited);
+
+                    lua_pushnil(L);
+                    while (lua_next(L, -2))
+                    {
+                        for (int kv = -2; kv <= -1; ++kv)
+                        {
+                            int type = lua_type(L, kv);
+                            if (type == LUA_TTABLE || type == LUA_TUSERDATA)
+                            {
+                                lua_pushvalue(L, kv);
+                                lua_rawseti(L, pending, ++count);
+                            }
+                        }
+                        lua_pop(L, 1);
+                    }
+                }
+            }
+
+            lua_pop(L, 1);
+        }
+    }
+
+    lua_pop(L, 2);
+    return found;
+}
+
+int TaskManagerUserdata::schedule(lua_State* L, bool periodic)
+{
+    int rv = 0;
+    int lastParamIndex = lua_gettop(L);
+    TaskManagerUserdata* tmud = checkPrivateUserdata<TaskManagerUserdata>(L, 1);
+    lua_Integer milliseconds = luaL_checkinteger(L, 2);
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    luaL_argcheck(L, periodic ? milliseconds > 0 : milliseconds >= 0, 2, "invalid number of milliseconds");
+
+    if (tmud->mContainer->mDestruct > 0)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "TaskManager is destructing, no tasks can be started.");
+        return 2;
+    }
+
+    // a timer holding a reference to its own taskmanager would keep it alive, and could end up destroying
+    // the timer wheel from its own thread.
+    int found = findContainer(L, 4, lastParamIndex, tmud->mContainer.get());
+    if (found > 0)
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "taskmanager at parameter %d, tasks receive it as their first parameter\n", found);
+        return 2;
+    }
+
+    try
+    {
+        ScheduledTask* st = new ScheduledTask(*tmud->mContainer);
+        if (st->prepTemplate(L, 3, lastParamIndex))
+        {
+            long delay = static_cast<long>(milliseconds);
+            Poco::UInt64 id = tmud->mContainer->scheduleTask(st, delay, periodic ? delay : 0);
+            lua_pushinteger(L, static_cast<lua_Integer>(id));
+            rv = 1;
+        }
+        else // prepTemplate on failure returns 2 values:  nil, "errmsg"
+        {
+            delete st;
+            rv = 2;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        rv = pushException(L, e);
+    }
+
+    return rv;
+}
+
+/// Cancels a timer such that it starts no further tasks.
+// Tasks already started by the timer are not cancelled.
+// @int id timer id returned by scheduleAfter or scheduleEvery.
+// @return boolean true if the timer was pending, false if it was not found.
+// @function cancelTimer
+int TaskManagerUserdata::cancelTimer(lua_State* L)
+{
+    TaskManagerUserdata* tmud = checkPrivateUserdata<TaskManagerUserdata>(L, 1);
+    lua_Integer id = luaL_checkinteger(L, 2);
+
+    lua_pushboolean(L, id > 0 && tmud->mContainer->cancelTimer(static_cast<Poco::UInt64>(id)));
+    return 1;
+}
+
 /// Returns if a particular Task is cancelled or not.
 // @param task_lightuserdata value returned by start, or found by taskList
 // @function isTaskCancelled
@@ -1191,7 +1907,7 @@ int TaskManagerUserdata::isTaskCancelled(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             isTaskCancelled = task->isCancelled() ? 1 : 0;
         }
@@ -1216,7 +1932,7 @@ int TaskManagerUserdata::taskCancel(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             task->cancel();
         }
@@ -1240,7 +1956,7 @@ int TaskManagerUserdata::taskName(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             const std::string& taskName = task->name();
             lua_pushlstring(L, taskName.c_str(), taskName.size());
@@ -1266,7 +1982,7 @@ int TaskManagerUserdata::taskProgress(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             lua_Number taskProgress = task->progress();
             lua_pushnumber(L, taskProgress);
@@ -1292,7 +2008,7 @@ int TaskManagerUserdata::taskReset(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             task->reset();
         }
@@ -1316,7 +2032,7 @@ int TaskManagerUserdata::taskState(lua_State* L)
     if (lua_islightuserdata(L, 2))
     {
         Poco::AutoPtr<Poco::Task> task;
-        if (findTaskInTaskList(L, 2, task, tmud->mContainer->mTaskManager))
+        if (tmud->mContainer->findTask(lua_touserdata(L, 2), task))
         {
             Poco::Task::TaskState taskProgress = task->state();
             switch (taskProgress)
@@ -5,6 +5,9 @@
 #include "Userdata.h"
 #include "Notification.h"
 #include "NotificationFactory.h"
+#include "ExecutionHook.h"
+#include "TimerWheel.h"
+#include "CpuAffinity.h"
 #include <Poco/TaskManager.h>
 #include <Poco/Task.h>
 #include <Poco/TaskNotification.h>
@@ -13,6 +16,11 @@
 #include <Poco/SharedPtr.h>
 #include <Poco/AtomicCounter.h>
 #include <Poco/NotificationQueue.h>
+#include <Poco/Mutex.h>
+#include <Poco/Clock.h>
+#include <Poco/Timestamp.h>
+#include <Poco/ThreadLocal.h>
+#include <unordered_map>
 
 extern "C"
 {
@@ -31,12 +39,50 @@ extern const char* POCO_TASK_MANAGER_METATABLE_NAME;
 #define TASK_NOTIFICATION_PROGRESS (1 << 5)
 #define TASK_NOTIFICATION_CUSTOM (1 << 6)
 
-class Task : public Poco::Task
+// settings parsed from the TaskManagerSettings table supplied to the taskmanager constructor.
+struct TaskManagerSettings
+{
+    TaskManagerSettings();
+    int minThreads;
+    int maxThreads;
+    int idleTime;
+    int stackSize;
+    int minNotificationPool;
+    int maxNotificationPool;
+    long progressInterval;
+    long notificationTimeout;
+    int cancelHook;
+    long taskTimeLimit;
+    long taskCpuLimit;
+    long timerResolution;
+    CpuSet cpuSet;
+    bool pinWorkers;
+};
+
+// runtime metrics recorded for each Task, reported with its finished and failed notifications.
+struct TaskMetrics
+{
+    TaskMetrics();
+    Poco::Timestamp enqueued;
+    Poco::Timestamp started;
+    Poco::Timestamp ended;
+    // peak Lua heap in bytes, counted by the allocator of the task's state.
+    size_t peakMemory;
+    // thread CPU time in microseconds, -1 when not available on the platform.
+    Poco::Int64 cpuTime;
+};
+
+class Task : public Poco::Task, public ExecutionHook
 {
 public:
     Task(const char* taskName);
     virtual ~Task();
     virtual void runTask();
+    void setEnqueued();
+    // only valid once the task has finished running.
+    const TaskMetrics& metrics() const;
+    // sets the metrics as fields in the table at tableIndex.
+    void pushMetrics(lua_State* L, int tableIndex) const;
     bool prepTask(
             lua_State* L,
             int taskManagerLudIndex,
@@ -60,20 +106,80 @@ public:
     static int lud_sleep(lua_State* L);
     static int lud_postNotification(lua_State* L);
 
+protected:
+    virtual bool isCancelRequested();
+
+private:
+    // lua_Alloc of the task's state, which tracks the size and peak size of its heap.
+    static void* allocate(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    lua_State* mState;
+    // bytes currently allocated by mState.
+    size_t mAllocated;
+    TaskMetrics mMetrics;
+};
+
+class TaskManagerContainer;
+
+// timer which starts a new Task on the TaskManager each time it fires.
+class ScheduledTask : public TimerWheel::Timer
+{
+public:
+    ScheduledTask(TaskManagerContainer& container);
+    virtual ~ScheduledTask();
+    // copies the function and parameters from L to a private lua_State, which is
+    // copied again to each Task started.
+    bool prepTemplate(lua_State* L, int functionIndex, int lastParamIndex);
+
+protected:
+    virtual bool fire();
+
 private:
+    TaskManagerContainer& mContainer;
+    // holds the function followed by its parameters.
     lua_State* mState;
 };
 
+// one shot timer which queues the latest progress of a task once progressInterval has passed
+// since its last progress notification, when updates were dropped in the meantime.
+class ProgressTimer : public TimerWheel::Timer
+{
+public:
+    ProgressTimer(TaskManagerContainer& container, Poco::Task* task);
+    virtual ~ProgressTimer();
+
+protected:
+    virtual bool fire();
+
+private:
+    TaskManagerContainer& mContainer;
+    Poco::Task* mTask;
+};
+
 class TaskManagerContainer
 {
 public:
-    TaskManagerContainer(int minThreads, int maxThreads, int idleTimeout, int stackSize,
-                        int minPool, int maxPool);
+    TaskManagerContainer(const TaskManagerSettings& settings);
     ~TaskManagerContainer();
 
     void enableTaskQueue();
     void disableTaskQueue();
     int waitDequeueNotification(lua_State* L, long milliseconds);
+    // adds the Task to the live task index and starts it on the TaskManager.
+    void startTask(Poco::AutoPtr<Task>& task);
+    // constant time lookup of a live Task via its lightuserdata value.
+    bool findTask(void* taskLud, Poco::AutoPtr<Poco::Task>& task);
+    // obtains a Notification from mPool on behalf of task, honoring the notificationTimeout setting.
+    bool borrowNotification(Poco::Task* task, Poco::AutoPtr<Notification>& notification);
+    // pushes a table of notification counters onto the stack.
+    void pushStats(lua_State* L);
+    // takes ownership of st and schedules it on mTimerWheel, returns the timer id.
+    Poco::UInt64 scheduleTask(ScheduledTask* st, long delay, long interval);
+    bool cancelTimer(Poco::UInt64 id);
+    // counts a ScheduledTask that fired but could not start its Task.
+    void scheduledTaskFailed();
+    // queues a progress notification for task if updates were dropped since the last one was queued.
+    void flushProgress(Poco::Task* task);
 
     // Tasks receive a raw pointer to the TaskManagerContainer which is placed in a table.
     static int lud_count(lua_State* L);
@@ -97,6 +203,77 @@ private:
     void onTaskFailed(Poco::TaskFailedNotification* fn);
     void onTaskProgress(Poco::TaskProgressNotification* pn);
     void onTaskCustom(Notification* n);
+    void removeTask(Poco::Task* task);
+    void progressDequeued(Poco::Task* task);
+    // applies the cpuSet setting to the calling worker thread the first time it runs a task.
+    void placeWorker();
+
+    // power of two histogram of samples, buckets[n] counts samples in [2^n, 2^(n + 1)), with 0 in buckets[0].
+    struct Histogram
+    {
+        Histogram();
+        void record(Poco::Int64 value);
+        void push(lua_State* L) const;
+
+        Poco::UInt64 count;
+        Poco::Int64 sum;
+        Poco::Int64 min;
+        Poco::Int64 max;
+        Poco::UInt64 buckets[64];
+    };
+
+    struct TaskEntry
+    {
+        TaskEntry() : lastProgress(0), progressQueued(false), progressPending(false), progressTimer(0) {}
+        Poco::AutoPtr<Poco::Task> task;
+        // when the last progress notification for this task was queued.
+        Poco::Clock lastProgress;
+        // a progress notification for this task is waiting in mQueue.
+        bool progressQueued;
+        // an update was dropped by progressInterval, and is delivered by the ProgressTimer.
+        bool progressPending;
+        // id of the scheduled ProgressTimer, 0 when none is.
+        Poco::UInt64 progressTimer;
+    };
+
+    // live tasks keyed by the Poco::Task* handed to Lua as lightuserdata.
+    // entries are added in startTask() and removed when the task finishes.
+    typedef std::unordered_map<Poco::Task*, TaskEntry> TaskIndex;
+    Poco::FastMutex mTaskIndexMutex;
+    TaskIndex mTaskIndex;
+    // minimum time between queued progress notifications for a task, in microseconds.
+    Poco::Clock::ClockDiff mProgressInterval;
+    // progress notifications dropped due to coalescing or mProgressInterval.
+    Poco::UInt64 mProgressSuppressed;
+
+    // ExecutionHook settings applied to each Task started.
+    int mCancelHook;
+    long mTaskTimeLimit;
+    long mTaskCpuLimit;
+
+    // milliseconds to wait on an exhausted mPool, negative waits until a notification is available.
+    long mNotificationTimeout;
+    // counters for time tasks spent blocked on an exhausted mPool, guarded by mStatsMutex.
+    Poco::FastMutex mStatsMutex;
+    Poco::UInt64 mNotificationWaits;
+    Poco::UInt64 mNotificationTimeouts;
+    Poco::Clock::ClockDiff mNotificationWaitTime;
+    Poco::Clock::ClockDiff mNotificationWaitMax;
+    // TaskMetrics aggregated over all finished tasks, guarded by mStatsMutex.
+    Histogram mQueueTime;
+    Histogram mRunTime;
+    Histogram mCpuTime;
+    Histogram mPeakMemory;
+    Poco::UInt64 mTimersFailed;
+
+    // single thread servicing the timers of scheduleAfter/scheduleEvery.
+    TimerWheel mTimerWheel;
+
+    // CPUs the worker threads run on, when mPinWorkers is set each worker is given a single CPU in turn.
+    CpuSet mCpuSet;
+    bool mPinWorkers;
+    Poco::AtomicCounter mNextWorkerCpu;
+    Poco::ThreadLocal<bool> mWorkerPlaced;
 
     Poco::ThreadPool mThreadPool;
     Poco::AtomicCounter mQueueEnabled;
@@ -106,8 +283,7 @@ private:
 class TaskManagerUserdata : public Userdata
 {
 public:
-    TaskManagerUserdata(int minThreads, int maxThreads, int idleTimeout, int stackSize,
-                        int minPool, int maxPool);
+    TaskManagerUserdata(const TaskManagerSettings& settings);
     TaskManagerUserdata(Poco::SharedPtr<TaskManagerContainer>& tmc);
             
     virtual ~TaskManagerUserdata();
@@ -130,6 +306,13 @@ private:
     static int enableTaskQueue(lua_State* L);
     static int disableTaskQueue(lua_State* L);
     static int dequeueNotification(lua_State* L);
+    static int stats(lua_State* L);
+    static int scheduleAfter(lua_State* L);
+    static int scheduleEvery(lua_State* L);
+    static int cancelTimer(lua_State* L);
+    static int schedule(lua_State* L, bool periodic);
+    // returns the first parameter holding a taskmanager of container, directly or within tables, or 0.
+    static int findContainer(lua_State* L, int firstIndex, int lastIndex, TaskManagerContainer* container);
     // member functions exposed via TaskManagerUserdata to operate on contained
     // tasks, without having to obtain a table, light userdata, and metatables.
     static int isTaskCancelled(lua_State* L);
@@ -7,6 +7,11 @@
 // Userdata from the poco module that are noted to be copyable/sharable are also able to be passed to a new thread.
 //
 // Note: Synchronization mechanisms like fastmutex, mutex, and semaphore can be used to communicate, but IPC mechanisms that avoid locking complications like pipes, sockets, and notifications are recommended instead.
+//
+// Note: thread:cancel() only sets a flag unless setCancelHook() is used, which stops the thread's Lua code with an error.
+//
+// Note: CPU affinity is supported on Linux and Windows. Threads pinned with setAffinity() also keep the memory
+// they allocate on their local NUMA node under the usual first touch policy.
 // @module thread
 
 #include "Thread.h"
@@ -16,8 +21,18 @@
 
 int luaopen_poco_thread(lua_State* L)
 {
+    struct LuaPoco::CFunctions methods[] = 
+    {
+        { "currentCpu", LuaPoco::ThreadUserdata::currentCpu },
+        { "numaNodeCpus", LuaPoco::ThreadUserdata::numaNodeCpus },
+        { NULL, NULL}
+    };
+
     LuaPoco::ThreadUserdata::registerThread(L);
-    return LuaPoco::loadConstructor(L, LuaPoco::ThreadUserdata::Thread);
+    int rv = LuaPoco::loadConstructor(L, LuaPoco::ThreadUserdata::Thread);
+    if (rv == 1) { setCFunctions(L, methods); }
+
+    return rv;
 }
 
 namespace LuaPoco
@@ -27,7 +42,7 @@ const char* POCO_THREAD_METATABLE_NAME = "Poco.Thread.metatable";
 
 ThreadUserdata::ThreadUserdata() :
     mThread(), mThreadState(NULL), mParamCount(0),
-    mThreadResult(0)
+    mThreadResult(0), mFinished(false), mCancelled(0)
 {
 }
 
@@ -58,6 +73,10 @@ bool ThreadUserdata::registerThread(lua_State* L)
         { "start", start },
         { "priority", priority },
         { "result", result },
+        { "setCancelHook", setCancelHook },
+        { "cancel", cancel },
+        { "isCancelled", isCancelled },
+        { "setAffinity", setAffinity },
         { NULL, NULL}
     };
     
@@ -130,6 +149,55 @@ int ThreadUserdata::Thread(lua_State* L)
     return 1;
 }
 
+/// Gets the CPU and NUMA node the calling thread is currently running on.
+// @return cpu index as a number or nil. (error)
+// @return NUMA node as a number or error message.
+// @function currentCpu
+int ThreadUserdata::currentCpu(lua_State* L)
+{
+    int cpu = 0;
+    int node = 0;
+
+    if (!LuaPoco::currentCpu(cpu, node))
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "current cpu is not available on this platform.");
+        return 2;
+    }
+
+    lua_pushinteger(L, cpu);
+    lua_pushinteger(L, node);
+    return 2;
+}
+
+/// Gets the CPUs belonging to a NUMA node.
+// The result is suitable for thread:setAffinity() and the cpuSet of TaskManagerSettings.
+// @int node NUMA node index.
+// @return array of cpu indices or nil. (error)
+// @return error message.
+// @function numaNodeCpus
+int ThreadUserdata::numaNodeCpus(lua_State* L)
+{
+    int node = static_cast<int>(luaL_checkinteger(L, 1));
+    CpuSet cpus;
+
+    if (!LuaPoco::numaNodeCpus(node, cpus))
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "unable to get the cpus of NUMA node %d.", node);
+        return 2;
+    }
+
+    lua_createtable(L, static_cast<int>(cpus.size()), 0);
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        lua_pushinteger(L, cpus[i]);
+        lua_rawseti(L, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
 ///
 // @type thread
 int ThreadUserdata::metamethod__tostring(lua_State* L)
@@ -300,10 +368,11 @@ int ThreadUserdata::isRunning(lua_State* L)
 }
 
 /// Waits until the thread completes execution.
+// @return true or nil. (error)
+// @return the values returned by the thread's function, or an error message.
 // @function join
 int ThreadUserdata::join(lua_State* L)
 {
-    int rv = 0;
     ThreadUserdata* thud = checkPrivateUserdata<ThreadUserdata>(L, 1);
     
     try
@@ -316,7 +385,9 @@ int ThreadUserdata::join(lua_State* L)
     }
     
     lua_pushboolean(L, 1);
-    return 1;
+    // the thread is joined, so it no longer uses its state.
+    int count = thud->transferResults(L);
+    return count < 0 ? 2 : count + 1;
 }
 
 /// Waits until the thread completes execution.
@@ -343,10 +414,13 @@ int ThreadUserdata::tryJoin(lua_State* L)
 }
 
 /// Gets the result of the Lua code run on the thread.
-// The data is returned from lua_pcall in the form of boolean, status code, error message.
+// The data is returned from lua_pcall in the form of boolean, status code, error message,
+// followed by the values returned by the thread's function once it has finished successfully.
+// Return values are copied the same way as start parameters, and can be fetched more than once.
 // @return boolean true indicates successful, false indicates error occured.
 // @return status "OK", "ERRRUN", "ERRMEM", "ERRERR"
 // @return error message
+// @return ... values returned by the thread's function.
 // @function result
 int ThreadUserdata::result(lua_State* L)
 {
@@ -354,11 +428,13 @@ int ThreadUserdata::result(lua_State* L)
     
     int result = 0;
     std::string error;
+    bool finished = false;
     
     {
         Poco::ScopedLock<Poco::FastMutex> lock(thud->mThreadMutex);
         result = thud->mThreadResult;
         error = thud->mErrorMsg;
+        finished = thud->mFinished;
     }
     
     lua_pushboolean(L, result == 0);
@@ -388,7 +464,93 @@ int ThreadUserdata::result(lua_State* L)
     
     lua_pushlstring(L, error.c_str(), error.size());
     
-    return 3;
+    int count = finished ? thud->transferResults(L) : 0;
+    return count < 0 ? 2 : count + 3;
+}
+
+/// Enables stopping the thread's Lua code once it is cancelled or runs over a time budget.
+// Installs an instruction count hook on the thread's state when it is started, which raises an error
+// in the running Lua code. Must be called prior to start.
+// @int instructions number of Lua VM instructions between checks, 0 disables the hook.
+// @int[opt] timeLimit wall clock budget in milliseconds, 0 is unlimited.
+// @int[opt] cpuLimit thread CPU time budget in milliseconds, 0 is unlimited.
+// @function setCancelHook
+int ThreadUserdata::setCancelHook(lua_State* L)
+{
+    ThreadUserdata* thud = checkPrivateUserdata<ThreadUserdata>(L, 1);
+    lua_Integer instructions = luaL_checkinteger(L, 2);
+    lua_Integer timeLimit = lua_isnumber(L, 3) ? lua_tointeger(L, 3) : 0;
+    lua_Integer cpuLimit = lua_isnumber(L, 4) ? lua_tointeger(L, 4) : 0;
+
+    thud->configureHook(static_cast<int>(instructions), static_cast<long>(timeLimit), static_cast<long>(cpuLimit));
+    return 0;
+}
+
+/// Requests the thread's Lua code to stop.
+// Without setCancelHook, this only sets the flag reported by isCancelled.
+// @function cancel
+int ThreadUserdata::cancel(lua_State* L)
+{
+    ThreadUserdata* thud = checkPrivateUserdata<ThreadUserdata>(L, 1);
+    thud->mCancelled = 1;
+    return 0;
+}
+
+/// Gets the cancellation state of the thread.
+// @return boolean indicating if cancel has been called.
+// @function isCancelled
+int ThreadUserdata::isCancelled(lua_State* L)
+{
+    ThreadUserdata* thud = checkPrivateUserdata<ThreadUserdata>(L, 1);
+    lua_pushboolean(L, thud->mCancelled > 0 ? 1 : 0);
+    return 1;
+}
+
+bool ThreadUserdata::isCancelRequested()
+{
+    return mCancelled > 0;
+}
+
+/// Restricts the thread to a set of CPUs.
+// The affinity is applied when the thread is started, and kept for later starts.
+// Each cpu must be one the process is allowed to run on. Should that no longer be the case when the thread
+// starts, the thread fails without running its function.
+// @param cpus a cpu index, or an array of cpu indices. An empty array removes the restriction.
+// @return true or nil. (error)
+// @return error message.
+// @function setAffinity
+int ThreadUserdata::setAffinity(lua_State* L)
+{
+    ThreadUserdata* thud = checkPrivateUserdata<ThreadUserdata>(L, 1);
+    CpuSet cpus;
+
+    if (!readCpuSet(L, 2, cpus)) { return luaL_argerror(L, 2, "expected a cpu index or an array of cpu indices"); }
+
+    if (!cpuAffinitySupported())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "cpu affinity is not supported on this platform.");
+        return 2;
+    }
+
+    if (thud->mThread.isRunning())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "thread is running, affinity can only be set before start.");
+        return 2;
+    }
+
+    int unavailable = unavailableCpu(cpus);
+    if (unavailable >= 0)
+    {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cpu %d is not available to this process.", unavailable);
+        return 2;
+    }
+
+    thud->mAffinity.swap(cpus);
+    lua_pushboolean(L, 1);
+    return 1;
 }
 
 /// Get or set the thread's stack size.
@@ -443,6 +605,13 @@ int ThreadUserdata::start(lua_State* L)
         
     luaL_checktype(L, 2, LUA_TFUNCTION);  
     
+    if (thud->mThread.isRunning())
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, "thread is already running.");
+        return 2;
+    }
+    
     // any code that returns due to a failure will clean up the allocated state 
     // and it will not be assigned to the mState member variable.
     LuaStateHolder holder(luaL_newstate());
@@ -461,6 +630,17 @@ int ThreadUserdata::start(lua_State* L)
         lua_pop(L, 1);
     }
     
+    // the state must be in place before the thread runs, the holder closes it again if start fails.
+    if (thud->mThreadState) { lua_close(thud->mThreadState); }
+    thud->mThreadState = holder.state;
+    thud->mCancelled = 0;
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(thud->mThreadMutex);
+        thud->mFinished = false;
+        thud->mThreadResult = 0;
+        thud->mErrorMsg.clear();
+    }
+
     try
     {
         thud->mParamCount = top - 2;
@@ -468,25 +648,73 @@ int ThreadUserdata::start(lua_State* L)
     }
     catch (const std::exception& e)
     {
+        thud->mThreadState = NULL;
         return pushException(L, e);
     }
         
     // extract the state from the holder, which prevents it from being closed.
-    thud->mThreadState = holder.extract();
+    holder.extract();
     
     lua_pushboolean(L, 1);
     return 1;
 }
 
+// copies the return values left on mThreadState to L, only valid once run() has finished.
+// returns the number of values, or -1 with nil, error message pushed on L.
+int ThreadUserdata::transferResults(lua_State* L)
+{
+    if (!mThreadState || mThreadResult != 0) { return 0; }
+
+    int top = lua_gettop(L);
+    int count = lua_gettop(mThreadState);
+    // a function returning many values may have left no free slots on either stack.
+    bool fits = lua_checkstack(L, count + TRANSFER_STACK_SLOTS) &&
+        lua_checkstack(mThreadState, TRANSFER_STACK_SLOTS + 1);
+
+    for (int i = 1; i <= count; ++i)
+    {
+        bool transferred = false;
+        if (fits)
+        {
+            lua_pushvalue(mThreadState, i);
+            transferred = transferValue(L, mThreadState);
+            lua_pop(mThreadState, 1);
+        }
+
+        if (!transferred)
+        {
+            lua_settop(L, top);
+            lua_pushnil(L);
+            lua_pushfstring(L, "non-copyable return value %d\n", i);
+            return -1;
+        }
+    }
+
+    return count;
+}
+
 // ThreadUserdata is a Poco::Runnable, so this is executed as part of Poco::Thread::start().
 void ThreadUserdata::run()
 {
-    int top = lua_gettop(mThreadState);
-    int result = lua_pcall(mThreadState, mParamCount, 0, 0);
+    // the thread fails rather than running unpinned, should the CPUs have become unavailable since setAffinity.
+    if (!mAffinity.empty() && !setCurrentThreadAffinity(mAffinity))
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(mThreadMutex);
+        lua_settop(mThreadState, 0);
+        mThreadResult = LUA_ERRRUN;
+        mErrorMsg = "unable to set the thread's cpu affinity.";
+        mFinished = true;
+        return;
+    }
+
+    installHook(mThreadState);
+    // return values are left on the stack for join() and result().
+    int result = lua_pcall(mThreadState, mParamCount, LUA_MULTRET, 0);
     
     Poco::ScopedLock<Poco::FastMutex> lock(mThreadMutex);   
     mThreadResult = result;
     if (mThreadResult != 0) { mErrorMsg = lua_tostring(mThreadState, -1); }
+    mFinished = true;
 }
 
 } // LuaPoco
@@ -3,9 +3,12 @@
 
 #include "LuaPoco.h"
 #include "Userdata.h"
+#include "ExecutionHook.h"
+#include "CpuAffinity.h"
 #include <Poco/Thread.h>
 #include <Poco/Runnable.h>
 #include <Poco/Mutex.h>
+#include <Poco/AtomicCounter.h>
 
 extern "C"
 {
@@ -17,7 +20,7 @@ namespace LuaPoco
 
 extern const char* POCO_THREAD_METATABLE_NAME;
 
-class ThreadUserdata : public Userdata, public Poco::Runnable
+class ThreadUserdata : public Userdata, public Poco::Runnable, public ExecutionHook
 {
 public:
     ThreadUserdata();
@@ -27,7 +30,13 @@ public:
     void run();
     // constructor function 
     static int Thread(lua_State* L);
+    // module functions
+    static int currentCpu(lua_State* L);
+    static int numaNodeCpus(lua_State* L);
     
+protected:
+    virtual bool isCancelRequested();
+
 private:
     // metamethod infrastructure
     static int metamethod__tostring(lua_State* L);
@@ -42,13 +51,24 @@ private:
     static int stackSize(lua_State* L);
     static int start(lua_State* L);
     static int result(lua_State* L);
+    static int setCancelHook(lua_State* L);
+    static int cancel(lua_State* L);
+    static int isCancelled(lua_State* L);
+    static int setAffinity(lua_State* L);
+    
+    int transferResults(lua_State* L);
     
     Poco::FastMutex mThreadMutex;
     Poco::Thread mThread;
     lua_State* mThreadState;
     int mParamCount;
     int mThreadResult;
+    // set once run() is done with mThreadState, which then holds the function's return values.
+    bool mFinished;
     std::string mErrorMsg;
+    Poco::AtomicCounter mCancelled;
+    // applied by the thread itself when it starts running.
+    CpuSet mAffinity;
 };
 
 } // LuaPoco